@@ -0,0 +1,62 @@
+/**
+ * IMAP client
+ *
+ * @file benchmark_client.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include "benchmark_client.h"
+
+#include "mock_imap_server.h"
+
+/**
+ * @brief Connect to the mock server and receive its greeting
+ *
+ * @param port Port of the mock server
+ * @param usingSecure Use TLS from the start of the connection
+ * @param certificateFile Path to the certificate of the mock server, which is trusted
+ * @return std::unique_ptr<BenchmarkClient> Connected client
+ */
+std::unique_ptr<BenchmarkClient> BenchmarkClient::connect(uint16_t port,
+                                                          bool usingSecure,
+                                                          std::string certificateFile) {
+  std::unique_ptr<Connection> connection;
+  ConnectionTiming *timing;
+  if (usingSecure) {
+    auto sslConnection =
+        std::make_unique<TimedConnection<SSLConnection>>(MockIMAPServer::HOSTNAME, port, certificateFile, "");
+    timing = &sslConnection->timing;
+    connection = std::move(sslConnection);
+  } else {
+    auto tcpConnection = std::make_unique<TimedConnection<TCPConnection>>(MockIMAPServer::HOSTNAME, port);
+    timing = &tcpConnection->timing;
+    connection = std::move(tcpConnection);
+  }
+
+  return std::unique_ptr<BenchmarkClient>{new BenchmarkClient{std::move(connection), timing, port, usingSecure}};
+}
+
+/**
+ * @brief Construct a new BenchmarkClient object and receive the server greeting
+ *
+ * @param connection Connection to the mock server
+ * @param timing Timing of the connection
+ * @param port Port of the mock server
+ * @param usingSecure Indicates whether the connection uses TLS
+ */
+BenchmarkClient::BenchmarkClient(std::unique_ptr<Connection> connection,
+                                 ConnectionTiming *timing,
+                                 uint16_t port,
+                                 bool usingSecure)
+    : IMAPClient{std::move(connection), MockIMAPServer::HOSTNAME, port, usingSecure}, timing{timing} {
+  this->connection->receive();
+}
+
+/**
+ * @brief Get the timing of the connection
+ *
+ * @return ConnectionTiming& Timing of the connection
+ */
+ConnectionTiming &BenchmarkClient::getTiming() {
+  return *this->timing;
+}
@@ -0,0 +1,83 @@
+/**
+ * IMAP client
+ *
+ * @file benchmark_client.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef BENCHMARK_CLIENT_H
+#define BENCHMARK_CLIENT_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "imap_client.h"
+#include "ssl_connection.h"
+#include "tcp_connection.h"
+
+/**
+ * @brief Records when the first email arrives on a connection
+ */
+struct ConnectionTiming {
+  /// @brief Represents if a FETCH command was sent and no email was received yet
+  bool isWaitingForEmail{false};
+  /// @brief Time when the first FETCH response was received
+  std::chrono::steady_clock::time_point firstEmailTime;
+
+  /**
+   * @brief Record received data
+   *
+   * @param data Received data
+   * @param size Size of the data
+   */
+  void record(const char *data, std::size_t size) {
+    // The mock server always answers in upper case, e.g. "* 1 FETCH (UID 1 BODY[] {42}"
+    if (this->isWaitingForEmail && std::string_view{data, size}.find(" FETCH (") != std::string_view::npos) {
+      this->firstEmailTime = std::chrono::steady_clock::now();
+      this->isWaitingForEmail = false;
+    }
+  }
+};
+
+/**
+ * @brief Connection which reports received data to a timing, the base is TCPConnection or SSLConnection
+ */
+template <typename BaseConnection>
+class TimedConnection : public BaseConnection {
+ public:
+  /// @brief Timing of received data
+  ConnectionTiming timing;
+
+ public:
+  using BaseConnection::BaseConnection;
+
+ protected:
+  std::size_t readSome(char *buffer, std::size_t size) override {
+    std::size_t bytes = BaseConnection::readSome(buffer, size);
+    this->timing.record(buffer, bytes);
+    return bytes;
+  }
+};
+
+/**
+ * @brief Imap client connected to the mock server, whose connection measures the time to the first email
+ */
+class BenchmarkClient : public IMAPClient {
+ protected:
+  /// @brief Timing of the connection, which is owned by the client
+  ConnectionTiming *timing;
+
+ public:
+  static std::unique_ptr<BenchmarkClient> connect(uint16_t port, bool usingSecure, std::string certificateFile);
+
+  ConnectionTiming &getTiming();
+
+ protected:
+  BenchmarkClient(std::unique_ptr<Connection> connection, ConnectionTiming *timing, uint16_t port, bool usingSecure);
+};
+
+#endif
@@ -0,0 +1,266 @@
+/**
+ * IMAP client
+ *
+ * @file imap_benchmark.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "benchmark_client.h"
+#include "mock_imap_server.h"
+
+/**
+ * @brief Represents what one run of the benchmark measures
+ */
+struct Scenario {
+  /// @brief Use TLS from the start of the connection
+  bool usingSecure;
+  /// @brief Fetch only new emails by IMAPClient::fetchNew instead of all emails by IMAPClient::fetch
+  bool onlyNew;
+  /// @brief Fetch views by IMAPClient::fetchViews or IMAPClient::fetchNewViews instead of a map of strings
+  bool usingViews;
+  /// @brief Specify which email contents to fetch
+  IMAPClient::FetchOptions fetchOptions;
+  /// @brief Specify how to split emails into multiple FETCH commands
+  BatchOptions batch;
+};
+
+/**
+ * @brief Measurements of one run of the benchmark, which are sent from the process of the run
+ */
+struct RunResult {
+  /// @brief Number of fetched emails
+  std::size_t emailCount{0};
+  /// @brief Total size of fetched emails in bytes
+  std::size_t byteCount{0};
+  /// @brief Time from sending the first command of the fetch until all emails were returned
+  double seconds{0};
+  /// @brief Time from sending the first command of the fetch until the first email started to arrive
+  double firstEmailSeconds{0};
+  /// @brief Peak resident set size of the process of the run in kilobytes
+  long peakRss{0};
+};
+
+/**
+ * @brief Fetch emails from the mock server and measure it, runs in its own process
+ *
+ * @param scenario What to measure
+ * @param server Started mock server
+ * @return RunResult Measurements
+ */
+RunResult measure(const Scenario &scenario, MockIMAPServer &server) {
+  std::unique_ptr<BenchmarkClient> client =
+      BenchmarkClient::connect(server.getPort(), scenario.usingSecure, server.getCertificateFile());
+  client->login(MockIMAPServer::USERNAME, MockIMAPServer::PASSWORD);
+  client->select(MockIMAPServer::MAILBOX);
+
+  ConnectionTiming &timing = client->getTiming();
+  timing.isWaitingForEmail = true;
+  auto start = std::chrono::steady_clock::now();
+
+  RunResult result;
+  if (scenario.usingViews) {
+    FetchedEmails emails = scenario.onlyNew ? client->fetchNewViews(scenario.fetchOptions, scenario.batch)
+                                            : client->fetchViews(scenario.fetchOptions, scenario.batch);
+    result.emailCount = emails.size();
+    for (const FetchedEmails::Email &email : emails) {
+      result.byteCount += email.body.size();
+    }
+  } else {
+    std::unordered_map<std::string, std::string> emails =
+        scenario.onlyNew ? client->fetchNew(scenario.fetchOptions, scenario.batch)
+                         : client->fetch(scenario.fetchOptions, scenario.batch);
+    result.emailCount = emails.size();
+    for (const auto &[fileName, email] : emails) {
+      result.byteCount += email.size();
+    }
+  }
+
+  auto end = std::chrono::steady_clock::now();
+  result.seconds = std::chrono::duration<double>(end - start).count();
+  result.firstEmailSeconds =
+      timing.isWaitingForEmail ? 0 : std::chrono::duration<double>(timing.firstEmailTime - start).count();
+
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  result.peakRss = usage.ru_maxrss;
+
+  return result;
+}
+
+/**
+ * @brief Run one measurement in a new process, so its peak memory usage is not affected by previous runs
+ *
+ * @param scenario What to measure
+ * @param server Started mock server
+ * @return RunResult Measurements
+ */
+RunResult run(const Scenario &scenario, MockIMAPServer &server) {
+  int resultPipe[2];
+  if (pipe(resultPipe) < 0) {
+    throw std::runtime_error("Could not create pipe.");
+  }
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    throw std::runtime_error("Could not start benchmark run.");
+  }
+
+  if (pid == 0) {
+    close(resultPipe[0]);
+    try {
+      RunResult result = measure(scenario, server);
+      if (write(resultPipe[1], &result, sizeof(result)) != sizeof(result)) {
+        _exit(1);
+      }
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      _exit(1);
+    }
+    _exit(0);
+  }
+
+  close(resultPipe[1]);
+  RunResult result;
+  ssize_t bytes = read(resultPipe[0], &result, sizeof(result));
+  close(resultPipe[0]);
+  waitpid(pid, nullptr, 0);
+
+  if (bytes != sizeof(result)) {
+    throw std::runtime_error("Benchmark run failed.");
+  }
+
+  return result;
+}
+
+/**
+ * @brief Print one row of the report
+ *
+ * @param scenario Measured scenario
+ * @param result Measurements
+ */
+void printResult(const Scenario &scenario, const RunResult &result) {
+  double megabytes = result.byteCount / (1024.0 * 1024.0);
+  std::string operation = std::string{scenario.onlyNew ? "fetchNew" : "fetch"} + (scenario.usingViews ? "Views" : "");
+  std::cout << std::left << std::setw(10) << (scenario.usingSecure ? "tls" : "plain") << std::setw(14) << operation
+            << std::right << std::fixed << std::setw(9) << result.emailCount << std::setprecision(2) << std::setw(11)
+            << megabytes << std::setprecision(3) << std::setw(10) << result.seconds << std::setprecision(0)
+            << std::setw(12) << (result.seconds > 0 ? result.emailCount / result.seconds : 0) << std::setprecision(2)
+            << std::setw(10) << (result.seconds > 0 ? megabytes / result.seconds : 0) << std::setw(16)
+            << result.firstEmailSeconds * 1000 << std::setprecision(1) << std::setw(13) << result.peakRss / 1024.0
+            << std::endl;
+}
+
+/**
+ * @brief Main function of the benchmark, which measures IMAPClient::fetch and IMAPClient::fetchNew against a local
+ * mock server
+ *
+ * @param argc Number of command line arguments
+ * @param argv Command line arguments
+ * @return int Exit code
+ */
+int main(int argc, char **argv) {
+  MockMailboxOptions mailbox;
+  std::vector<bool> transports = {false, true};
+  std::vector<bool> operations = {false, true};
+  bool usingViews = false;
+  IMAPClient::FetchOptions fetchOptions = IMAPClient::FetchOptions::ALL;
+  BatchOptions batch;
+  unsigned int runCount = 3;
+
+  try {
+    for (int i = 1; i < argc; i++) {
+      if (strcmp(argv[i], "--emails") == 0) {
+        mailbox.emailCount = std::stoul(argv[++i]);
+      } else if (strcmp(argv[i], "--size") == 0) {
+        mailbox.emailSize = std::stoull(argv[++i]);
+      } else if (strcmp(argv[i], "--distribution") == 0) {
+        std::string distribution = argv[++i];
+        if (distribution == "fixed") {
+          mailbox.distribution = MockMailboxOptions::SizeDistribution::FIXED;
+        } else if (distribution == "uniform") {
+          mailbox.distribution = MockMailboxOptions::SizeDistribution::UNIFORM;
+        } else if (distribution == "exponential") {
+          mailbox.distribution = MockMailboxOptions::SizeDistribution::EXPONENTIAL;
+        } else {
+          throw std::invalid_argument("Unknown distribution " + distribution + ".");
+        }
+      } else if (strcmp(argv[i], "--new") == 0) {
+        mailbox.newPercentage = std::stoul(argv[++i]);
+      } else if (strcmp(argv[i], "--latency") == 0) {
+        mailbox.latency = std::chrono::milliseconds{std::stoul(argv[++i])};
+      } else if (strcmp(argv[i], "--seed") == 0) {
+        mailbox.seed = std::stoul(argv[++i]);
+      } else if (strcmp(argv[i], "--plain") == 0) {
+        transports = {false};
+      } else if (strcmp(argv[i], "--tls") == 0) {
+        transports = {true};
+      } else if (strcmp(argv[i], "--fetch") == 0) {
+        operations = {false};
+      } else if (strcmp(argv[i], "--fetch-new") == 0) {
+        operations = {true};
+      } else if (strcmp(argv[i], "--views") == 0) {
+        usingViews = true;
+      } else if (strcmp(argv[i], "-h") == 0) {
+        fetchOptions = IMAPClient::FetchOptions::HEADERS;
+      } else if (strcmp(argv[i], "--batch-size") == 0) {
+        batch.emailCount = std::stoul(argv[++i]);
+      } else if (strcmp(argv[i], "--batch-bytes") == 0) {
+        batch.byteCount = std::stoull(argv[++i]);
+      } else if (strcmp(argv[i], "--window") == 0) {
+        batch.window = std::stoul(argv[++i]);
+      } else if (strcmp(argv[i], "--runs") == 0) {
+        runCount = std::stoul(argv[++i]);
+      } else {
+        throw std::invalid_argument("Unknown argument " + std::string{argv[i]} + ".");
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    std::cerr << "How to run the benchmark: ./imapcl_benchmark [--emails count] [--size bytes] "
+                 "[--distribution fixed|uniform|exponential] [--new percentage] [--latency ms] [--seed seed] "
+                 "[--plain | --tls] [--fetch | --fetch-new] [--views] [-h] [--batch-size count] [--batch-bytes bytes] "
+                 "[--window count] [--runs count]"
+              << std::endl;
+    return 1;
+  }
+
+  try {
+    std::cout << std::left << std::setw(10) << "transport" << std::setw(14) << "operation" << std::right << std::setw(9)
+              << "emails" << std::setw(11) << "MB" << std::setw(10) << "s" << std::setw(12) << "emails/s"
+              << std::setw(10) << "MB/s" << std::setw(16) << "first email ms" << std::setw(13) << "peak RSS MB"
+              << std::endl;
+
+    for (bool usingSecure : transports) {
+      MockIMAPServer server{mailbox, usingSecure};
+      server.start();
+
+      for (bool onlyNew : operations) {
+        Scenario scenario{usingSecure, onlyNew, usingViews, fetchOptions, batch};
+        for (unsigned int i = 0; i < runCount; i++) {
+          printResult(scenario, run(scenario, server));
+        }
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,50 @@
+/**
+ * IMAP client
+ *
+ * @file memory_connection.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include "memory_connection.h"
+
+/**
+ * @brief Construct a new MemoryConnection object
+ *
+ * @param data Data received from the "server", which must outlive the connection
+ */
+MemoryConnection::MemoryConnection(std::string_view data) : data{data} {}
+
+/**
+ * @brief Get the file descriptor of the connection
+ *
+ * @return int Always -1, the connection has no socket
+ */
+int MemoryConnection::getFd() {
+  return -1;
+}
+
+/**
+ * @brief Discard data sent to the "server"
+ *
+ * @param data Data to send
+ */
+void MemoryConnection::writeData(std::string /*data*/) {}
+
+/**
+ * @brief Receive the next part of the data
+ *
+ * @param buffer Buffer for received data
+ * @param size Size of buffer
+ * @return std::size_t Number of received bytes
+ */
+std::size_t MemoryConnection::readSome(char *buffer, std::size_t size) {
+  if (this->position >= this->data.size()) {
+    throw std::runtime_error("Could not receive data from server.");
+  }
+
+  std::size_t count = std::min(size, this->data.size() - this->position);
+  memcpy(buffer, this->data.data() + this->position, count);
+  this->position += count;
+
+  return count;
+}
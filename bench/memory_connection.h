@@ -0,0 +1,40 @@
+/**
+ * IMAP client
+ *
+ * @file memory_connection.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef MEMORY_CONNECTION_H
+#define MEMORY_CONNECTION_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "connection.h"
+
+/**
+ * @brief Connection which receives data from memory instead of a socket and discards sent data
+ */
+class MemoryConnection : public Connection {
+ protected:
+  /// @brief Data received from the "server", which must outlive the connection
+  std::string_view data;
+  /// @brief Number of bytes of data that were already received
+  std::size_t position{0};
+
+ public:
+  explicit MemoryConnection(std::string_view data);
+
+  int getFd() override;
+
+ protected:
+  void writeData(std::string data) override;
+  std::size_t readSome(char *buffer, std::size_t size) override;
+};
+
+#endif
@@ -0,0 +1,737 @@
+/**
+ * IMAP client
+ *
+ * @file mock_imap_server.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include "mock_imap_server.h"
+
+/**
+ * @brief Construct a new MockIMAPServer object, which is not started yet
+ *
+ * @param options Synthetic mailbox served to clients
+ * @param usingSecure Use TLS from the start of every connection
+ */
+MockIMAPServer::MockIMAPServer(MockMailboxOptions options, bool usingSecure)
+    : options{options}, usingSecure{usingSecure} {}
+
+/**
+ * @brief Destroy the MockIMAPServer object and stop the server
+ */
+MockIMAPServer::~MockIMAPServer() {
+  this->stop();
+}
+
+/**
+ * @brief Start the server in a child process and wait until it accepts connections
+ *
+ * The mailbox is generated before the server reports that it is ready, so generating it is not measured.
+ */
+void MockIMAPServer::start() {
+  if (this->usingSecure) {
+    this->generateCertificate();
+  }
+
+  // Listen on an unused port of the loopback interface
+  int listenSocket = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listenSocket < 0) {
+    throw std::runtime_error("Could not create socket.");
+  }
+
+  int reuse = 1;
+  setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = 0;
+  inet_pton(AF_INET, MockIMAPServer::HOSTNAME.c_str(), &address.sin_addr);
+  socklen_t addressLength = sizeof(address);
+  if (bind(listenSocket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 ||
+      listen(listenSocket, SOMAXCONN) < 0 ||
+      getsockname(listenSocket, reinterpret_cast<sockaddr *>(&address), &addressLength) < 0) {
+    close(listenSocket);
+    throw std::runtime_error("Could not listen on the loopback interface.");
+  }
+  this->port = ntohs(address.sin_port);
+
+  int readyPipe[2];
+  if (pipe(readyPipe) < 0) {
+    close(listenSocket);
+    throw std::runtime_error("Could not create pipe.");
+  }
+
+  this->pid = fork();
+  if (this->pid < 0) {
+    close(listenSocket);
+    close(readyPipe[0]);
+    close(readyPipe[1]);
+    throw std::runtime_error("Could not start the mock server.");
+  }
+
+  if (this->pid == 0) {
+    close(readyPipe[0]);
+    this->serve(listenSocket, readyPipe[1]);
+  }
+
+  close(listenSocket);
+  close(readyPipe[1]);
+
+  // The server writes one byte when it is ready, or closes the pipe if it fails
+  char ready = 0;
+  ssize_t bytes;
+  do {
+    bytes = read(readyPipe[0], &ready, 1);
+  } while (bytes < 0 && errno == EINTR);
+  close(readyPipe[0]);
+
+  if (bytes != 1) {
+    this->stop();
+    throw std::runtime_error("Could not start the mock server.");
+  }
+}
+
+/**
+ * @brief Stop the server and remove the generated certificate, connections that are being served are finished
+ */
+void MockIMAPServer::stop() {
+  if (this->pid > 0) {
+    kill(this->pid, SIGTERM);
+    waitpid(this->pid, nullptr, 0);
+    this->pid = -1;
+  }
+
+  if (!this->directoryPath.empty()) {
+    std::error_code error;
+    std::filesystem::remove_all(this->directoryPath, error);
+    this->directoryPath.clear();
+  }
+}
+
+/**
+ * @brief Get the port the server listens on
+ *
+ * @return uint16_t Port on the loopback interface
+ */
+uint16_t MockIMAPServer::getPort() {
+  return this->port;
+}
+
+/**
+ * @brief Get the path of the self-signed certificate of the server, which the client must trust
+ *
+ * @return std::string Path to a PEM file, empty if the server does not use TLS
+ */
+std::string MockIMAPServer::getCertificateFile() {
+  return this->directoryPath.empty() ? "" : (this->directoryPath / "cert.pem").string();
+}
+
+/**
+ * @brief Generate a self-signed certificate and its private key in a temporary directory
+ *
+ * The certificate is its own certificate authority, so the client can trust it as the only certificate of a trust
+ * store.
+ */
+void MockIMAPServer::generateCertificate() {
+  this->directoryPath = std::filesystem::temp_directory_path() / ("imapcl-bench-" + std::to_string(getpid()));
+  std::filesystem::create_directories(this->directoryPath);
+
+  EVP_PKEY *key = EVP_EC_gen("P-256");
+  X509 *certificate = X509_new();
+  if (key == nullptr || certificate == nullptr) {
+    EVP_PKEY_free(key);
+    X509_free(certificate);
+    throw std::runtime_error("Could not generate certificate.");
+  }
+
+  X509_set_version(certificate, 2);
+  ASN1_INTEGER_set(X509_get_serialNumber(certificate), 1);
+  X509_gmtime_adj(X509_getm_notBefore(certificate), -60);
+  X509_gmtime_adj(X509_getm_notAfter(certificate), 24 * 60 * 60);
+  X509_set_pubkey(certificate, key);
+
+  X509_NAME *name = X509_get_subject_name(certificate);
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                             reinterpret_cast<const unsigned char *>(MockIMAPServer::HOSTNAME.c_str()), -1, -1, 0);
+  X509_set_issuer_name(certificate, name);
+
+  X509V3_CTX extensionContext;
+  X509V3_set_ctx_nodb(&extensionContext);
+  X509V3_set_ctx(&extensionContext, certificate, certificate, nullptr, nullptr, 0);
+  std::string alternativeName = "IP:" + MockIMAPServer::HOSTNAME;
+  bool isValid = true;
+  for (auto [nid, value] : {std::pair<int, const char *>{NID_basic_constraints, "critical,CA:TRUE"},
+                            std::pair<int, const char *>{NID_subject_alt_name, alternativeName.c_str()}}) {
+    X509_EXTENSION *extension = X509V3_EXT_conf_nid(nullptr, &extensionContext, nid, value);
+    isValid = isValid && extension != nullptr && X509_add_ext(certificate, extension, -1) == 1;
+    X509_EXTENSION_free(extension);
+  }
+  isValid = isValid && X509_sign(certificate, key, EVP_sha256()) > 0;
+
+  FILE *certificateFile = fopen((this->directoryPath / "cert.pem").c_str(), "w");
+  FILE *keyFile = fopen((this->directoryPath / "key.pem").c_str(), "w");
+  isValid = isValid && certificateFile != nullptr && keyFile != nullptr &&
+            PEM_write_X509(certificateFile, certificate) == 1 &&
+            PEM_write_PrivateKey(keyFile, key, nullptr, nullptr, 0, nullptr, nullptr) == 1;
+
+  if (certificateFile != nullptr) {
+    fclose(certificateFile);
+  }
+  if (keyFile != nullptr) {
+    fclose(keyFile);
+  }
+  X509_free(certificate);
+  EVP_PKEY_free(key);
+
+  if (!isValid) {
+    throw std::runtime_error("Could not generate certificate.");
+  }
+}
+
+/**
+ * @brief Generate emails of the mailbox with sizes from the configured distribution
+ */
+void MockIMAPServer::generateMailbox() {
+  std::mt19937_64 generator{this->options.seed};
+  std::uniform_int_distribution<std::size_t> uniform{this->options.emailSize / 2,
+                                                     this->options.emailSize + this->options.emailSize / 2};
+  std::exponential_distribution<double> exponential{1.0 / std::max<std::size_t>(this->options.emailSize, 1)};
+
+  this->emails.reserve(this->options.emailCount);
+  for (unsigned long number = 1; number <= this->options.emailCount; number++) {
+    std::size_t size = this->options.emailSize;
+    if (this->options.distribution == MockMailboxOptions::SizeDistribution::UNIFORM) {
+      size = uniform(generator);
+    } else if (this->options.distribution == MockMailboxOptions::SizeDistribution::EXPONENTIAL) {
+      size = static_cast<std::size_t>(exponential(generator));
+    }
+
+    this->emails.push_back(this->generateEmail(number, size));
+  }
+}
+
+/**
+ * @brief Generate one email with headers and a body of text lines
+ *
+ * @param number Sequence number of the email
+ * @param size Size of the email in bytes, emails are never smaller than their headers
+ * @return std::string Contents of the email
+ */
+std::string MockIMAPServer::generateEmail(unsigned long number, std::size_t size) {
+  std::string id = std::to_string(number);
+  std::string email = "Message-ID: <" + id + "." + std::to_string(this->options.seed) +
+                      "@mock.imapcl>\r\n"
+                      "Date: Thu, 01 Jan 2026 00:00:00 +0000\r\n"
+                      "From: Sender " +
+                      id + " <sender" + id +
+                      "@example.com>\r\n"
+                      "To: Benchmark <bench@example.com>\r\n"
+                      "Subject: Benchmark email " +
+                      id + "\r\n\r\n";
+  email.reserve(std::max(size, email.size()));
+
+  // Lines are at most 78 characters long like in real emails (RFC 5322)
+  while (email.size() + 2 < size) {
+    std::size_t lineLength = std::min<std::size_t>(76, size - email.size() - 2);
+    for (std::size_t i = 0; i < lineLength; i++) {
+      email += static_cast<char>('a' + (number + email.size()) % 26);
+    }
+    email += "\r\n";
+  }
+  email.resize(std::max(size, email.size()), ' ');
+
+  return email;
+}
+
+/**
+ * @brief Accept connections and serve each one in its own process, runs in the server process until it is stopped
+ *
+ * @param listenSocket Socket which listens for connections
+ * @param readyPipe Pipe which is written when the server is ready
+ */
+void MockIMAPServer::serve(int listenSocket, int readyPipe) {
+  signal(SIGCHLD, SIG_IGN);
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGTERM, SIG_DFL);
+
+  SSL_CTX *ctx = nullptr;
+  try {
+    this->generateMailbox();
+  } catch (const std::exception &e) {
+    _exit(1);
+  }
+
+  if (this->usingSecure) {
+    ctx = SSL_CTX_new(TLS_server_method());
+    if (ctx == nullptr ||
+        SSL_CTX_use_certificate_file(ctx, (this->directoryPath / "cert.pem").c_str(), SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_use_PrivateKey_file(ctx, (this->directoryPath / "key.pem").c_str(), SSL_FILETYPE_PEM) != 1) {
+      _exit(1);
+    }
+  }
+
+  char ready = 1;
+  if (write(readyPipe, &ready, 1) != 1) {
+    _exit(1);
+  }
+  close(readyPipe);
+
+  while (true) {
+    int clientSocket = accept(listenSocket, nullptr, nullptr);
+    if (clientSocket < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      _exit(1);
+    }
+
+    if (fork() == 0) {
+      close(listenSocket);
+      try {
+        MockIMAPSession session{this->emails, this->options.latency, this->options.newPercentage, clientSocket, ctx};
+        session.run();
+      } catch (const std::exception &e) {
+        _exit(1);
+      }
+      _exit(0);
+    }
+
+    close(clientSocket);
+  }
+}
+
+/**
+ * @brief Construct a new MockIMAPSession object and perform the TLS handshake if the server uses TLS
+ *
+ * @param emails Emails of the mailbox
+ * @param latency Delay of every response
+ * @param newPercentage Percentage of emails that are not seen at the start of the session
+ * @param fd Socket of the client
+ * @param ctx Ssl context of the server, nullptr if the connection is not secure
+ */
+MockIMAPSession::MockIMAPSession(const std::vector<std::string> &emails,
+                                 std::chrono::milliseconds latency,
+                                 unsigned int newPercentage,
+                                 int fd,
+                                 SSL_CTX *ctx)
+    : emails{emails}, latency{latency}, seen(emails.size(), false), fd{fd} {
+  // The oldest emails are seen and the newest are new
+  std::size_t seenCount = emails.size() - emails.size() * std::min(newPercentage, 100u) / 100;
+  std::fill(this->seen.begin(), this->seen.begin() + seenCount, true);
+
+  if (ctx != nullptr) {
+    this->ssl = SSL_new(ctx);
+    if (this->ssl == nullptr || SSL_set_fd(this->ssl, fd) != 1 || SSL_accept(this->ssl) != 1) {
+      throw std::runtime_error("Could not perform SSL handshake.");
+    }
+  }
+}
+
+/**
+ * @brief Destroy the MockIMAPSession object and close the connection
+ */
+MockIMAPSession::~MockIMAPSession() {
+  if (this->ssl != nullptr) {
+    SSL_free(this->ssl);
+  }
+
+  close(this->fd);
+}
+
+/**
+ * @brief Serve commands of the client until it logs out or closes the connection
+ *
+ * Commands are handled as soon as they are received and their responses are sent after the latency passes, so
+ * responses of pipelined commands are delayed only once.
+ */
+void MockIMAPSession::run() {
+  this->pendingResponses.emplace_back(std::chrono::steady_clock::now() + this->latency,
+                                      "* OK [CAPABILITY IMAP4rev1 IDLE] imapcl mock server ready\r\n");
+
+  while (!this->isClosing || !this->pendingResponses.empty()) {
+    // Wait for a command or until the oldest response is due
+    int timeout = -1;
+    if (!this->pendingResponses.empty()) {
+      auto delay = std::chrono::ceil<std::chrono::milliseconds>(this->pendingResponses.front().first -
+                                                                std::chrono::steady_clock::now());
+      timeout = std::max<int>(delay.count(), 0);
+    }
+
+    bool hasInput = this->ssl != nullptr && SSL_pending(this->ssl) > 0;
+    if (!hasInput) {
+      pollfd pollFd{this->fd, static_cast<short>(this->isClosing ? 0 : POLLIN), 0};
+      if (poll(&pollFd, 1, timeout) < 0 && errno != EINTR) {
+        throw std::runtime_error("Could not wait for commands.");
+      }
+      hasInput = (pollFd.revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+    }
+
+    if (hasInput && !this->isClosing) {
+      if (!this->receive()) {
+        return;
+      }
+
+      // Handle every whole command line, commands of imapcl never contain literals
+      std::size_t lineStart = 0;
+      std::size_t lineEnd;
+      while (!this->isClosing && (lineEnd = this->input.find("\r\n", lineStart)) != std::string::npos) {
+        std::string response = this->handleCommand(this->input.substr(lineStart, lineEnd - lineStart));
+        this->pendingResponses.emplace_back(std::chrono::steady_clock::now() + this->latency, std::move(response));
+        lineStart = lineEnd + 2;
+      }
+      this->input.erase(0, lineStart);
+    }
+
+    this->sendDueResponses();
+  }
+}
+
+/**
+ * @brief Receive data from the client
+ *
+ * @return true If data was received
+ * @return false If the client closed the connection
+ */
+bool MockIMAPSession::receive() {
+  char buffer[16 * 1024];
+  ssize_t bytes;
+  if (this->ssl != nullptr) {
+    bytes = SSL_read(this->ssl, buffer, sizeof(buffer));
+  } else {
+    do {
+      bytes = read(this->fd, buffer, sizeof(buffer));
+    } while (bytes < 0 && errno == EINTR);
+  }
+
+  if (bytes <= 0) {
+    return false;
+  }
+
+  this->input.append(buffer, bytes);
+  return true;
+}
+
+/**
+ * @brief Send data to the client
+ *
+ * @param data Data to send
+ */
+void MockIMAPSession::send(const std::string &data) {
+  std::size_t sent = 0;
+  while (sent < data.size()) {
+    std::size_t size = std::min<std::size_t>(data.size() - sent, 1024 * 1024);
+    ssize_t bytes;
+    if (this->ssl != nullptr) {
+      bytes = SSL_write(this->ssl, data.data() + sent, size);
+    } else {
+      bytes = write(this->fd, data.data() + sent, size);
+      if (bytes < 0 && errno == EINTR) {
+        continue;
+      }
+    }
+
+    if (bytes <= 0) {
+      throw std::runtime_error("Could not send response to client.");
+    }
+    sent += bytes;
+  }
+}
+
+/**
+ * @brief Send responses whose delay passed
+ */
+void MockIMAPSession::sendDueResponses() {
+  while (!this->pendingResponses.empty() &&
+         this->pendingResponses.front().first <= std::chrono::steady_clock::now()) {
+    this->send(this->pendingResponses.front().second);
+    this->pendingResponses.pop_front();
+  }
+}
+
+/**
+ * @brief Handle one command line
+ *
+ * @param line Command without the line ending, e.g. "7 uid fetch 1:* (uid body.peek[])"
+ * @return std::string Untagged responses followed by the tagged response
+ */
+std::string MockIMAPSession::handleCommand(const std::string &line) {
+  std::size_t tagEnd = line.find(' ');
+  if (tagEnd == std::string::npos) {
+    return "* BAD Missing command\r\n";
+  }
+
+  std::string tag = line.substr(0, tagEnd);
+  std::string command = line.substr(tagEnd + 1);
+  bool usingUids = MockIMAPSession::toLowerCase(command).starts_with("uid ");
+  if (usingUids) {
+    command = command.substr(4);
+  }
+
+  std::size_t nameEnd = command.find(' ');
+  std::string name = MockIMAPSession::toLowerCase(command.substr(0, nameEnd));
+  std::string arguments = nameEnd == std::string::npos ? "" : command.substr(nameEnd + 1);
+
+  try {
+    if (name == "capability") {
+      return "* CAPABILITY IMAP4rev1 IDLE\r\n" + tag + " OK CAPABILITY completed\r\n";
+    } else if (name == "login") {
+      return tag + " OK LOGIN completed\r\n";
+    } else if (name == "logout") {
+      this->isClosing = true;
+      return "* BYE imapcl mock server logging out\r\n" + tag + " OK LOGOUT completed\r\n";
+    } else if (name == "noop") {
+      return tag + " OK NOOP completed\r\n";
+    } else if (name == "list") {
+      return "* LIST (\\HasNoChildren) \"/\" \"" + MockIMAPServer::MAILBOX + "\"\r\n" + tag + " OK LIST completed\r\n";
+    } else if (name == "select" || name == "examine") {
+      return this->select() + tag + " OK [READ-WRITE] SELECT completed\r\n";
+    } else if (name == "search") {
+      return this->search(arguments) + tag + " OK SEARCH completed\r\n";
+    } else if (name == "store") {
+      return this->store(arguments, usingUids) + tag + " OK STORE completed\r\n";
+    } else if (name == "fetch") {
+      return this->fetch(arguments) + tag + " OK FETCH completed\r\n";
+    }
+  } catch (const std::exception &e) {
+    return tag + " BAD Invalid arguments\r\n";
+  }
+
+  return tag + " BAD Unknown command\r\n";
+}
+
+/**
+ * @brief Get untagged responses of the SELECT command
+ *
+ * @return std::string Untagged responses
+ */
+std::string MockIMAPSession::select() {
+  return "* FLAGS (\\Answered \\Flagged \\Deleted \\Seen \\Draft)\r\n* " + std::to_string(this->emails.size()) +
+         " EXISTS\r\n* 0 RECENT\r\n* OK [UIDVALIDITY " + std::to_string(MockIMAPServer::UID_VALIDITY) +
+         "] UIDs valid\r\n* OK [UIDNEXT " + std::to_string(this->emails.size() + 1) + "] Predicted next UID\r\n";
+}
+
+/**
+ * @brief Search emails, NEW and UNSEEN find emails that are not seen and other criteria find all emails
+ *
+ * @param criteria Search criteria
+ * @return std::string Untagged SEARCH response
+ */
+std::string MockIMAPSession::search(const std::string &criteria) {
+  std::string lowerCaseCriteria = MockIMAPSession::toLowerCase(criteria);
+  bool onlyUnseen = lowerCaseCriteria.find("new") != std::string::npos ||
+                    lowerCaseCriteria.find("unseen") != std::string::npos;
+
+  std::string response = "* SEARCH";
+  for (std::size_t i = 0; i < this->emails.size(); i++) {
+    if (!onlyUnseen || !this->seen[i]) {
+      response += " " + std::to_string(i + 1);
+    }
+  }
+
+  return response + "\r\n";
+}
+
+/**
+ * @brief Change the \Seen flag of emails, other flags are ignored
+ *
+ * @param arguments Arguments of the STORE command, e.g. "1:5 +flags.silent (\seen)"
+ * @param usingUids Represents if the command is UID STORE
+ * @return std::string Untagged FETCH responses with new flags, empty for .SILENT
+ */
+std::string MockIMAPSession::store(const std::string &arguments, bool usingUids) {
+  std::string lowerCaseArguments = MockIMAPSession::toLowerCase(arguments);
+  std::size_t setEnd = lowerCaseArguments.find(' ');
+  std::size_t operationEnd = lowerCaseArguments.find(' ', setEnd + 1);
+  if (setEnd == std::string::npos || operationEnd == std::string::npos) {
+    throw std::invalid_argument("Invalid STORE arguments.");
+  }
+
+  std::string operation = lowerCaseArguments.substr(setEnd + 1, operationEnd - setEnd - 1);
+  bool hasSeen = lowerCaseArguments.find("\\seen", operationEnd) != std::string::npos;
+
+  std::string response;
+  for (unsigned long number : this->parseSequenceSet(lowerCaseArguments.substr(0, setEnd))) {
+    if (operation.starts_with('+')) {
+      this->seen[number - 1] = this->seen[number - 1] || hasSeen;
+    } else if (operation.starts_with('-')) {
+      this->seen[number - 1] = this->seen[number - 1] && !hasSeen;
+    } else {
+      this->seen[number - 1] = hasSeen;
+    }
+
+    if (!operation.ends_with(".silent")) {
+      response += "* " + std::to_string(number) + " FETCH (" +
+                  (usingUids ? "UID " + std::to_string(number) + " " : "") + "FLAGS (" + this->formatFlags(number) +
+                  "))\r\n";
+    }
+  }
+
+  return response;
+}
+
+/**
+ * @brief Get untagged FETCH responses of emails, UIDs and sequence numbers are equal
+ *
+ * @param arguments Arguments of the FETCH command, e.g. "1:* (uid flags body.peek[])"
+ * @return std::string Untagged FETCH responses
+ */
+std::string MockIMAPSession::fetch(const std::string &arguments) {
+  std::string lowerCaseArguments = MockIMAPSession::toLowerCase(arguments);
+  std::size_t setEnd = lowerCaseArguments.find(' ');
+  if (setEnd == std::string::npos) {
+    throw std::invalid_argument("Invalid FETCH arguments.");
+  }
+
+  std::string items = lowerCaseArguments.substr(setEnd + 1);
+  std::string response;
+  for (unsigned long number : this->parseSequenceSet(lowerCaseArguments.substr(0, setEnd))) {
+    response += this->fetchEmail(number, items);
+  }
+
+  return response;
+}
+
+/**
+ * @brief Get the untagged FETCH response of one email
+ *
+ * Supported items are UID, FLAGS, RFC822.SIZE and one body section (BODY[], BODY[HEADER], BODY[TEXT] or
+ * BODY[HEADER.FIELDS (...)]), optionally partial like BODY.PEEK[]<0.1024>.
+ *
+ * @param number Sequence number of the email
+ * @param items Fetched items in lower case
+ * @return std::string Untagged FETCH response
+ */
+std::string MockIMAPSession::fetchEmail(unsigned long number, const std::string &items) {
+  const std::string &email = this->emails[number - 1];
+  std::string id = std::to_string(number);
+
+  // Fetching a body section without .PEEK sets the \Seen flag
+  std::size_t sectionStart = items.find("body.peek[");
+  std::size_t sectionNameStart = sectionStart + 10;
+  if (sectionStart == std::string::npos) {
+    sectionStart = items.find("body[");
+    sectionNameStart = sectionStart + 5;
+    if (sectionStart != std::string::npos) {
+      this->seen[number - 1] = true;
+    }
+  }
+
+  std::string response = "* " + id + " FETCH (UID " + id;
+  if (items.find("flags") != std::string::npos) {
+    response += " FLAGS (" + this->formatFlags(number) + ")";
+  }
+  if (items.find("rfc822.size") != std::string::npos) {
+    response += " RFC822.SIZE " + std::to_string(email.size());
+  }
+
+  if (sectionStart != std::string::npos) {
+    std::size_t sectionEnd = items.find(']', sectionNameStart);
+    if (sectionEnd == std::string::npos) {
+      throw std::invalid_argument("Invalid body section.");
+    }
+
+    std::string section = items.substr(sectionNameStart, sectionEnd - sectionNameStart);
+    std::size_t headerEnd = email.find("\r\n\r\n") + 4;
+    std::string_view content = email;
+    std::string fields;
+    std::string name;
+    if (section.empty()) {
+      name = "BODY[]";
+    } else if (section == "header") {
+      content = content.substr(0, headerEnd);
+      name = "BODY[HEADER]";
+    } else if (section == "text") {
+      content = content.substr(headerEnd);
+      name = "BODY[TEXT]";
+    } else if (section.starts_with("header.fields (")) {
+      // Keep header lines whose names are listed, e.g. "header.fields (message-id)"
+      std::string names = " " + section.substr(15, section.find(')') - 15) + " ";
+      for (std::size_t lineStart = 0, lineEnd; (lineEnd = email.find("\r\n", lineStart)) < headerEnd - 2;
+           lineStart = lineEnd + 2) {
+        std::string line = email.substr(lineStart, lineEnd - lineStart);
+        std::string lineName = MockIMAPSession::toLowerCase(line.substr(0, line.find(':')));
+        if (names.find(" " + lineName + " ") != std::string::npos) {
+          fields += line + "\r\n";
+        }
+      }
+      fields += "\r\n";
+      content = fields;
+
+      std::string upperCaseSection = section;
+      std::transform(upperCaseSection.begin(), upperCaseSection.end(), upperCaseSection.begin(),
+                     [](unsigned char c) { return std::toupper(c); });
+      name = "BODY[" + upperCaseSection + "]";
+    } else {
+      throw std::invalid_argument("Unsupported body section.");
+    }
+
+    // Partial fetch, e.g. "<1024.512>"
+    if (sectionEnd + 1 < items.size() && items[sectionEnd + 1] == '<') {
+      std::size_t offset = std::stoull(items.substr(sectionEnd + 2));
+      std::size_t length = std::stoull(items.substr(items.find('.', sectionEnd) + 1));
+      content = offset < content.size() ? content.substr(offset, length) : std::string_view{};
+      name += "<" + std::to_string(offset) + ">";
+    }
+
+    response += " " + name + " {" + std::to_string(content.size()) + "}\r\n";
+    response += content;
+  }
+
+  return response + ")\r\n";
+}
+
+/**
+ * @brief Parse a sequence set into sequence numbers of existing emails
+ *
+ * @param sequenceSet Sequence set, e.g. "1,3:5,7:*"
+ * @return std::vector<unsigned long> Sequence numbers
+ */
+std::vector<unsigned long> MockIMAPSession::parseSequenceSet(const std::string &sequenceSet) {
+  unsigned long emailCount = this->emails.size();
+  auto parseNumber = [emailCount](const std::string &number) {
+    return number == "*" ? emailCount : std::stoul(number);
+  };
+
+  std::vector<unsigned long> numbers;
+  std::size_t partStart = 0;
+  while (partStart <= sequenceSet.size()) {
+    std::size_t partEnd = std::min(sequenceSet.find(',', partStart), sequenceSet.size());
+    std::string part = sequenceSet.substr(partStart, partEnd - partStart);
+
+    std::size_t rangeSeparator = part.find(':');
+    unsigned long first = parseNumber(part.substr(0, rangeSeparator));
+    unsigned long last = rangeSeparator == std::string::npos ? first : parseNumber(part.substr(rangeSeparator + 1));
+    if (first > last) {
+      std::swap(first, last);
+    }
+
+    for (unsigned long number = std::max(first, 1ul); number <= std::min(last, emailCount); number++) {
+      numbers.push_back(number);
+    }
+
+    partStart = partEnd + 1;
+  }
+
+  return numbers;
+}
+
+/**
+ * @brief Get flags of an email
+ *
+ * @param number Sequence number of the email
+ * @return std::string Flags without parentheses
+ */
+std::string MockIMAPSession::formatFlags(unsigned long number) {
+  return this->seen[number - 1] ? "\\Seen" : "";
+}
+
+/**
+ * @brief Convert a string to lower case
+ *
+ * @param input String to convert
+ * @return std::string String in lower case
+ */
+std::string MockIMAPSession::toLowerCase(std::string input) {
+  std::transform(input.begin(), input.end(), input.begin(), [](unsigned char c) { return std::tolower(c); });
+  return input;
+}
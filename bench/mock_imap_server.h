@@ -0,0 +1,161 @@
+/**
+ * IMAP client
+ *
+ * @file mock_imap_server.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef MOCK_IMAP_SERVER_H
+#define MOCK_IMAP_SERVER_H
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+
+/**
+ * @brief Describes the synthetic mailbox served by the mock server
+ */
+struct MockMailboxOptions {
+  /// @brief Represents how sizes of emails are chosen
+  enum class SizeDistribution { FIXED, UNIFORM, EXPONENTIAL };
+
+  /// @brief Number of emails in the mailbox
+  unsigned long emailCount{1000};
+  /// @brief Size of an email in bytes, the mean size for other distributions than FIXED
+  std::size_t emailSize{64 * 1024};
+  /// @brief Distribution of sizes of emails
+  SizeDistribution distribution{SizeDistribution::FIXED};
+  /// @brief Percentage of emails that are not seen when a session starts, these are found by SEARCH NEW
+  unsigned int newPercentage{10};
+  /// @brief Delay of every response, which simulates the round trip time to a remote server
+  std::chrono::milliseconds latency{0};
+  /// @brief Seed of the generator of sizes and contents of emails
+  unsigned int seed{1};
+};
+
+/**
+ * @brief Local stand-in for an IMAP server that serves one synthetic mailbox
+ *
+ * The server runs in a child process, so its memory does not count towards the client being measured, and every
+ * accepted connection is served by its own process with a fresh copy of the flags of emails. It implements only the
+ * commands imapcl sends: CAPABILITY, LOGIN, LOGOUT, NOOP, LIST, SELECT, EXAMINE, SEARCH, STORE, FETCH and their UID
+ * variants. UIDs are equal to sequence numbers. Responses of commands are delayed by the configured latency, but
+ * pipelined commands are still answered in parallel like by a remote server.
+ */
+class MockIMAPServer {
+ public:
+  static inline const std::string HOSTNAME = "127.0.0.1";
+  static inline const std::string USERNAME = "bench";
+  static inline const std::string PASSWORD = "bench";
+  static inline const std::string MAILBOX = "INBOX";
+  static const unsigned long UID_VALIDITY = 1;
+
+ protected:
+  /// @brief Synthetic mailbox served to clients
+  MockMailboxOptions options;
+  /// @brief Indicates whether connections use TLS from the start
+  bool usingSecure;
+  /// @brief Directory with the generated certificate and private key
+  std::filesystem::path directoryPath;
+  /// @brief Port the server listens on, 0 until the server is started
+  uint16_t port{0};
+  /// @brief Process of the server, -1 until the server is started
+  pid_t pid{-1};
+
+  /// @brief Emails of the mailbox, only generated in the server process
+  std::vector<std::string> emails;
+
+ public:
+  MockIMAPServer(MockMailboxOptions options, bool usingSecure);
+  ~MockIMAPServer();
+
+  void start();
+  void stop();
+
+  uint16_t getPort();
+  std::string getCertificateFile();
+
+ protected:
+  void generateCertificate();
+  void generateMailbox();
+  std::string generateEmail(unsigned long number, std::size_t size);
+  [[noreturn]] void serve(int listenSocket, int readyPipe);
+};
+
+/**
+ * @brief One client connection of the mock server, which lives in its own process
+ */
+class MockIMAPSession {
+ protected:
+  /// @brief Emails of the mailbox
+  const std::vector<std::string> &emails;
+  /// @brief Delay of every response
+  std::chrono::milliseconds latency;
+  /// @brief Represents if an email was seen, where the index is the sequence number minus one
+  std::vector<bool> seen;
+
+  /// @brief Socket of the client
+  int fd;
+  /// @brief Tls connection, nullptr if the connection is not secure
+  SSL *ssl{nullptr};
+  /// @brief Received data that does not form a whole command yet
+  std::string input;
+  /// @brief Responses waiting until their delay passes, from the oldest
+  std::deque<std::pair<std::chrono::steady_clock::time_point, std::string>> pendingResponses;
+  /// @brief Represents if the client logged out
+  bool isClosing{false};
+
+ public:
+  MockIMAPSession(const std::vector<std::string> &emails,
+                  std::chrono::milliseconds latency,
+                  unsigned int newPercentage,
+                  int fd,
+                  SSL_CTX *ctx);
+  ~MockIMAPSession();
+
+  void run();
+
+ protected:
+  bool receive();
+  void send(const std::string &data);
+  void sendDueResponses();
+  std::string handleCommand(const std::string &line);
+
+  std::string select();
+  std::string search(const std::string &criteria);
+  std::string store(const std::string &arguments, bool usingUids);
+  std::string fetch(const std::string &arguments);
+  std::string fetchEmail(unsigned long number, const std::string &items);
+
+  std::vector<unsigned long> parseSequenceSet(const std::string &sequenceSet);
+  std::string formatFlags(unsigned long number);
+  static std::string toLowerCase(std::string input);
+};
+
+#endif
@@ -0,0 +1,392 @@
+/**
+ * IMAP client
+ *
+ * @file parser_benchmark.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <string.h>
+
+#include "imap_client.h"
+#include "memory_connection.h"
+#include "response_framer.h"
+
+/// @brief Number of allocations by operator new since the start of the program
+static std::size_t allocationCount = 0;
+
+/**
+ * @brief Allocate memory and count the allocation, array and nothrow forms use this operator too
+ *
+ * @param size Size of the memory
+ * @return void* Allocated memory
+ */
+void *operator new(std::size_t size) {
+  allocationCount++;
+  void *memory = malloc(size == 0 ? 1 : size);
+  if (memory == nullptr) {
+    throw std::bad_alloc{};
+  }
+
+  return memory;
+}
+
+void operator delete(void *memory) noexcept {
+  free(memory);
+}
+
+void operator delete(void *memory, std::size_t /*size*/) noexcept {
+  free(memory);
+}
+
+/// @brief Size of the parts in which data is fed to the framer, like reads from a socket
+const std::size_t FEED_SIZE = 64 * 1024;
+
+/// @brief Receives results of measured operations, so they are not optimized away
+volatile std::size_t resultSink = 0;
+
+/**
+ * @brief Imap client without a server, which exposes the parsers of responses
+ */
+class ParserBenchmarkClient : public IMAPClient {
+ public:
+  ParserBenchmarkClient() : IMAPClient{std::make_unique<MemoryConnection>(""), "bench", 143, false} {}
+
+  using IMAPClient::parseEmails;
+  using IMAPClient::parseSearchResponse;
+  using IMAPClient::toLowerCase;
+};
+
+/**
+ * @brief Response fed to the benchmarks
+ */
+struct Input {
+  /// @brief Represents which command the response belongs to
+  enum class Kind { FETCH, SEARCH };
+
+  /// @brief Command of the response
+  Kind kind;
+  /// @brief Where the response comes from, e.g. "synthetic" or a file name
+  std::string source;
+  /// @brief Whole response including the tagged completion response
+  std::string response;
+  /// @brief Tag of the command
+  unsigned int tag;
+  /// @brief Number of emails in the response, UIDs for SEARCH
+  std::size_t emailCount;
+};
+
+/**
+ * @brief Operation whose cost is measured
+ */
+struct Benchmark {
+  /// @brief Name of the measured function
+  std::string name;
+  /// @brief Command of responses the operation accepts
+  Input::Kind kind;
+  /// @brief Runs the operation once and returns a value derived from its result, so it is not optimized away
+  std::function<std::size_t(const Input &)> run;
+};
+
+/**
+ * @brief Cost of an operation on the previous size of a response
+ */
+struct Trend {
+  /// @brief Cost per byte, 0 if nothing was measured yet
+  double nanosecondsPerByte{0};
+  /// @brief Growth of the cost per byte between the last two sizes, above 1 for superlinear operations
+  double growth{1};
+};
+
+/**
+ * @brief Generate a FETCH response with emails of a fixed size, which has about the requested size
+ *
+ * @param size Requested size in bytes
+ * @param emailSize Size of an email in bytes
+ * @return Input Response
+ */
+Input generateFetchResponse(std::size_t size, std::size_t emailSize) {
+  emailSize = std::min(emailSize, size);
+  std::size_t emailCount = std::max<std::size_t>(size / (emailSize + 40), 1);
+
+  std::string email;
+  while (email.size() < emailSize) {
+    email += std::string(std::min<std::size_t>(76, emailSize - email.size()), 'x');
+    email += "\r\n";
+  }
+  email.resize(emailSize);
+
+  std::string response;
+  response.reserve(size + 64);
+  for (std::size_t number = 1; number <= emailCount; number++) {
+    std::string id = std::to_string(number);
+    response += "* " + id + " FETCH (UID " + id + " BODY[] {" + std::to_string(email.size()) + "}\r\n";
+    response += email;
+    response += ")\r\n";
+  }
+  response += "1 OK FETCH completed\r\n";
+
+  return {Input::Kind::FETCH, "synthetic", std::move(response), 1, emailCount};
+}
+
+/**
+ * @brief Generate a SEARCH response with consecutive UIDs, which has about the requested size
+ *
+ * @param size Requested size in bytes
+ * @return Input Response
+ */
+Input generateSearchResponse(std::size_t size) {
+  std::string response = "* SEARCH";
+  response.reserve(size + 64);
+  std::size_t uidCount = 0;
+  while (response.size() < size) {
+    response += " " + std::to_string(++uidCount);
+  }
+  response += "\r\n1 OK SEARCH completed\r\n";
+
+  return {Input::Kind::SEARCH, "synthetic", std::move(response), 1, uidCount};
+}
+
+/**
+ * @brief Load a response recorded from a real server, which must end with its tagged completion response
+ *
+ * @param kind Command of the response
+ * @param filePath Path to the recorded response
+ * @return Input Response
+ */
+Input loadResponse(Input::Kind kind, std::string filePath) {
+  std::ifstream file{filePath, std::ios::binary};
+  if (!file.is_open()) {
+    throw std::runtime_error("Could not open file " + filePath + ".");
+  }
+  std::stringstream stream;
+  stream << file.rdbuf();
+  std::string response = stream.str();
+
+  // Parse the tag of the last line, e.g. "42 OK FETCH completed"
+  std::size_t lastLineStart = response.rfind("\r\n", response.size() - std::min<std::size_t>(response.size(), 3));
+  lastLineStart = lastLineStart == std::string::npos ? 0 : lastLineStart + 2;
+  unsigned int tag = std::stoul(response.substr(lastLineStart));
+
+  // Count emails by their untagged FETCH responses, or UIDs of the SEARCH response
+  std::size_t emailCount = 0;
+  if (kind == Input::Kind::FETCH) {
+    for (std::size_t position = 0; (position = response.find("\r\n* ", position)) != std::string::npos; position++) {
+      emailCount++;
+    }
+    emailCount += response.starts_with("* ");
+  } else {
+    std::string firstLine = response.substr(0, response.find("\r\n"));
+    emailCount = std::count(firstLine.begin(), firstLine.end(), ' ') - 1;
+  }
+
+  return {kind, filePath, std::move(response), tag, std::max<std::size_t>(emailCount, 1)};
+}
+
+/**
+ * @brief Format a size in bytes with a binary unit
+ *
+ * @param size Size in bytes
+ * @return std::string Formatted size, e.g. "64 MB"
+ */
+std::string formatSize(std::size_t size) {
+  const char *units[] = {"B", "KB", "MB", "GB"};
+  std::size_t unit = 0;
+  while (size >= 1024 && size % 1024 == 0 && unit < 3) {
+    size /= 1024;
+    unit++;
+  }
+
+  return std::to_string(size) + " " + units[unit];
+}
+
+/**
+ * @brief Run an operation repeatedly for at least the minimum time and print its cost per byte and per email
+ *
+ * Operations whose estimated time exceeds the time limit are skipped. The estimate extrapolates the cost of the
+ * previous size with its growth, so operations whose cost grows faster than the size of the response are skipped early.
+ *
+ * @param benchmark Measured operation
+ * @param input Response fed to the operation
+ * @param nominalSize Requested size of the response, 0 for recorded responses
+ * @param trend Cost of the previous size, which is updated
+ * @param minimumTime Minimum time of the measurement in seconds
+ * @param timeLimit Maximum estimated time of one run in seconds
+ */
+void measure(const Benchmark &benchmark,
+             const Input &input,
+             std::size_t nominalSize,
+             Trend &trend,
+             double minimumTime,
+             double timeLimit) {
+  std::cout << std::left << std::setw(26) << benchmark.name << std::setw(8)
+            << (input.kind == Input::Kind::FETCH ? "FETCH" : "SEARCH") << std::setw(11)
+            << (nominalSize == 0 ? input.source : formatSize(nominalSize)) << std::right << std::setw(10)
+            << input.emailCount;
+
+  double estimatedTime = trend.nanosecondsPerByte * trend.growth * input.response.size() / 1e9;
+  if (estimatedTime > timeLimit) {
+    std::cout << "  skipped, estimated " << std::fixed << std::setprecision(0) << estimatedTime << " s" << std::endl;
+    trend.nanosecondsPerByte *= trend.growth;
+    return;
+  }
+
+  std::size_t iterationCount = 0;
+  std::size_t allocationsBefore = allocationCount;
+  auto start = std::chrono::steady_clock::now();
+  double elapsed = 0;
+  do {
+    resultSink = benchmark.run(input);
+    iterationCount++;
+    elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  } while (elapsed < minimumTime);
+  std::size_t allocations = allocationCount - allocationsBefore;
+
+  double nanosecondsPerByte = elapsed * 1e9 / iterationCount / input.response.size();
+  if (trend.nanosecondsPerByte > 0) {
+    trend.growth = std::max(nanosecondsPerByte / trend.nanosecondsPerByte, 1.0);
+  }
+  trend.nanosecondsPerByte = nanosecondsPerByte;
+
+  double allocationsPerEmail = static_cast<double>(allocations) / iterationCount / input.emailCount;
+  std::cout << std::fixed << std::setprecision(3) << std::setw(12) << nanosecondsPerByte << std::setprecision(1)
+            << std::setw(11) << 1e3 / nanosecondsPerByte << std::setprecision(2) << std::setw(14)
+            << allocationsPerEmail << std::setw(12) << iterationCount << std::endl;
+}
+
+/**
+ * @brief Main function of the microbenchmark, which measures parsing and framing of FETCH and SEARCH responses
+ *
+ * @param argc Number of command line arguments
+ * @param argv Command line arguments
+ * @return int Exit code
+ */
+int main(int argc, char **argv) {
+  std::size_t minimumSize = 1024;
+  std::size_t maximumSize = 64 * 1024 * 1024;
+  std::size_t emailSize = 4 * 1024;
+  double minimumTime = 0.2;
+  double timeLimit = 10;
+  std::vector<std::pair<Input::Kind, std::string>> recordedResponses;
+
+  try {
+    for (int i = 1; i < argc; i++) {
+      if (strcmp(argv[i], "--min-size") == 0) {
+        minimumSize = std::stoull(argv[++i]);
+      } else if (strcmp(argv[i], "--max-size") == 0) {
+        maximumSize = std::stoull(argv[++i]);
+      } else if (strcmp(argv[i], "--email-size") == 0) {
+        emailSize = std::stoull(argv[++i]);
+      } else if (strcmp(argv[i], "--min-time") == 0) {
+        minimumTime = std::stod(argv[++i]);
+      } else if (strcmp(argv[i], "--time-limit") == 0) {
+        timeLimit = std::stod(argv[++i]);
+      } else if (strcmp(argv[i], "--fetch-response") == 0) {
+        recordedResponses.emplace_back(Input::Kind::FETCH, argv[++i]);
+      } else if (strcmp(argv[i], "--search-response") == 0) {
+        recordedResponses.emplace_back(Input::Kind::SEARCH, argv[++i]);
+      } else {
+        throw std::invalid_argument("Unknown argument " + std::string{argv[i]} + ".");
+      }
+    }
+
+    if (minimumSize == 0 || emailSize == 0) {
+      throw std::invalid_argument("Sizes must be positive.");
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    std::cerr << "How to run the microbenchmark: ./imapcl_microbenchmark [--min-size bytes] [--max-size bytes] "
+                 "[--email-size bytes] [--min-time seconds] [--time-limit seconds] [--fetch-response file] "
+                 "[--search-response file]"
+              << std::endl;
+    return 1;
+  }
+
+  try {
+    ParserBenchmarkClient client;
+
+    // Frame the response in parts like Connection::frameResponse, without keeping the lines
+    auto frame = [](const Input &input) {
+      ResponseFramer framer;
+      const char *data = input.response.data();
+      std::size_t size = input.response.size();
+      std::size_t lineCount = 0;
+      for (std::size_t partStart = 0; partStart < size; partStart += FEED_SIZE) {
+        std::size_t partEnd = std::min(partStart + FEED_SIZE, size);
+        std::size_t offset = partStart;
+        while (offset < partEnd) {
+          offset += framer.feed(data + offset, partEnd - offset);
+          if (framer.isLineComplete()) {
+            framer.nextLine();
+            lineCount++;
+          }
+        }
+      }
+      return lineCount;
+    };
+
+    // Receive the whole response like IMAPClient::fetch and IMAPClient::getNewEmailUIDs
+    auto readResponse = [](const Input &input) {
+      MemoryConnection connection{input.response};
+      connection.submitCommand(input.tag, "");
+      return connection.readResponse(input.tag).size();
+    };
+
+    std::vector<Benchmark> benchmarks = {
+        {"ResponseFramer::feed", Input::Kind::FETCH, frame},
+        {"Connection::readResponse", Input::Kind::FETCH, readResponse},
+        {"IMAPClient::parseEmails", Input::Kind::FETCH,
+         [&client](const Input &input) { return client.parseEmails(input.response).size(); }},
+        {"IMAPClient::toLowerCase", Input::Kind::FETCH,
+         [&client](const Input &input) { return client.toLowerCase(input.response).size(); }},
+        {"ResponseFramer::feed", Input::Kind::SEARCH, frame},
+        {"Connection::readResponse", Input::Kind::SEARCH, readResponse},
+        {"IMAPClient::parseSearch", Input::Kind::SEARCH,
+         [&client](const Input &input) { return client.parseSearchResponse(input.response).size(); }},
+    };
+
+    std::cout << std::left << std::setw(26) << "function" << std::setw(8) << "input" << std::setw(11) << "size"
+              << std::right << std::setw(10) << "emails" << std::setw(12) << "ns/byte" << std::setw(11) << "MB/s"
+              << std::setw(14) << "allocs/email" << std::setw(12) << "iterations" << std::endl;
+
+    for (const Benchmark &benchmark : benchmarks) {
+      Trend trend;
+      for (std::size_t size = minimumSize; size <= maximumSize; size *= 16) {
+        Input input = benchmark.kind == Input::Kind::FETCH ? generateFetchResponse(size, emailSize)
+                                                           : generateSearchResponse(size);
+        measure(benchmark, input, size, trend, minimumTime, timeLimit);
+
+        if (size > maximumSize / 16) {
+          break;
+        }
+      }
+
+      for (const auto &[kind, filePath] : recordedResponses) {
+        if (kind == benchmark.kind) {
+          Trend unknownTrend;
+          measure(benchmark, loadResponse(kind, filePath), 0, unknownTrend, minimumTime, timeLimit);
+        }
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,429 @@
+/**
+ * IMAP client
+ *
+ * @file async_connection.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include "async_connection.h"
+
+/**
+ * @brief Construct a new AsyncConnection object
+ *
+ * @param loop Event loop that resumes coroutines waiting for the socket
+ * @param fd Connected non-blocking socket file descriptor
+ */
+AsyncConnection::AsyncConnection(EventLoop &loop, int fd) : TCPConnection{fd}, loop{loop} {}
+
+/**
+ * @brief Destroy the AsyncConnection object
+ */
+AsyncConnection::~AsyncConnection() {
+  this->loop.forget(this->clientSocket);
+
+  if (this->ssl) {
+    SSL_free(this->ssl);
+  }
+
+  if (this->ctx) {
+    SSL_CTX_free(this->ctx);
+  }
+
+  this->closeConnection();
+}
+
+/**
+ * @brief Connect to a server without blocking the event loop
+ *
+ * @param loop Event loop that resumes coroutines waiting for the socket
+ * @param hostname Server hostname
+ * @param port Server port
+ * @return Task<std::unique_ptr<AsyncConnection>> Connection to the server
+ */
+Task<std::unique_ptr<AsyncConnection>> AsyncConnection::connect(EventLoop &loop, std::string hostname, uint16_t port) {
+  int fd = co_await AsyncConnection::connectSocket(loop, hostname, port);
+  co_return std::make_unique<AsyncConnection>(loop, fd);
+}
+
+/**
+ * @brief Connect to a server and perform the ssl handshake without blocking the event loop
+ *
+ * @param loop Event loop that resumes coroutines waiting for the socket
+ * @param hostname Server hostname
+ * @param port Server port
+ * @param certificateFile Path to a certificate file used for validating ssl/tls certificate
+ * @param certificatesFolderPath Path to a folder which is used for validating ssl/tls certificates
+ * @return Task<std::unique_ptr<AsyncConnection>> Secure connection to the server
+ */
+Task<std::unique_ptr<AsyncConnection>> AsyncConnection::connect(EventLoop &loop,
+                                                                std::string hostname,
+                                                                uint16_t port,
+                                                                std::string certificateFile,
+                                                                std::string certificatesFolderPath) {
+  int fd = co_await AsyncConnection::connectSocket(loop, hostname, port);
+  std::unique_ptr<AsyncConnection> connection = std::make_unique<AsyncConnection>(loop, fd);
+  co_await connection->startTls(hostname, port, certificateFile, certificatesFolderPath);
+
+  co_return connection;
+}
+
+/**
+ * @brief Make the connection secure by performing the ssl handshake
+ *
+ * @param hostname Server hostname
+ * @param port Server port
+ * @param certificateFile Path to a certificate file used for validating ssl/tls certificate
+ * @param certificatesFolderPath Path to a folder which is used for validating ssl/tls certificates
+ */
+Task<void> AsyncConnection::startTls(std::string hostname,
+                                     uint16_t port,
+                                     std::string certificateFile,
+                                     std::string certificatesFolderPath) {
+  this->sessionKey = hostname + ":" + std::to_string(port);
+
+  // Use the shared ssl context, whose trust store is already loaded
+  this->ctx = SSLContext::acquire(certificateFile, certificatesFolderPath);
+
+  this->ssl = SSL_new(this->ctx);
+  SSL_set_mode(this->ssl, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+  // Offer the session of the previous connection to this server, so the server can skip the full handshake
+  SSLSessionCache::offer(this->ssl, &this->sessionKey);
+
+  // Set file descriptor used in unsecure connection
+  if (SSL_set_fd(this->ssl, this->clientSocket) <= 0) {
+    throw std::runtime_error("Could not create ssl connection to server from existing socket.");
+  }
+
+  // Repeat the handshake whenever the socket is ready
+  auto handshakeStartTime = std::chrono::steady_clock::now();
+  int result;
+  while ((result = SSL_connect(this->ssl)) != 1) {
+    co_await this->loop.waitFor(this->clientSocket,
+                                this->getWantedEvents(result, "Could not connect perform SSL handshake."));
+  }
+
+  if (CommandStats::isEnabled()) {
+    CommandStats::recordHandshake(std::chrono::steady_clock::now() - handshakeStartTime);
+  }
+
+  // Check if the certificate sent from the server is valid
+  if (SSL_get_verify_result(this->ssl) != X509_V_OK) {
+    throw std::runtime_error("Certificate sent from the server is not valid.");
+  }
+
+  SSLSessionCache::report(this->ssl);
+  SSLContext::checkKernelTls(this->ssl);
+}
+
+/**
+ * @brief Send an imap command to the server and wait for its response without blocking the event loop
+ *
+ * @param tag Command tag
+ * @param command Command to send
+ * @param sink Receives the contents of literals instead of the returned response, if set
+ * @return Task<std::string> Response from the server
+ */
+Task<std::string> AsyncConnection::sendCommandAsync(unsigned int tag, std::string command, LiteralSink *sink) {
+  co_await this->submitCommandAsync(tag, command);
+  co_return co_await this->readResponseAsync(tag, sink);
+}
+
+/**
+ * @brief Send an imap command to the server without waiting for its response
+ *
+ * @param tag Command tag
+ * @param command Command to send
+ */
+Task<void> AsyncConnection::submitCommandAsync(unsigned int tag, std::string command) {
+  this->addOutstandingTag(std::to_string(tag), command);
+
+  // Send command to server
+  co_await this->sendDataAsync(command);
+}
+
+/**
+ * @brief Receive data until the tagged completion response of a command arrives without blocking the event loop
+ *
+ * @param tag Tag of sent command to server
+ * @param sink Receives the contents of literals of the command instead of the returned response, if set
+ * @return Task<std::string> Response from the server
+ */
+Task<std::string> AsyncConnection::readResponseAsync(unsigned int tag, LiteralSink *sink) {
+  std::string tagString = std::to_string(tag);
+  if (!this->responses.contains(tagString)) {
+    throw std::runtime_error("Command with tag " + tagString + " was not sent.");
+  }
+
+  while (!this->completedTags.contains(tagString)) {
+    if (this->receiveBuffer.isEmpty()) {
+      co_await this->fillAsync();
+    }
+
+    this->frameResponse(tagString, sink);
+  }
+
+  co_return this->takeResponse(tagString);
+}
+
+/**
+ * @brief Send data to the server without blocking the event loop, which is compressed if compression was started
+ *
+ * @param data Data to send
+ */
+Task<void> AsyncConnection::sendDataAsync(std::string data) {
+  if (this->compression) {
+    data = this->compression->compress(data);
+  }
+
+  this->recordSend(data.size());
+  std::size_t offset = 0;
+  while (offset < data.size()) {
+    uint32_t events = 0;
+    offset += this->trySend(data.data() + offset, data.size() - offset, events);
+
+    if (events != 0) {
+      co_await this->loop.waitFor(this->clientSocket, events);
+    }
+  }
+}
+
+/**
+ * @brief Receive data until it ends with a line break without blocking the event loop, e.g. the server greeting
+ *
+ * @return Task<std::string> Received data that was not framed yet
+ */
+Task<std::string> AsyncConnection::receiveAsync() {
+  do {
+    co_await this->fillAsync();
+  } while (!this->receiveBuffer.getView().ends_with("\r\n"));
+
+  std::string data{this->receiveBuffer.getView()};
+  this->receiveBuffer.consume(data.length());
+
+  co_return data;
+}
+
+/**
+ * @brief Read data that is available from the server directly into the receive buffer without blocking the event loop
+ */
+Task<void> AsyncConnection::fillAsync() {
+  while (true) {
+    uint32_t events = 0;
+    if (this->compression) {
+      // Compressed data is read into a separate buffer first and decompressed into the receive buffer
+      char *input = this->compression->prepareInput(this->receiveBuffer.getReadSize());
+      std::size_t bytes = this->tryReceive(input, this->receiveBuffer.getReadSize(), events);
+      if (bytes > 0) {
+        this->recordReceive(bytes);
+        this->compression->decompress(input, bytes, this->receiveBuffer);
+        co_return;
+      }
+    } else {
+      char *buffer = this->receiveBuffer.prepare();
+      std::size_t bytes = this->tryReceive(buffer, this->receiveBuffer.getWritableSize(), events);
+      if (bytes > 0) {
+        this->receiveBuffer.commit(bytes);
+        this->recordReceive(bytes);
+        co_return;
+      }
+    }
+
+    co_await this->loop.waitFor(this->clientSocket, events);
+  }
+}
+
+/**
+ * @brief Send data to the server and block until it is sent
+ *
+ * @param data Data to send
+ */
+void AsyncConnection::writeData(std::string data) {
+  std::size_t offset = 0;
+  while (offset < data.size()) {
+    uint32_t events = 0;
+    offset += this->trySend(data.data() + offset, data.size() - offset, events);
+
+    if (events != 0) {
+      this->waitBlocking(events);
+    }
+  }
+}
+
+/**
+ * @brief Receive data from the server and block until some data arrives
+ *
+ * @param buffer Buffer for received data
+ * @param size Size of buffer
+ * @return std::size_t Number of received bytes
+ */
+std::size_t AsyncConnection::readSome(char *buffer, std::size_t size) {
+  while (true) {
+    uint32_t events = 0;
+    std::size_t bytes = this->tryReceive(buffer, size, events);
+    if (bytes > 0) {
+      return bytes;
+    }
+
+    this->waitBlocking(events);
+  }
+}
+
+/**
+ * @brief Create a non-blocking socket and connect it to a server
+ *
+ * @param loop Event loop that resumes the coroutine when the socket is connected
+ * @param hostname Server hostname
+ * @param port Server port
+ * @return Task<int> Connected socket file descriptor
+ */
+Task<int> AsyncConnection::connectSocket(EventLoop &loop, std::string hostname, uint16_t port) {
+  // Get ip address of server
+  struct addrinfo hints {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+
+  struct addrinfo *addresses = nullptr;
+  if (getaddrinfo(hostname.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0 || addresses == nullptr) {
+    throw std::runtime_error("Could not get server address.");
+  }
+
+  // Start connecting to the first address
+  auto connectStartTime = std::chrono::steady_clock::now();
+  int fd = socket(addresses->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  int result = fd < 0 ? -1 : ::connect(fd, addresses->ai_addr, addresses->ai_addrlen);
+  bool isConnecting = result == 0 || errno == EINPROGRESS;
+  freeaddrinfo(addresses);
+
+  if (fd < 0) {
+    throw std::runtime_error("Could not create socket.");
+  }
+  if (!isConnecting) {
+    close(fd);
+    throw std::runtime_error("Could not connect to server by TCP.");
+  }
+
+  // The socket becomes writable when the connection is established or fails
+  co_await loop.waitFor(fd, EPOLLOUT);
+
+  int error = 0;
+  socklen_t errorSize = sizeof(error);
+  if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &errorSize) != 0 || error != 0) {
+    loop.forget(fd);
+    close(fd);
+    throw std::runtime_error("Could not connect to server by TCP.");
+  }
+
+  if (CommandStats::isEnabled()) {
+    CommandStats::recordConnect(std::chrono::steady_clock::now() - connectStartTime);
+  }
+
+  co_return fd;
+}
+
+/**
+ * @brief Send data to the server if the socket is ready
+ *
+ * @param data Data to send
+ * @param size Size of data
+ * @param events Set to the events to wait for if the socket is not ready
+ * @return std::size_t Number of sent bytes, 0 if the socket is not ready
+ */
+std::size_t AsyncConnection::trySend(const char *data, std::size_t size, uint32_t &events) {
+  if (this->ssl) {
+    int bytes = SSL_write(this->ssl, data, size);
+    if (bytes > 0) {
+      return bytes;
+    }
+
+    events = this->getWantedEvents(bytes, "Could not send command to server.");
+    return 0;
+  }
+
+  long bytes = send(this->clientSocket, data, size, MSG_NOSIGNAL);
+  if (bytes >= 0) {
+    return bytes;
+  }
+
+  if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+    throw std::runtime_error("Could not send command to server.");
+  }
+
+  events = EPOLLOUT;
+  return 0;
+}
+
+/**
+ * @brief Receive data from the server if the socket is ready
+ *
+ * @param buffer Buffer for received data
+ * @param size Size of buffer
+ * @param events Set to the events to wait for if the socket is not ready
+ * @return std::size_t Number of received bytes, 0 if the socket is not ready
+ */
+std::size_t AsyncConnection::tryReceive(char *buffer, std::size_t size, uint32_t &events) {
+  if (this->ssl) {
+    int bytes = SSL_read(this->ssl, buffer, std::min<std::size_t>(size, INT_MAX));
+    if (bytes > 0) {
+      return bytes;
+    }
+
+    events = this->getWantedEvents(bytes, "Could not receive data from server.");
+    return 0;
+  }
+
+  long bytes = recv(this->clientSocket, buffer, size, 0);
+  if (bytes > 0) {
+    return bytes;
+  }
+
+  if (bytes == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+    throw std::runtime_error("Could not receive data from server.");
+  }
+
+  events = EPOLLIN;
+  return 0;
+}
+
+/**
+ * @brief Get the events that a failed ssl operation waits for
+ *
+ * Both reading and writing can need the other direction, e.g. during renegotiation.
+ *
+ * @param result Result of the ssl operation
+ * @param errorMessage Message of the exception if the operation failed
+ * @return uint32_t EPOLLIN or EPOLLOUT
+ */
+uint32_t AsyncConnection::getWantedEvents(int result, std::string errorMessage) {
+  switch (SSL_get_error(this->ssl, result)) {
+    case SSL_ERROR_WANT_READ:
+      return EPOLLIN;
+    case SSL_ERROR_WANT_WRITE:
+      return EPOLLOUT;
+    default:
+      ERR_clear_error();
+      throw std::runtime_error(errorMessage);
+  }
+}
+
+/**
+ * @brief Block until the socket is ready
+ *
+ * @param events EPOLLIN or EPOLLOUT
+ */
+void AsyncConnection::waitBlocking(uint32_t events) {
+  pollfd fd{this->clientSocket, static_cast<short>(events == EPOLLOUT ? POLLOUT : POLLIN), 0};
+  if (poll(&fd, 1, -1) < 0 && errno != EINTR) {
+    throw std::runtime_error("Could not wait for data.");
+  }
+}
+
+/**
+ * @brief Check if decrypted data is buffered by OpenSSL
+ *
+ * @return true If data is buffered
+ * @return false If no data is buffered
+ */
+bool AsyncConnection::hasBufferedData() {
+  return this->ssl != nullptr && SSL_pending(this->ssl) > 0;
+}
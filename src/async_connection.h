@@ -0,0 +1,86 @@
+/**
+ * IMAP client
+ *
+ * @file async_connection.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef ASYNC_CONNECTION_H
+#define ASYNC_CONNECTION_H
+
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+
+#include "openssl/err.h"
+#include "openssl/ssl.h"
+
+#include "event_loop.h"
+#include "literal_sink.h"
+#include "ssl_context.h"
+#include "task.h"
+#include "tcp_connection.h"
+
+/**
+ * @brief Represents a non-blocking tcp or ssl connection to an imap server, which is driven by an event loop
+ *
+ * Coroutines wait for the socket in the event loop instead of blocking the thread, so one thread can serve many
+ * connections. Only one coroutine can use a connection at a time. The blocking methods of Connection are still
+ * supported, they wait for the socket using poll.
+ */
+class AsyncConnection : public TCPConnection {
+ protected:
+  /// @brief Event loop that resumes coroutines waiting for the socket
+  EventLoop &loop;
+  /// @brief Host:port of the server, which identifies its cached tls session
+  std::string sessionKey;
+  /// @brief Shared ssl context, nullptr if the connection is not secure
+  SSL_CTX *ctx{nullptr};
+  /// @brief Ssl connection, nullptr if the connection is not secure
+  SSL *ssl{nullptr};
+
+ public:
+  AsyncConnection(EventLoop &loop, int fd);
+  ~AsyncConnection() override;
+
+  static Task<std::unique_ptr<AsyncConnection>> connect(EventLoop &loop, std::string hostname, uint16_t port);
+  static Task<std::unique_ptr<AsyncConnection>> connect(EventLoop &loop,
+                                                        std::string hostname,
+                                                        uint16_t port,
+                                                        std::string certificateFile,
+                                                        std::string certificatesFolderPath);
+
+  Task<void> startTls(std::string hostname,
+                      uint16_t port,
+                      std::string certificateFile,
+                      std::string certificatesFolderPath);
+
+  Task<std::string> sendCommandAsync(unsigned int tag, std::string command, LiteralSink *sink = nullptr);
+  Task<void> submitCommandAsync(unsigned int tag, std::string command);
+  Task<std::string> readResponseAsync(unsigned int tag, LiteralSink *sink = nullptr);
+
+  Task<void> sendDataAsync(std::string data);
+  Task<std::string> receiveAsync();
+
+ protected:
+  static Task<int> connectSocket(EventLoop &loop, std::string hostname, uint16_t port);
+
+  Task<void> fillAsync();
+  void writeData(std::string data) override;
+  std::size_t readSome(char *buffer, std::size_t size) override;
+
+  std::size_t trySend(const char *data, std::size_t size, uint32_t &events);
+  std::size_t tryReceive(char *buffer, std::size_t size, uint32_t &events);
+  uint32_t getWantedEvents(int result, std::string errorMessage);
+  void waitBlocking(uint32_t events);
+
+  bool hasBufferedData() override;
+};
+
+#endif
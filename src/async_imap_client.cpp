@@ -0,0 +1,479 @@
+/**
+ * IMAP client
+ *
+ * @file async_imap_client.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include "async_imap_client.h"
+
+/**
+ * @brief Construct a new imap client which uses a non-blocking connection
+ *
+ * @param connection Connection to the server, whose greeting was received
+ * @param hostname Server hostname
+ * @param port Server port
+ * @param usingSecure Indicates whether the connection uses TLS
+ */
+AsyncIMAPClient::AsyncIMAPClient(std::unique_ptr<AsyncConnection> connection,
+                                 std::string hostname,
+                                 uint16_t port,
+                                 bool usingSecure)
+    : IMAPClient{std::move(connection), hostname, port, usingSecure},
+      asyncConnection{static_cast<AsyncConnection *>(this->connection.get())} {}
+
+/**
+ * @brief Connect to a server using a tcp connection without blocking the event loop
+ *
+ * @param loop Event loop that runs the client
+ * @param hostname Server hostname
+ * @param port Server port
+ * @return Task<std::unique_ptr<AsyncIMAPClient>> Connected imap client
+ */
+Task<std::unique_ptr<AsyncIMAPClient>> AsyncIMAPClient::connect(EventLoop &loop, std::string hostname, uint16_t port) {
+  std::unique_ptr<AsyncConnection> connection = co_await AsyncConnection::connect(loop, hostname, port);
+  co_return co_await AsyncIMAPClient::greet(std::move(connection), hostname, port, false);
+}
+
+/**
+ * @brief Connect to a server using a ssl connection without blocking the event loop
+ *
+ * @param loop Event loop that runs the client
+ * @param hostname Server hostname
+ * @param port Server port
+ * @param certificateFile Path to a certificate file used for validating ssl/tls certificate
+ * @param certificatesFolderPath Path to a folder which is used for validating ssl/tls certificates
+ * @return Task<std::unique_ptr<AsyncIMAPClient>> Connected imap client
+ */
+Task<std::unique_ptr<AsyncIMAPClient>> AsyncIMAPClient::connect(EventLoop &loop,
+                                                                std::string hostname,
+                                                                uint16_t port,
+                                                                std::string certificateFile,
+                                                                std::string certificatesFolderPath) {
+  std::unique_ptr<AsyncConnection> connection =
+      co_await AsyncConnection::connect(loop, hostname, port, certificateFile, certificatesFolderPath);
+  std::unique_ptr<AsyncIMAPClient> client =
+      co_await AsyncIMAPClient::greet(std::move(connection), hostname, port, true);
+  client->certificateFile = certificateFile;
+  client->certificatesFolderPath = certificatesFolderPath;
+
+  co_return client;
+}
+
+/**
+ * @brief Authenticate a user by sending the LOGIN command to the server
+ *
+ * @param username Username used for authentication
+ * @param password Password used for authentication
+ */
+Task<void> AsyncIMAPClient::loginAsync(std::string username, std::string password) {
+  co_await this->sendCommandAsync("login " + username + " " + password, "Invalid auth credentials.");
+
+  // Capabilities can change after authentication
+  this->capabilities.clear();
+
+  this->isLoggedIn = true;
+  this->username = username;
+  this->password = password;
+
+  co_await this->startCompressionAsync();
+}
+
+/**
+ * @brief Logout a user by sending the LOGOUT command to the server
+ */
+Task<void> AsyncIMAPClient::logoutAsync() {
+  // Check if user is already logged out
+  if (!this->isLoggedIn) {
+    co_return;
+  }
+
+  co_await this->sendCommandAsync("logout", "Could not logout.");
+  this->isLoggedIn = false;
+}
+
+/**
+ * @brief Check if the server supports a capability by sending the CAPABILITY command to the server
+ *
+ * @param capability Name of the capability
+ * @return Task<bool> True if the server supports the capability
+ */
+Task<bool> AsyncIMAPClient::hasCapabilityAsync(std::string capability) {
+  if (this->capabilities.empty()) {
+    std::string response = co_await this->sendCommandAsync("capability", "Could not get capabilities.");
+    this->parseCapabilities(this->toLowerCase(response));
+  }
+
+  co_return this->capabilities.contains(this->toLowerCase(capability));
+}
+
+/**
+ * @brief Start compressing the connection by sending the COMPRESS command to the server
+ *
+ * @return Task<bool> True if the connection is compressed
+ */
+Task<bool> AsyncIMAPClient::startCompressionAsync() {
+  if (this->isCompressed) {
+    co_return true;
+  }
+
+  if (!this->isCompressionAllowed || !this->isLoggedIn) {
+    co_return false;
+  }
+
+  bool isSupported = co_await this->hasCapabilityAsync("compress=deflate");
+  if (!isSupported) {
+    co_return false;
+  }
+
+  // Send COMPRESS command to server, data after its tagged response is compressed if it was successful
+  std::string command = std::to_string(this->tag) + " compress deflate\r\n";
+  std::string response = co_await this->asyncConnection->sendCommandAsync(this->tag, command);
+  this->isCompressed = this->toLowerCase(response).find(std::to_string(this->tag) + " ok") != std::string::npos;
+  if (this->isCompressed) {
+    this->asyncConnection->startCompression();
+  }
+
+  this->tag++;
+  co_return this->isCompressed;
+}
+
+/**
+ * @brief Get names of all mailboxes by sending the LIST command to the server
+ *
+ * @return Task<std::vector<std::string>> Names of mailboxes that can be selected
+ */
+Task<std::vector<std::string>> AsyncIMAPClient::listAsync() {
+  // User must be logged in before listing mailboxes
+  if (!this->isLoggedIn) {
+    throw std::runtime_error("User must be logged in before listing mailboxes.");
+  }
+
+  std::string response = co_await this->sendCommandAsync("list \"\" *", "Could not list mailboxes.");
+  co_return this->parseMailboxes(response);
+}
+
+/**
+ * @brief Select a mailbox by sending the SELECT command to the server
+ *
+ * @param mailbox Name of mailbox to select
+ */
+Task<void> AsyncIMAPClient::selectAsync(std::string mailbox) {
+  std::string response = co_await this->sendCommandAsync("select " + this->quote(mailbox), "Could not select mailbox.");
+  this->parseSelectResponse(mailbox, response, nullptr);
+}
+
+/**
+ * @brief Save all emails in selected mailbox to a directory while they are received from the server
+ *
+ * @param options Specify which email contents to fetch
+ * @param directoryPath Path where to save emails
+ * @param batch Specify how to split emails into multiple FETCH commands
+ * @return Task<std::size_t> Number of saved emails
+ */
+Task<std::size_t> AsyncIMAPClient::downloadAsync(FetchOptions options, std::string directoryPath, BatchOptions batch) {
+  // User must be logged in before fetching emails
+  if (!this->isLoggedIn) {
+    throw std::runtime_error("User must be logged in before fetching emails.");
+  }
+
+  // Selected mailbox must not be empty
+  if (this->isMailboxEmpty) {
+    co_return 0;
+  }
+
+  // Search for new emails in the same round trip as the FETCH commands
+  unsigned int searchTag = co_await this->submitSearchNewAsync();
+  std::size_t count = co_await this->downloadSequenceSetAsync("1:*", options, directoryPath, batch);
+  co_await this->markAsSeenAsync(co_await this->receiveNewEmailUIDsAsync(searchTag));
+
+  co_return count;
+}
+
+/**
+ * @brief Save only new emails in selected mailbox to a directory while they are received from the server
+ *
+ * @param options Specify which email contents to fetch
+ * @param directoryPath Path where to save emails
+ * @param batch Specify how to split emails into multiple FETCH commands
+ * @return Task<std::size_t> Number of saved emails
+ */
+Task<std::size_t> AsyncIMAPClient::downloadNewAsync(FetchOptions options,
+                                                    std::string directoryPath,
+                                                    BatchOptions batch) {
+  // User must be logged in before fetching emails
+  if (!this->isLoggedIn) {
+    throw std::runtime_error("User must be logged in before fetching emails.");
+  }
+
+  // Selected mailbox must not be empty
+  if (this->isMailboxEmpty) {
+    co_return 0;
+  }
+
+  // Get UIDs of new emails
+  std::string uids = co_await this->receiveNewEmailUIDsAsync(co_await this->submitSearchNewAsync());
+  if (uids.empty()) {
+    co_return 0;
+  }
+
+  std::size_t count = co_await this->downloadSequenceSetAsync(uids, options, directoryPath, batch);
+  co_await this->markAsSeenAsync(uids);
+
+  co_return count;
+}
+
+/**
+ * @brief Synchronize the output directory with selected mailbox using the state of the last synchronization
+ *
+ * Works like IMAPClient::sync, except that changes are always found by comparing UIDs of all emails.
+ *
+ * @param options Specify which email contents to fetch
+ * @param directoryPath Path where emails are saved
+ * @param state State of the last synchronization, which is updated
+ * @param batch Specify how to split emails into multiple FETCH commands
+ * @return Task<std::size_t> Number of downloaded emails
+ */
+Task<std::size_t> AsyncIMAPClient::syncAsync(FetchOptions options,
+                                             std::string directoryPath,
+                                             SyncState &state,
+                                             BatchOptions batch) {
+  // User must be logged in before fetching emails
+  if (!this->isLoggedIn) {
+    throw std::runtime_error("User must be logged in before fetching emails.");
+  }
+
+  // Nothing was added or removed since the last synchronization
+  if (this->uidNext != 0 && state.uidNext == this->uidNext && state.uids.size() == this->emailCount &&
+      state.highestModSeq == this->highestModSeq) {
+    co_return 0;
+  }
+
+  // Search for new emails in the same round trip as the FETCH commands
+  unsigned int searchTag = co_await this->submitSearchNewAsync();
+  std::map<unsigned long, std::string> flags;
+  std::vector<unsigned long> uids;
+  if (!this->isMailboxEmpty) {
+    std::string response = co_await this->sendCommandAsync("fetch 1:* (uid flags)", "Could not fetch email UIDs.");
+    uids = this->parseFetchedUIDs(response, flags);
+  }
+
+  // Download emails that are not stored yet
+  std::string newEmails = this->reconcileState(uids, directoryPath, state);
+  std::size_t count = 0;
+  if (!newEmails.empty()) {
+    count = co_await this->downloadSequenceSetAsync(newEmails, options, directoryPath, batch);
+  }
+  co_await this->markAsSeenAsync(co_await this->receiveNewEmailUIDsAsync(searchTag));
+
+  this->updateState(state, uids, flags);
+  this->updateIndex(directoryPath, state);
+  co_return count;
+}
+
+/**
+ * @brief Create a client for a connection and receive the server greeting
+ *
+ * @param connection Connection to the server
+ * @param hostname Server hostname
+ * @param port Server port
+ * @param usingSecure Indicates whether the connection uses TLS
+ * @return Task<std::unique_ptr<AsyncIMAPClient>> Connected imap client
+ */
+Task<std::unique_ptr<AsyncIMAPClient>> AsyncIMAPClient::greet(std::unique_ptr<AsyncConnection> connection,
+                                                              std::string hostname,
+                                                              uint16_t port,
+                                                              bool usingSecure) {
+  // Receive server greeting
+  co_await connection->receiveAsync();
+
+  co_return std::make_unique<AsyncIMAPClient>(std::move(connection), hostname, port, usingSecure);
+}
+
+/**
+ * @brief Send a command to the server and verify that it was successful
+ *
+ * @param arguments Command without the tag
+ * @param errorMessage Message of the exception if the command was not successful
+ * @return Task<std::string> Response from the server
+ */
+Task<std::string> AsyncIMAPClient::sendCommandAsync(std::string arguments, std::string errorMessage) {
+  std::string command = std::to_string(this->tag) + " " + arguments + "\r\n";
+  std::string response = co_await this->asyncConnection->sendCommandAsync(this->tag, command);
+
+  // Verify that the command was successful
+  if (this->toLowerCase(response).find(std::to_string(this->tag) + " ok") == std::string::npos) {
+    throw std::runtime_error(errorMessage);
+  }
+
+  this->tag++;
+  co_return response;
+}
+
+/**
+ * @brief Send a SEARCH command for new emails to the server without waiting for its response
+ *
+ * @return Task<unsigned int> Tag of the sent command
+ */
+Task<unsigned int> AsyncIMAPClient::submitSearchNewAsync() {
+  unsigned int searchTag = this->tag++;
+  co_await this->asyncConnection->submitCommandAsync(searchTag, std::to_string(searchTag) + " search new\r\n");
+
+  co_return searchTag;
+}
+
+/**
+ * @brief Receive the response of a SEARCH command for new emails
+ *
+ * @param searchTag Tag of the sent SEARCH command
+ * @return Task<std::string> Sequence set representing UIDs of new emails
+ */
+Task<std::string> AsyncIMAPClient::receiveNewEmailUIDsAsync(unsigned int searchTag) {
+  std::string response = co_await this->asyncConnection->readResponseAsync(searchTag);
+
+  // Verify that searching emails was successful
+  if (this->toLowerCase(response).find(std::to_string(searchTag) + " ok") == std::string::npos) {
+    throw std::runtime_error("Could not search emails.");
+  }
+
+  co_return this->parseSearchResponse(response);
+}
+
+/**
+ * @brief Mark emails as seen by sending a STORE command to the server
+ *
+ * @param uids Sequence set representing UIDs of emails
+ */
+Task<void> AsyncIMAPClient::markAsSeenAsync(std::string uids) {
+  if (uids.empty()) {
+    co_return;
+  }
+
+  co_await this->sendCommandAsync("store " + uids + " +flags.silent (\\seen)", "Could not store flags.");
+}
+
+/**
+ * @brief Save a set of emails to a directory while they are received from the server
+ *
+ * Up to the window of FETCH commands are sent before waiting for a response. Emails that are already in the store are
+ * linked and large emails are downloaded in ranges like in IMAPClient::downloadSequenceSet.
+ *
+ * @param sequenceSet Sequence set of emails to download
+ * @param options Specify which email contents to fetch
+ * @param directoryPath Path where to save emails
+ * @param batch Specify how to split emails into multiple FETCH commands
+ * @return Task<std::size_t> Number of saved emails
+ */
+Task<std::size_t> AsyncIMAPClient::downloadSequenceSetAsync(std::string sequenceSet,
+                                                            FetchOptions options,
+                                                            std::string directoryPath,
+                                                            BatchOptions batch) {
+  // Link emails that are already in the store instead of downloading them
+  std::size_t count = 0;
+  std::string response;
+  if (this->outputFormat == EmailWriter::Format::STORE && options == FetchOptions::ALL) {
+    response =
+        co_await this->sendCommandAsync(this->getMessageIdArguments(sequenceSet), "Could not fetch Message-IDs.");
+    sequenceSet = this->linkStoredEmails(sequenceSet, response, directoryPath, count);
+    if (sequenceSet.empty()) {
+      co_return count;
+    }
+  }
+
+  // Download large emails in ranges, the response with Message-IDs contains their sizes too
+  if (this->partialSize != 0 && options == FetchOptions::ALL) {
+    if (response.empty()) {
+      response = co_await this->sendCommandAsync("fetch " + sequenceSet + " (uid rfc822.size)",
+                                                 "Could not fetch email sizes.");
+    }
+
+    std::vector<std::pair<unsigned long, std::size_t>> largeEmails;
+    sequenceSet = this->splitLargeEmails(sequenceSet, response, largeEmails);
+    count += co_await this->downloadLargeEmailsAsync(largeEmails, directoryPath);
+    if (sequenceSet.empty()) {
+      co_return count;
+    }
+  }
+
+  std::vector<std::string> batches{sequenceSet};
+  if (batch.emailCount != 0 || batch.byteCount != 0) {
+    std::unordered_map<unsigned long, std::size_t> sizes;
+    if (batch.byteCount != 0) {
+      std::string response =
+          co_await this->sendCommandAsync("fetch " + sequenceSet + " rfc822.size", "Could not fetch email sizes.");
+      sizes = this->parseEmailSizes(this->toLowerCase(response));
+    }
+
+    batches = this->splitBatches(sequenceSet, sizes, batch);
+  }
+
+  std::unique_ptr<EmailWriter> writer = this->createWriter(directoryPath);
+  unsigned int window = std::max(batch.window, 1u);
+  std::size_t sentCount = 0;
+  std::size_t receivedCount = 0;
+
+  while (receivedCount < batches.size()) {
+    // Send FETCH commands to server until the window is full
+    while (sentCount < batches.size() && sentCount - receivedCount < window) {
+      std::string command =
+          std::to_string(this->tag) + " " + this->getFetchArguments(batches[sentCount], options) + "\r\n";
+      co_await this->asyncConnection->submitCommandAsync(this->tag, command);
+
+      this->tag++;
+      sentCount++;
+    }
+
+    // Receive response of the oldest sent command
+    unsigned int responseTag = this->tag - (sentCount - receivedCount);
+    std::string response = co_await this->asyncConnection->readResponseAsync(responseTag, writer.get());
+
+    // Verify that fetching emails was successful
+    if (this->toLowerCase(response).find(std::to_string(responseTag) + " ok") == std::string::npos) {
+      throw std::runtime_error("Could not fetch emails.");
+    }
+
+    receivedCount++;
+  }
+
+  writer->flush();
+  co_return count + writer->getCount();
+}
+
+/**
+ * @brief Save large emails to a directory by fetching them in ranges like IMAPClient::downloadLargeEmails
+ *
+ * @param largeEmails Pairs of a UID and a size of every email
+ * @param directoryPath Path where to save emails
+ * @return Task<std::size_t> Number of saved emails
+ */
+Task<std::size_t> AsyncIMAPClient::downloadLargeEmailsAsync(
+    std::vector<std::pair<unsigned long, std::size_t>> largeEmails,
+    std::string directoryPath) {
+  if (largeEmails.empty()) {
+    co_return 0;
+  }
+
+  std::unique_ptr<EmailWriter> writer = this->createWriter(directoryPath);
+  for (const auto &[uid, size] : largeEmails) {
+    PartialDownload download{directoryPath, this->hostname, this->mailbox, this->uidValidity, uid, size};
+
+    while (!download.isComplete()) {
+      std::string command =
+          std::to_string(this->tag) + " " + download.getFetchArguments(this->partialSize) + "\r\n";
+      std::string response = co_await this->asyncConnection->sendCommandAsync(this->tag, command, &download);
+
+      // Verify that fetching the range was successful and the email is still in the mailbox
+      if (this->toLowerCase(response).find(std::to_string(this->tag) + " ok") == std::string::npos ||
+          !download.checkRange(response)) {
+        throw std::runtime_error("Could not fetch emails.");
+      }
+
+      this->tag++;
+    }
+
+    download.deliver(*writer);
+  }
+  writer->flush();
+
+  co_return writer->getCount();
+}
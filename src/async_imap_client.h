@@ -0,0 +1,79 @@
+/**
+ * IMAP client
+ *
+ * @file async_imap_client.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef ASYNC_IMAP_CLIENT_H
+#define ASYNC_IMAP_CLIENT_H
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "async_connection.h"
+#include "email_writer.h"
+#include "event_loop.h"
+#include "imap_client.h"
+#include "sync_state.h"
+#include "task.h"
+
+/**
+ * @brief Represents a imap client whose commands are coroutines, so many clients can run on one thread
+ *
+ * Commands of one client must be awaited one after another. The blocking methods of IMAPClient can be used too, but
+ * they block the event loop.
+ */
+class AsyncIMAPClient : public IMAPClient {
+ protected:
+  /// @brief Connection to an imap server, owned by the base class
+  AsyncConnection *asyncConnection;
+
+ public:
+  AsyncIMAPClient(std::unique_ptr<AsyncConnection> connection, std::string hostname, uint16_t port, bool usingSecure);
+
+  static Task<std::unique_ptr<AsyncIMAPClient>> connect(EventLoop &loop, std::string hostname, uint16_t port);
+  static Task<std::unique_ptr<AsyncIMAPClient>> connect(EventLoop &loop,
+                                                        std::string hostname,
+                                                        uint16_t port,
+                                                        std::string certificateFile,
+                                                        std::string certificatesFolderPath);
+
+  Task<void> loginAsync(std::string username, std::string password);
+  Task<void> logoutAsync();
+
+  Task<bool> hasCapabilityAsync(std::string capability);
+  Task<bool> startCompressionAsync();
+
+  Task<std::vector<std::string>> listAsync();
+  Task<void> selectAsync(std::string mailbox);
+  Task<std::size_t> downloadAsync(FetchOptions options, std::string directoryPath, BatchOptions batch = {});
+  Task<std::size_t> downloadNewAsync(FetchOptions options, std::string directoryPath, BatchOptions batch = {});
+  Task<std::size_t> syncAsync(FetchOptions options,
+                              std::string directoryPath,
+                              SyncState &state,
+                              BatchOptions batch = {});
+
+ protected:
+  static Task<std::unique_ptr<AsyncIMAPClient>> greet(std::unique_ptr<AsyncConnection> connection,
+                                                      std::string hostname,
+                                                      uint16_t port,
+                                                      bool usingSecure);
+
+  Task<std::string> sendCommandAsync(std::string arguments, std::string errorMessage);
+  Task<unsigned int> submitSearchNewAsync();
+  Task<std::string> receiveNewEmailUIDsAsync(unsigned int searchTag);
+  Task<void> markAsSeenAsync(std::string uids);
+  Task<std::size_t> downloadSequenceSetAsync(std::string sequenceSet,
+                                             FetchOptions options,
+                                             std::string directoryPath,
+                                             BatchOptions batch);
+  Task<std::size_t> downloadLargeEmailsAsync(std::vector<std::pair<unsigned long, std::size_t>> largeEmails,
+                                             std::string directoryPath);
+};
+
+#endif
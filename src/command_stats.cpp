@@ -0,0 +1,253 @@
+/**
+ * IMAP client
+ *
+ * @file command_stats.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include "command_stats.h"
+
+/**
+ * @brief Start recording statistics and print them to the standard error output when the program exits
+ *
+ * @param format Format of the printed statistics
+ */
+void CommandStats::enable(Format format) {
+  std::lock_guard<std::mutex> lock{CommandStats::mutex};
+  if (!CommandStats::enabled) {
+    std::atexit(CommandStats::printAtExit);
+  }
+
+  CommandStats::enabled = true;
+  CommandStats::exitFormat = format;
+}
+
+/**
+ * @brief Check if statistics are recorded, connections skip all measurements otherwise
+ *
+ * @return true If statistics are recorded
+ * @return false If statistics are not recorded
+ */
+bool CommandStats::isEnabled() {
+  return CommandStats::enabled;
+}
+
+/**
+ * @brief Start measuring a command that is being sent
+ *
+ * @param command Command with its tag, e.g. "7 uid fetch 1:* (uid body.peek[])\r\n"
+ * @return Command Measurements of the command
+ */
+CommandStats::Command CommandStats::startCommand(const std::string &command) {
+  Command measurements;
+  measurements.startTime = std::chrono::steady_clock::now();
+  measurements.sentBytes = command.size();
+
+  // The name is the word after the tag, or two words for UID commands, arguments like passwords are left out
+  std::istringstream stream{command};
+  std::string tag;
+  stream >> tag >> measurements.name;
+  std::transform(measurements.name.begin(), measurements.name.end(), measurements.name.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  if (measurements.name == "uid") {
+    std::string name;
+    stream >> name;
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+    measurements.name += " " + name;
+  }
+
+  return measurements;
+}
+
+/**
+ * @brief Add measurements of a command whose tagged response was received
+ *
+ * @param command Measurements of the command
+ */
+void CommandStats::finishCommand(const Command &command) {
+  auto endTime = std::chrono::steady_clock::now();
+
+  std::lock_guard<std::mutex> lock{CommandStats::mutex};
+  Summary &summary = CommandStats::commands[command.name];
+  summary.wallTimes.push_back(CommandStats::toMilliseconds(endTime - command.startTime));
+  if (command.hasFirstByte) {
+    summary.firstByteTimes.push_back(CommandStats::toMilliseconds(command.firstByteTime - command.startTime));
+  }
+  summary.sentBytes += command.sentBytes;
+  summary.receivedBytes += command.receivedBytes;
+  summary.networkSentBytes += command.networkSentBytes;
+  summary.networkReceivedBytes += command.networkReceivedBytes;
+  summary.receiveCalls += command.receiveCalls;
+  summary.sinkTime += CommandStats::toMilliseconds(command.sinkTime);
+}
+
+/**
+ * @brief Add the time of establishing a TCP connection
+ *
+ * @param duration Time from starting to connect until the connection was established
+ */
+void CommandStats::recordConnect(std::chrono::steady_clock::duration duration) {
+  std::lock_guard<std::mutex> lock{CommandStats::mutex};
+  CommandStats::connectTimes.push_back(CommandStats::toMilliseconds(duration));
+}
+
+/**
+ * @brief Add the time of a TLS handshake
+ *
+ * @param duration Time of the whole handshake, including resumed ones
+ */
+void CommandStats::recordHandshake(std::chrono::steady_clock::duration duration) {
+  std::lock_guard<std::mutex> lock{CommandStats::mutex};
+  CommandStats::handshakeTimes.push_back(CommandStats::toMilliseconds(duration));
+}
+
+/**
+ * @brief Format the recorded statistics
+ *
+ * JSON has an object with times of connections and an object with one entry for each command name. Times are in
+ * milliseconds and summarized by their count, total, minimum, mean, percentiles and maximum. The histogram format is
+ * a text report with counts of times in power of two buckets.
+ *
+ * @param format Format of the statistics
+ * @return std::string Formatted statistics
+ */
+std::string CommandStats::format(Format format) {
+  std::lock_guard<std::mutex> lock{CommandStats::mutex};
+  std::ostringstream stream;
+
+  if (format == Format::JSON) {
+    stream << "{\"connections\":{\"connect_ms\":" << CommandStats::formatJsonTimes(CommandStats::connectTimes)
+           << ",\"handshake_ms\":" << CommandStats::formatJsonTimes(CommandStats::handshakeTimes) << "},\"commands\":{";
+
+    bool isFirst = true;
+    for (const auto &[name, summary] : CommandStats::commands) {
+      stream << (isFirst ? "" : ",") << "\"" << name << "\":{\"count\":" << summary.wallTimes.size()
+             << ",\"wall_ms\":" << CommandStats::formatJsonTimes(summary.wallTimes)
+             << ",\"first_byte_ms\":" << CommandStats::formatJsonTimes(summary.firstByteTimes)
+             << ",\"bytes_sent\":" << summary.sentBytes << ",\"bytes_received\":" << summary.receivedBytes
+             << ",\"network_bytes_sent\":" << summary.networkSentBytes
+             << ",\"network_bytes_received\":" << summary.networkReceivedBytes
+             << ",\"receive_calls\":" << summary.receiveCalls << ",\"sink_ms\":" << std::fixed << std::setprecision(3)
+             << summary.sinkTime << "}";
+      isFirst = false;
+    }
+    stream << "}}\n";
+
+    return stream.str();
+  }
+
+  stream << CommandStats::formatHistogram("connect", CommandStats::connectTimes)
+         << CommandStats::formatHistogram("handshake", CommandStats::handshakeTimes);
+  for (const auto &[name, summary] : CommandStats::commands) {
+    stream << CommandStats::formatHistogram(name, summary.wallTimes) << "  first byte "
+           << CommandStats::formatHistogram("", summary.firstByteTimes);
+    stream << "  sent " << summary.sentBytes << " B (" << summary.networkSentBytes << " B on the network), received "
+           << summary.receivedBytes << " B (" << summary.networkReceivedBytes << " B on the network) in "
+           << summary.receiveCalls << " receive calls, " << std::fixed << std::setprecision(3) << summary.sinkTime
+           << " ms in sinks\n";
+  }
+
+  return stream.str();
+}
+
+/**
+ * @brief Print the statistics to the standard error output, registered by CommandStats::enable
+ */
+void CommandStats::printAtExit() {
+  std::cerr << CommandStats::format(CommandStats::exitFormat) << std::flush;
+}
+
+/**
+ * @brief Format a summary of times as a JSON object
+ *
+ * @param times Times in milliseconds
+ * @return std::string JSON object, e.g. {"count":2,"total":3.000,"min":1.000,...}
+ */
+std::string CommandStats::formatJsonTimes(std::vector<double> times) {
+  if (times.empty()) {
+    return "{\"count\":0}";
+  }
+
+  std::sort(times.begin(), times.end());
+  double total = 0;
+  for (double time : times) {
+    total += time;
+  }
+
+  std::ostringstream stream;
+  stream << std::fixed << std::setprecision(3) << "{\"count\":" << times.size() << ",\"total\":" << total
+         << ",\"min\":" << times.front() << ",\"mean\":" << total / times.size()
+         << ",\"p50\":" << CommandStats::getPercentile(times, 50)
+         << ",\"p90\":" << CommandStats::getPercentile(times, 90)
+         << ",\"p99\":" << CommandStats::getPercentile(times, 99) << ",\"max\":" << times.back() << "}";
+
+  return stream.str();
+}
+
+/**
+ * @brief Format times as a summary line followed by a histogram with power of two buckets
+ *
+ * @param name Name printed at the start of the summary, empty to print only the summary without the histogram
+ * @param times Times in milliseconds
+ * @return std::string Text report
+ */
+std::string CommandStats::formatHistogram(const std::string &name, std::vector<double> times) {
+  std::ostringstream stream;
+  stream << std::fixed << std::setprecision(3);
+  if (!name.empty()) {
+    stream << name << ": ";
+  }
+
+  if (times.empty()) {
+    stream << "count 0\n";
+    return stream.str();
+  }
+
+  std::sort(times.begin(), times.end());
+  stream << "count " << times.size() << ", min " << times.front() << " ms, p50 "
+         << CommandStats::getPercentile(times, 50) << " ms, p90 " << CommandStats::getPercentile(times, 90)
+         << " ms, p99 " << CommandStats::getPercentile(times, 99) << " ms, max " << times.back() << " ms\n";
+  if (name.empty()) {
+    return stream.str();
+  }
+
+  // Buckets [2^i, 2^(i+1)) ms, times below 1 us share the first bucket
+  auto getBucket = [](double time) { return static_cast<int>(std::floor(std::log2(std::max(time, 0.001)))); };
+  int firstBucket = getBucket(times.front());
+  std::vector<std::size_t> counts(getBucket(times.back()) - firstBucket + 1, 0);
+  for (double time : times) {
+    counts[getBucket(time) - firstBucket]++;
+  }
+
+  std::size_t maximumCount = *std::max_element(counts.begin(), counts.end());
+  for (std::size_t i = 0; i < counts.size(); i++) {
+    double lowerBound = std::pow(2.0, firstBucket + static_cast<int>(i));
+    std::size_t barLength = (counts[i] * 40 + maximumCount - 1) / maximumCount;
+    stream << "  [" << std::setw(12) << lowerBound << ", " << std::setw(12) << lowerBound * 2 << ") ms "
+           << std::string(barLength, '#') << std::string(40 - barLength, ' ') << " " << counts[i] << "\n";
+  }
+
+  return stream.str();
+}
+
+/**
+ * @brief Get a percentile of sorted times by the nearest rank
+ *
+ * @param sortedTimes Times sorted from the shortest
+ * @param percentile Percentile between 0 and 100
+ * @return double Time at the percentile
+ */
+double CommandStats::getPercentile(const std::vector<double> &sortedTimes, double percentile) {
+  std::size_t rank = static_cast<std::size_t>(std::ceil(percentile / 100 * sortedTimes.size()));
+  return sortedTimes[std::clamp<std::size_t>(rank, 1, sortedTimes.size()) - 1];
+}
+
+/**
+ * @brief Convert a duration to milliseconds
+ *
+ * @param duration Duration
+ * @return double Duration in milliseconds
+ */
+double CommandStats::toMilliseconds(std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
@@ -0,0 +1,114 @@
+/**
+ * IMAP client
+ *
+ * @file command_stats.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef COMMAND_STATS_H
+#define COMMAND_STATS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Process-wide statistics of commands and connections, which are printed when the program exits
+ *
+ * Connections record the wall time, time to the first byte of the response, sent and received bytes, receive calls
+ * and time spent saving literals of every command, grouped by the command name. Bytes are counted both as IMAP data
+ * and as network data, which is compressed if COMPRESS=DEFLATE is active and does not include TLS records. TCP
+ * connect and TLS handshake times are recorded too. Nothing is recorded until the statistics are enabled.
+ */
+class CommandStats {
+ public:
+  /// @brief Represents how the statistics are printed
+  enum class Format { JSON, HISTOGRAM };
+
+  /// @brief Measurements of one command that was sent and is not completed yet
+  struct Command {
+    /// @brief Command name in lower case, e.g. "uid fetch"
+    std::string name;
+    /// @brief Time when the command was sent
+    std::chrono::steady_clock::time_point startTime;
+    /// @brief Time when the first byte of the response was received
+    std::chrono::steady_clock::time_point firstByteTime;
+    /// @brief Represents if a byte of the response was received
+    bool hasFirstByte{false};
+    /// @brief Size of the command in bytes
+    std::size_t sentBytes{0};
+    /// @brief Number of response bytes framed while the command was the oldest one waiting for a response
+    std::size_t receivedBytes{0};
+    /// @brief Number of bytes written to the socket for the command after compression
+    std::size_t networkSentBytes{0};
+    /// @brief Number of bytes read from the socket while the command was the oldest one waiting for a response
+    std::size_t networkReceivedBytes{0};
+    /// @brief Number of reads from the socket while the command was the oldest one waiting for a response
+    std::size_t receiveCalls{0};
+    /// @brief Time spent passing literals of the response to a sink, e.g. writing emails to the disk
+    std::chrono::steady_clock::duration sinkTime{0};
+  };
+
+ protected:
+  /// @brief Measurements of all completed commands with the same name
+  struct Summary {
+    /// @brief Wall times of commands in milliseconds
+    std::vector<double> wallTimes;
+    /// @brief Times to the first byte of responses in milliseconds
+    std::vector<double> firstByteTimes;
+    /// @brief Total size of commands in bytes
+    std::size_t sentBytes{0};
+    /// @brief Total size of responses in bytes
+    std::size_t receivedBytes{0};
+    /// @brief Total number of bytes written to the socket
+    std::size_t networkSentBytes{0};
+    /// @brief Total number of bytes read from the socket
+    std::size_t networkReceivedBytes{0};
+    /// @brief Total number of reads from the socket
+    std::size_t receiveCalls{0};
+    /// @brief Total time spent passing literals to sinks in milliseconds
+    double sinkTime{0};
+  };
+
+  /// @brief Guards the statistics, sessions on different threads complete commands at the same time
+  static inline std::mutex mutex;
+  /// @brief Represents if the statistics are recorded
+  static inline bool enabled{false};
+  /// @brief Format used when the program exits
+  static inline Format exitFormat{Format::JSON};
+  /// @brief Completed commands by their name
+  static inline std::map<std::string, Summary> commands;
+  /// @brief TCP connect times in milliseconds
+  static inline std::vector<double> connectTimes;
+  /// @brief TLS handshake times in milliseconds
+  static inline std::vector<double> handshakeTimes;
+
+ public:
+  static void enable(Format format);
+  static bool isEnabled();
+
+  static Command startCommand(const std::string &command);
+  static void finishCommand(const Command &command);
+  static void recordConnect(std::chrono::steady_clock::duration duration);
+  static void recordHandshake(std::chrono::steady_clock::duration duration);
+
+  static std::string format(Format format);
+
+ protected:
+  static void printAtExit();
+  static std::string formatJsonTimes(std::vector<double> times);
+  static std::string formatHistogram(const std::string &name, std::vector<double> times);
+  static double getPercentile(const std::vector<double> &sortedTimes, double percentile);
+  static double toMilliseconds(std::chrono::steady_clock::duration duration);
+};
+
+#endif
@@ -8,27 +8,332 @@
 #include "connection.h"
 
 /**
- * @brief Validates that the response from the server is correctly formated
+ * @brief Send an imap command to the server and wait for its response
+ *
+ * @param tag Command tag
+ * @param command Command to send
+ * @param sink Receives the contents of literals instead of the returned response, if set
+ * @return std::string Response from the server
+ */
+std::string Connection::sendCommand(unsigned int tag, std::string command, LiteralSink *sink) {
+  this->submitCommand(tag, command);
+
+  return this->readResponse(tag, sink);
+}
+
+/**
+ * @brief Send an imap command to the server without waiting for its response
+ *
+ * @param tag Command tag
+ * @param command Command to send
+ */
+void Connection::submitCommand(unsigned int tag, std::string command) {
+  this->addOutstandingTag(std::to_string(tag), command);
+
+  // Send command to server
+  this->sendData(command);
+}
+
+/**
+ * @brief Receive data until the tagged completion response of a command arrives
+ *
+ * Responses of other commands that arrive in the meantime are kept until they are read.
  *
- * @param response Response from the server
  * @param tag Tag of sent command to server
- * @return true If response is valid
- * @return false If response is not valid
+ * @param sink Receives the contents of literals of the command instead of the returned response, if set
+ * @return std::string Response from the server
  */
-bool Connection::isResponseFull(std::string response, unsigned int tag) {
-  if (response.length() == 0) {
-    return false;
+std::string Connection::readResponse(unsigned int tag, LiteralSink *sink) {
+  std::string tagString = std::to_string(tag);
+  if (!this->responses.contains(tagString)) {
+    throw std::runtime_error("Command with tag " + tagString + " was not sent.");
   }
 
-  unsigned long lastRowStartIndex = response.substr(0, response.length() - 2).find_last_of("\r\n");
-  if (lastRowStartIndex == std::string::npos) {
-    lastRowStartIndex = 0;
+  while (!this->completedTags.contains(tagString)) {
+    if (this->receiveBuffer.isEmpty()) {
+      this->fill();
+    }
+
+    this->frameResponse(tagString, sink);
   }
 
+  return this->takeResponse(tagString);
+}
+
+/**
+ * @brief Receive data once and get the part of a command response that arrived so far
+ *
+ * Used by commands like IDLE, whose untagged responses have to be handled before the command is completed.
+ *
+ * @param tag Tag of sent command to server
+ * @return std::string Complete lines of the response that were not read yet
+ */
+std::string Connection::readAvailable(unsigned int tag) {
   std::string tagString = std::to_string(tag);
-  if (response.starts_with(tagString) || response.substr(lastRowStartIndex + 1).starts_with(tagString)) {
-    return true;
+  if (!this->responses.contains(tagString)) {
+    throw std::runtime_error("Command with tag " + tagString + " was not sent.");
+  }
+
+  if (this->receiveBuffer.isEmpty()) {
+    this->fill();
   }
+  this->frameResponse(tagString, nullptr);
+
+  std::string response = std::move(this->responses[tagString]);
+  this->responses[tagString].clear();
+
+  return response;
+}
+
+/**
+ * @brief Receive data until it ends with a line break, e.g. the server greeting
+ *
+ * @return std::string Received data that was not framed yet
+ */
+std::string Connection::receive() {
+  do {
+    this->fill();
+  } while (!this->receiveBuffer.getView().ends_with("\r\n"));
 
+  std::string data{this->receiveBuffer.getView()};
+  this->receiveBuffer.consume(data.length());
+
+  return data;
+}
+
+/**
+ * @brief Send data to the server, which is compressed if compression was started
+ *
+ * @param data Data to send
+ */
+void Connection::sendData(std::string data) {
+  if (this->compression) {
+    data = this->compression->compress(data);
+  }
+
+  this->recordSend(data.size());
+  this->writeData(std::move(data));
+}
+
+/**
+ * @brief Set the minimum number of bytes requested from the socket by a single read
+ *
+ * @param readSize Read size in bytes
+ */
+void Connection::setReadSize(std::size_t readSize) {
+  this->receiveBuffer.setReadSize(readSize);
+}
+
+/**
+ * @brief Compress all following data in both directions, after the server accepted the COMPRESS DEFLATE command
+ */
+void Connection::startCompression() {
+  this->compression = std::make_unique<DeflateStream>();
+
+  // Data received after the tagged response of the command is already compressed
+  std::string received{this->receiveBuffer.getView()};
+  this->receiveBuffer.consume(received.size());
+  this->compression->decompress(received.data(), received.size(), this->receiveBuffer);
+}
+
+/**
+ * @brief Get untagged responses that were received while no command was waiting for a response
+ *
+ * @return std::string Untagged responses
+ */
+std::string Connection::takeUnsolicited() {
+  std::string response = std::move(this->unsolicited);
+  this->unsolicited.clear();
+
+  return response;
+}
+
+/**
+ * @brief Check if received data can be read without waiting for the server
+ *
+ * @return true If data was already received
+ * @return false If reading would wait for the server
+ */
+bool Connection::hasPendingData() {
+  return !this->receiveBuffer.isEmpty() || this->hasBufferedData();
+}
+
+/**
+ * @brief Check if the connection holds received data that is not visible on the socket
+ *
+ * @return true If data is buffered
+ * @return false If no data is buffered
+ */
+bool Connection::hasBufferedData() {
   return false;
 }
+
+/**
+ * @brief Read data from the server directly into the receive buffer
+ *
+ * Compressed data is read into a separate buffer first and decompressed into the receive buffer.
+ */
+void Connection::fill() {
+  if (this->compression) {
+    char *input = this->compression->prepareInput(this->receiveBuffer.getReadSize());
+    std::size_t bytes = this->readSome(input, this->receiveBuffer.getReadSize());
+    this->recordReceive(bytes);
+    this->compression->decompress(input, bytes, this->receiveBuffer);
+    return;
+  }
+
+  char *buffer = this->receiveBuffer.prepare();
+  std::size_t bytes = this->readSome(buffer, this->receiveBuffer.getWritableSize());
+  this->receiveBuffer.commit(bytes);
+  this->recordReceive(bytes);
+}
+
+/**
+ * @brief Record a read from the socket for the oldest command that is waiting for a response
+ *
+ * @param bytes Number of bytes read from the socket, before they are decompressed
+ */
+void Connection::recordReceive(std::size_t bytes) {
+  if (!CommandStats::isEnabled()) {
+    return;
+  }
+
+  this->receiveTime = std::chrono::steady_clock::now();
+  if (!this->outstandingTags.empty()) {
+    CommandStats::Command &stats = this->commandStats[this->outstandingTags.front()];
+    stats.receiveCalls++;
+    stats.networkReceivedBytes += bytes;
+  }
+}
+
+/**
+ * @brief Record a write to the socket for the last sent command
+ *
+ * @param bytes Number of bytes written to the socket, after they are compressed
+ */
+void Connection::recordSend(std::size_t bytes) {
+  if (CommandStats::isEnabled() && !this->outstandingTags.empty()) {
+    this->commandStats[this->outstandingTags.back()].networkSentBytes += bytes;
+  }
+}
+
+/**
+ * @brief Expect the response of a command that is being sent
+ *
+ * @param tag Command tag
+ * @param command Command to send, which is measured if statistics are enabled
+ */
+void Connection::addOutstandingTag(const std::string &tag, const std::string &command) {
+  this->outstandingTags.push_back(tag);
+  this->responses[tag];
+
+  if (CommandStats::isEnabled()) {
+    this->commandStats[tag] = CommandStats::startCommand(command);
+  }
+}
+
+/**
+ * @brief Remove the response of a completed command
+ *
+ * @param tag Command tag
+ * @return std::string Response from the server
+ */
+std::string Connection::takeResponse(const std::string &tag) {
+  std::string response = std::move(this->responses[tag]);
+  this->responses.erase(tag);
+  this->completedTags.erase(tag);
+
+  return response;
+}
+
+/**
+ * @brief Frame pending data into response lines until it runs out or a command is completed
+ *
+ * @param tag Tag of the command that is waiting for its response
+ * @param sink Receives the contents of literals of the command, if set
+ */
+void Connection::frameResponse(const std::string &tag, LiteralSink *sink) {
+  const char *data = this->receiveBuffer.getData();
+  std::size_t size = this->receiveBuffer.getSize();
+  std::size_t offset = 0;
+  while (offset < size && !this->completedTags.contains(tag)) {
+    bool isLiteral = this->framer.isReadingLiteral();
+    std::size_t count = this->framer.feed(data + offset, size - offset);
+
+    // Received bytes belong to the oldest command, like untagged responses
+    CommandStats::Command *stats = nullptr;
+    std::chrono::steady_clock::time_point sinkStartTime;
+    if (CommandStats::isEnabled() && !this->outstandingTags.empty()) {
+      stats = &this->commandStats[this->outstandingTags.front()];
+      stats->receivedBytes += count;
+      if (!stats->hasFirstByte) {
+        stats->firstByteTime = this->receiveTime;
+        stats->hasFirstByte = true;
+      }
+      sinkStartTime = std::chrono::steady_clock::now();
+    }
+
+    // Literals of untagged responses that belong to the command are handed to the sink
+    bool isSinkLine = sink != nullptr && !this->outstandingTags.empty() && this->outstandingTags.front() == tag;
+    if (isLiteral && isSinkLine) {
+      sink->writeLiteral(data + offset, count);
+      if (!this->framer.isReadingLiteral()) {
+        sink->endLiteral();
+      }
+    } else {
+      this->line.append(data + offset, count);
+      if (!isLiteral && this->framer.isReadingLiteral() && isSinkLine) {
+        sink->beginLiteral(this->framer.getSegment(), this->framer.getLiteralSize());
+      }
+    }
+    offset += count;
+
+    if (stats != nullptr && isSinkLine) {
+      stats->sinkTime += std::chrono::steady_clock::now() - sinkStartTime;
+    }
+
+    if (!this->framer.isLineComplete()) {
+      continue;
+    }
+
+    // Route the line to the command it belongs to
+    this->getLineOwner()->append(this->line);
+    if (this->framer.isTagged()) {
+      std::string lineTag{this->framer.getTag()};
+
+      // A tagged line of a command that was not sent is kept with untagged responses by getLineOwner
+      if (std::erase(this->outstandingTags, lineTag) > 0) {
+        this->completedTags.insert(lineTag);
+      }
+
+      auto stats = this->commandStats.find(lineTag);
+      if (stats != this->commandStats.end()) {
+        CommandStats::finishCommand(stats->second);
+        this->commandStats.erase(stats);
+      }
+    }
+
+    this->line.clear();
+    this->framer.nextLine();
+  }
+
+  this->receiveBuffer.consume(offset);
+}
+
+/**
+ * @brief Get the response where the framed line belongs
+ *
+ * @return std::string* Response of the command, or unsolicited responses if no command is waiting
+ */
+std::string *Connection::getLineOwner() {
+  if (this->framer.isTagged()) {
+    std::string lineTag{this->framer.getTag()};
+    if (this->responses.contains(lineTag)) {
+      return &this->responses[lineTag];
+    }
+  } else if (!this->outstandingTags.empty()) {
+    return &this->responses[this->outstandingTags.front()];
+  }
+
+  return &this->unsolicited;
+}
@@ -8,21 +8,81 @@
 #ifndef CONNECTION_H
 #define CONNECTION_H
 
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <stdexcept>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "command_stats.h"
+#include "deflate_stream.h"
+#include "literal_sink.h"
+#include "receive_buffer.h"
+#include "response_framer.h"
 
 /**
  * @brief Represents a connection to a server
+ *
+ * Multiple commands can be sent before their responses are read. Tagged responses are routed to their command by tag
+ * and untagged responses belong to the oldest command that has not been completed yet.
  */
 class Connection {
+  // Records the data of another connection by calling its read and write functions
+  friend class RecordingConnection;
+
+ protected:
+  /// @brief Received data that was not framed yet
+  ReceiveBuffer receiveBuffer;
+  /// @brief Splits received data into response lines
+  ResponseFramer framer;
+  /// @brief Text of the line that is currently being framed
+  std::string line;
+
+  /// @brief Tags of sent commands that were not completed yet, from the oldest
+  std::deque<std::string> outstandingTags;
+  /// @brief Responses of sent commands, including completed responses that were not read yet
+  std::unordered_map<std::string, std::string> responses;
+  /// @brief Tags of completed commands whose responses were not read yet
+  std::unordered_set<std::string> completedTags;
+  /// @brief Untagged responses received while no command was waiting for a response
+  std::string unsolicited;
+  /// @brief Compression of sent and received data, nullptr until COMPRESS DEFLATE succeeds
+  std::unique_ptr<DeflateStream> compression;
+  /// @brief Measurements of sent commands that were not completed yet, only kept while statistics are enabled
+  std::unordered_map<std::string, CommandStats::Command> commandStats;
+  /// @brief Time of the last read from the socket
+  std::chrono::steady_clock::time_point receiveTime;
+
  public:
   virtual ~Connection() = default;
 
-  virtual std::string sendCommand(unsigned int tag, std::string command) = 0;
-  virtual std::string receive() = 0;
+  std::string sendCommand(unsigned int tag, std::string command, LiteralSink *sink = nullptr);
+  void submitCommand(unsigned int tag, std::string command);
+  std::string readResponse(unsigned int tag, LiteralSink *sink = nullptr);
+  std::string readAvailable(unsigned int tag);
+  std::string takeUnsolicited();
+  bool hasPendingData();
+
+  std::string receive();
+  void sendData(std::string data);
+  void setReadSize(std::size_t readSize);
+  void startCompression();
 
   virtual int getFd() = 0;
 
-  bool isResponseFull(std::string response, unsigned int tag);
+ protected:
+  virtual void writeData(std::string data) = 0;
+  virtual std::size_t readSome(char *buffer, std::size_t size) = 0;
+  virtual bool hasBufferedData();
+  void fill();
+  void addOutstandingTag(const std::string &tag, const std::string &command);
+  void recordReceive(std::size_t bytes);
+  void recordSend(std::size_t bytes);
+  std::string takeResponse(const std::string &tag);
+  void frameResponse(const std::string &tag, LiteralSink *sink);
+  std::string *getLineOwner();
 };
 
 #endif
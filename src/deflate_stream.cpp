@@ -0,0 +1,115 @@
+/**
+ * IMAP client
+ *
+ * @file deflate_stream.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include "deflate_stream.h"
+
+/**
+ * @brief Construct a new DeflateStream object
+ */
+DeflateStream::DeflateStream() {
+  // Negative window bits select raw deflate without the zlib header, which the extension requires
+  if (deflateInit2(&this->deflater, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    throw std::runtime_error("Could not initialize compression.");
+  }
+
+  if (inflateInit2(&this->inflater, -15) != Z_OK) {
+    deflateEnd(&this->deflater);
+    throw std::runtime_error("Could not initialize compression.");
+  }
+}
+
+/**
+ * @brief Destroy the DeflateStream object
+ */
+DeflateStream::~DeflateStream() {
+  deflateEnd(&this->deflater);
+  inflateEnd(&this->inflater);
+}
+
+/**
+ * @brief Compress data that is sent to the server
+ *
+ * @param data Data to send
+ * @return std::string Compressed data, which can be decompressed without waiting for more data
+ */
+std::string DeflateStream::compress(std::string_view data) {
+  std::string output(deflateBound(&this->deflater, data.size()) + 16, '\0');
+  std::size_t written = 0;
+
+  this->deflater.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+  this->deflater.avail_in = data.size();
+  do {
+    if (written == output.size()) {
+      output.resize(output.size() * 2);
+    }
+
+    this->deflater.next_out = reinterpret_cast<Bytef *>(output.data() + written);
+    this->deflater.avail_out = output.size() - written;
+    if (deflate(&this->deflater, Z_SYNC_FLUSH) == Z_STREAM_ERROR) {
+      throw std::runtime_error("Could not compress data.");
+    }
+
+    written = output.size() - this->deflater.avail_out;
+  } while (this->deflater.avail_out == 0);
+
+  output.resize(written);
+  return output;
+}
+
+/**
+ * @brief Get memory for received compressed data
+ *
+ * @param size Minimum size of the memory
+ * @return char* Memory which is valid until the next call
+ */
+char *DeflateStream::prepareInput(std::size_t size) {
+  if (this->inputCapacity < size) {
+    this->input = std::make_unique_for_overwrite<char[]>(size);
+    this->inputCapacity = size;
+  }
+
+  return this->input.get();
+}
+
+/**
+ * @brief Decompress data received from the server into the receive buffer
+ *
+ * @param data Compressed data
+ * @param size Size of compressed data
+ * @param output Buffer for decompressed data
+ * @return std::size_t Number of decompressed bytes, 0 if the data ends in the middle of a deflate block
+ */
+std::size_t DeflateStream::decompress(const char *data, std::size_t size, ReceiveBuffer &output) {
+  std::size_t decompressed = 0;
+
+  this->inflater.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+  this->inflater.avail_in = size;
+  do {
+    char *buffer = output.prepare();
+    std::size_t space = output.getWritableSize();
+    this->inflater.next_out = reinterpret_cast<Bytef *>(buffer);
+    this->inflater.avail_out = space;
+
+    int result = inflate(&this->inflater, Z_SYNC_FLUSH);
+    if (result != Z_OK && result != Z_BUF_ERROR && result != Z_STREAM_END) {
+      throw std::runtime_error("Could not decompress data received from server.");
+    }
+
+    std::size_t bytes = space - this->inflater.avail_out;
+    output.commit(bytes);
+    decompressed += bytes;
+
+    // The server does not send anything after the end of its stream
+    if (result == Z_STREAM_END) {
+      break;
+    }
+
+    // Output that filled the whole free space can be followed by more output, even without more input
+  } while (this->inflater.avail_in > 0 || this->inflater.avail_out == 0);
+
+  return decompressed;
+}
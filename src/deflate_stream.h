@@ -0,0 +1,51 @@
+/**
+ * IMAP client
+ *
+ * @file deflate_stream.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef DEFLATE_STREAM_H
+#define DEFLATE_STREAM_H
+
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <zlib.h>
+
+#include "receive_buffer.h"
+
+/**
+ * @brief Compression of both directions of a connection by the COMPRESS=DEFLATE extension (RFC 4978)
+ *
+ * Both directions are raw deflate streams without zlib headers, which last until the connection is closed. Sent data is
+ * flushed after every command, so the server can decompress the whole command at once.
+ */
+class DeflateStream {
+ protected:
+  /// @brief State of the compression of sent data
+  z_stream deflater{};
+  /// @brief State of the decompression of received data
+  z_stream inflater{};
+  /// @brief Received compressed data that is decompressed into the receive buffer
+  std::unique_ptr<char[]> input;
+  /// @brief Size of the memory for received compressed data
+  std::size_t inputCapacity{0};
+
+ public:
+  DeflateStream();
+  ~DeflateStream();
+
+  DeflateStream(const DeflateStream &) = delete;
+  DeflateStream &operator=(const DeflateStream &) = delete;
+
+  std::string compress(std::string_view data);
+
+  char *prepareInput(std::size_t size);
+  std::size_t decompress(const char *data, std::size_t size, ReceiveBuffer &output);
+};
+
+#endif
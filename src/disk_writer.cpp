@@ -0,0 +1,27 @@
+/**
+ * IMAP client
+ *
+ * @file disk_writer.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include "disk_writer.h"
+
+#include "io_uring_disk_writer.h"
+#include "thread_pool_disk_writer.h"
+
+/**
+ * @brief Create a disk writer backed by io_uring, or by a pool of threads if the kernel does not support it
+ *
+ * @return std::unique_ptr<DiskWriter> Disk writer
+ */
+std::unique_ptr<DiskWriter> DiskWriter::create() {
+  std::size_t queueDepth = DiskWriter::QUEUE_DEPTH;
+  unsigned int threadCount = ThreadPoolDiskWriter::THREAD_COUNT;
+
+  try {
+    return std::make_unique<IOUringDiskWriter>(queueDepth);
+  } catch (const std::exception &) {
+    return std::make_unique<ThreadPoolDiskWriter>(threadCount, queueDepth);
+  }
+}
@@ -0,0 +1,47 @@
+/**
+ * IMAP client
+ *
+ * @file disk_writer.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef DISK_WRITER_H
+#define DISK_WRITER_H
+
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+/**
+ * @brief Writes whole files in the background, so the next emails can be received while previous ones are written
+ *
+ * At most QUEUE_DEPTH files are written at once, submit waits for a free slot, which limits the memory of emails that
+ * were received but not written yet.
+ */
+class DiskWriter {
+ public:
+  static const std::size_t QUEUE_DEPTH = 64;
+
+  virtual ~DiskWriter() = default;
+
+  static std::unique_ptr<DiskWriter> create();
+
+  /**
+   * @brief Start writing a file, which is created or truncated
+   *
+   * @param path Path of the file
+   * @param data Contents of the file
+   */
+  virtual void submit(std::string path, std::string data) = 0;
+
+  /**
+   * @brief Wait until all submitted files are written
+   *
+   * Throws an exception if any file could not be written, also on every later call, so files submitted together
+   * with a failed file are never treated as written.
+   */
+  virtual void wait() = 0;
+};
+
+#endif
@@ -0,0 +1,284 @@
+/**
+ * IMAP client
+ *
+ * @file email_writer.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include "email_writer.h"
+
+#include "maildir_writer.h"
+#include "store_writer.h"
+
+/**
+ * @brief Construct a new email writer
+ *
+ * @param directoryPath Path where to save emails
+ * @param hostname Imap server hostname
+ * @param mailbox Mailbox from where emails are fetched
+ */
+EmailWriter::EmailWriter(std::string directoryPath, std::string hostname, std::string mailbox)
+    : directoryPath{directoryPath}, hostname{hostname}, mailbox{mailbox} {}
+
+/**
+ * @brief Create a writer which stores emails in a format
+ *
+ * @param format Format of the output directory
+ * @param directoryPath Path where to save emails
+ * @param hostname Imap server hostname
+ * @param mailbox Mailbox from where emails are fetched
+ * @param isWritingAsync Write received emails in the background while next emails are received
+ * @return std::unique_ptr<EmailWriter> Email writer
+ */
+std::unique_ptr<EmailWriter> EmailWriter::create(Format format,
+                                                 std::string directoryPath,
+                                                 std::string hostname,
+                                                 std::string mailbox,
+                                                 bool isWritingAsync) {
+  std::unique_ptr<EmailWriter> writer;
+  if (format == Format::MAILDIR) {
+    writer = std::make_unique<MaildirWriter>(directoryPath, hostname, mailbox);
+  } else if (format == Format::STORE) {
+    // Emails are hashed while they are written, so the store writes them itself
+    return std::make_unique<StoreWriter>(directoryPath, hostname, mailbox);
+  } else {
+    writer = std::make_unique<EmailWriter>(directoryPath, hostname, mailbox);
+  }
+
+  if (isWritingAsync) {
+    writer->diskWriter = DiskWriter::create();
+  }
+
+  return writer;
+}
+
+/**
+ * @brief Open the file of an email announced in a FETCH response
+ *
+ * @param line Line text which announces the literal, e.g. "* 1 FETCH (UID 7 BODY[] {42}"
+ * @param size Size of the email in bytes
+ */
+void EmailWriter::beginLiteral(std::string_view line, std::size_t size) {
+  // Only literals of FETCH responses contain emails
+  if (!EmailWriter::isEmailLiteral(line)) {
+    this->isWriting = false;
+    return;
+  }
+
+  std::string emailUID = EmailWriter::getEmailUID(line);
+  std::string outputFilePath = this->directoryPath + (this->directoryPath.ends_with("/") ? "" : "/") +
+                               EmailWriter::getFileName(this->hostname, this->mailbox, emailUID);
+
+  // Keep the email in memory, the disk writer writes it after it is received
+  if (this->diskWriter) {
+    this->contentPath = outputFilePath;
+    this->content.clear();
+    this->content.reserve(size);
+    this->isWriting = true;
+    return;
+  }
+
+  this->file.open(outputFilePath, std::ios::binary | std::ios::trunc);
+  if (!this->file.is_open()) {
+    throw std::runtime_error("Could not open file " + outputFilePath + ".");
+  }
+  this->isWriting = true;
+}
+
+/**
+ * @brief Append a part of the email to its file
+ *
+ * @param data Part of the email
+ * @param size Size of the part
+ */
+void EmailWriter::writeLiteral(const char *data, std::size_t size) {
+  if (!this->isWriting) {
+    return;
+  }
+
+  if (this->diskWriter) {
+    this->content.append(data, size);
+    return;
+  }
+
+  if (!this->file.write(data, size)) {
+    throw std::runtime_error("Could not write email to file.");
+  }
+}
+
+/**
+ * @brief Close the file of the email
+ */
+void EmailWriter::endLiteral() {
+  if (!this->isWriting) {
+    return;
+  }
+
+  if (this->diskWriter) {
+    this->diskWriter->submit(std::move(this->contentPath), std::move(this->content));
+    this->content = {};
+  } else {
+    this->file.close();
+  }
+  this->isWriting = false;
+  this->count++;
+}
+
+/**
+ * @brief Wait until emails written in the background are saved, files are not synchronized to the disk
+ */
+void EmailWriter::flush() {
+  if (this->diskWriter) {
+    this->diskWriter->wait();
+  }
+}
+
+/**
+ * @brief Delete the file of an email
+ *
+ * @param uid UID of the email
+ */
+void EmailWriter::deleteEmail(std::string uid) {
+  std::filesystem::remove(std::filesystem::path{this->directoryPath} /
+                          EmailWriter::getFileName(this->hostname, this->mailbox, uid));
+}
+
+/**
+ * @brief Delete files of all emails from the mailbox
+ */
+void EmailWriter::deleteAll() {
+  // Check if email directory exists
+  if (!std::filesystem::is_directory(this->directoryPath)) {
+    return;
+  }
+
+  std::string prefix = EmailWriter::getFilePrefix(this->hostname, this->mailbox);
+  for (const auto &file : std::filesystem::directory_iterator(this->directoryPath)) {
+    // Check if email filename starts with hostname and mailbox
+    if (file.is_regular_file() && file.path().filename().string().starts_with(prefix)) {
+      std::filesystem::remove(file.path());
+    }
+  }
+}
+
+/**
+ * @brief Get the number of saved emails
+ *
+ * @return std::size_t Saved emails count
+ */
+std::size_t EmailWriter::getCount() {
+  return this->count;
+}
+
+/**
+ * @brief Get the UID of an email from the line of a FETCH response that announces its contents
+ *
+ * The UID data item must precede the contents, which is the case when it is requested first. Otherwise the sequence
+ * number of the email is used.
+ *
+ * @param line Line text, e.g. "* 1 FETCH (UID 42 BODY[] {10}"
+ * @return std::string UID of the email
+ */
+std::string EmailWriter::getEmailUID(std::string_view line) {
+  std::string lowerCaseLine{line};
+  std::transform(lowerCaseLine.begin(), lowerCaseLine.end(), lowerCaseLine.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+
+  std::size_t uidStart = lowerCaseLine.find("(uid ");
+  if (uidStart == std::string::npos) {
+    uidStart = lowerCaseLine.find(" uid ");
+  }
+
+  if (uidStart == std::string::npos) {
+    // Use the sequence number
+    return std::string{line.substr(2, line.find_first_of(' ', 2) - 2)};
+  }
+
+  uidStart += 5;
+  std::size_t uidEnd = lowerCaseLine.find_first_not_of("0123456789", uidStart);
+  return std::string{line.substr(uidStart, uidEnd - uidStart)};
+}
+
+/**
+ * @brief Get the name of the file where an email is saved
+ *
+ * @param hostname Imap server hostname
+ * @param mailbox Mailbox of the email
+ * @param uid UID of the email
+ * @return std::string File name of the email
+ */
+std::string EmailWriter::getFileName(std::string hostname, std::string mailbox, std::string uid) {
+  return EmailWriter::getFilePrefix(hostname, mailbox) + uid + ".eml";
+}
+
+/**
+ * @brief Get the beginning of file names of all emails from a mailbox
+ *
+ * @param hostname Imap server hostname
+ * @param mailbox Mailbox of the emails
+ * @return std::string File name prefix, where hierarchy separators in the mailbox name are replaced
+ */
+std::string EmailWriter::getFilePrefix(std::string hostname, std::string mailbox) {
+  std::replace(mailbox.begin(), mailbox.end(), '/', '_');
+
+  return hostname + "_" + mailbox + "_";
+}
+
+/**
+ * @brief Get the value of a field from the header of an email
+ *
+ * @param header Header of the email, the body may follow it
+ * @param name Name of the field in lower case, e.g. "subject"
+ * @return std::string Value of the first field with the name, where folded lines are joined and surrounding
+ * whitespace is removed, empty if the header does not contain the field
+ */
+std::string EmailWriter::getHeaderField(std::string_view header, std::string_view name) {
+  std::size_t position = 0;
+
+  while (position < header.length()) {
+    std::size_t lineEnd = std::min(header.find("\r\n", position), header.length());
+    std::string_view line = header.substr(position, lineEnd - position);
+    position = lineEnd + 2;
+
+    // An empty line ends the header
+    if (line.empty()) {
+      break;
+    }
+
+    if (line.length() <= name.length() || line[name.length()] != ':' ||
+        !std::equal(name.begin(), name.end(), line.begin(),
+                    [](char nameCharacter, char character) { return nameCharacter == std::tolower(character); })) {
+      continue;
+    }
+
+    // Join the continuation lines of a folded field
+    std::string value{line.substr(name.length() + 1)};
+    while (position < header.length() && (header[position] == ' ' || header[position] == '\t')) {
+      lineEnd = std::min(header.find("\r\n", position), header.length());
+      value += header.substr(position, lineEnd - position);
+      position = lineEnd + 2;
+    }
+
+    std::size_t valueStart = value.find_first_not_of(" \t");
+    if (valueStart == std::string::npos) {
+      return "";
+    }
+
+    return value.substr(valueStart, value.find_last_not_of(" \t") - valueStart + 1);
+  }
+
+  return "";
+}
+
+/**
+ * @brief Check if a literal contains an email, which is the case for literals of FETCH responses
+ *
+ * @param line Line text which announces the literal, e.g. "* 1 FETCH (UID 7 BODY[] {42}"
+ * @return true If the literal contains an email
+ * @return false If the literal belongs to another response
+ */
+bool EmailWriter::isEmailLiteral(std::string_view line) {
+  std::size_t sequenceNumberEnd = line.find_first_of(' ', 2);
+  return line.starts_with("* ") && sequenceNumberEnd != std::string_view::npos &&
+         line.substr(sequenceNumberEnd + 1, 5) == "FETCH";
+}
@@ -0,0 +1,90 @@
+/**
+ * IMAP client
+ *
+ * @file email_writer.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef EMAIL_WRITER_H
+#define EMAIL_WRITER_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "disk_writer.h"
+#include "literal_sink.h"
+
+/**
+ * @brief Writes emails from a FETCH response to files as their contents arrive from the server
+ */
+class EmailWriter : public LiteralSink {
+ public:
+  /**
+   * @brief Specifies how emails are stored in the output directory
+   */
+  enum class Format {
+    /// @brief One file per email named by the hostname, mailbox and UID
+    FILES,
+    /// @brief One Maildir per mailbox
+    MAILDIR,
+    /// @brief Files named like FILES, which are hard links to single copies in a content-addressed store
+    STORE
+  };
+
+ protected:
+  /// @brief Path where to save emails
+  std::string directoryPath;
+  /// @brief Imap server hostname
+  std::string hostname;
+  /// @brief Mailbox from where emails are fetched
+  std::string mailbox;
+
+  /// @brief File of the email that is currently being written
+  std::ofstream file;
+  /// @brief Represents if the current literal is written to a file
+  bool isWriting{false};
+  /// @brief Number of saved emails
+  std::size_t count{0};
+
+  /// @brief Writes received emails in the background, nullptr if emails are written while they are received
+  std::unique_ptr<DiskWriter> diskWriter;
+  /// @brief Path of the email that is currently being received by the disk writer
+  std::string contentPath;
+  /// @brief Contents of the email that is currently being received by the disk writer
+  std::string content;
+
+ public:
+  EmailWriter(std::string directoryPath, std::string hostname, std::string mailbox);
+  ~EmailWriter() override = default;
+
+  static std::unique_ptr<EmailWriter> create(Format format,
+                                             std::string directoryPath,
+                                             std::string hostname,
+                                             std::string mailbox,
+                                             bool isWritingAsync = false);
+
+  void beginLiteral(std::string_view line, std::size_t size) override;
+  void writeLiteral(const char *data, std::size_t size) override;
+  void endLiteral() override;
+
+  virtual void flush();
+  virtual void deleteEmail(std::string uid);
+  virtual void deleteAll();
+
+  std::size_t getCount();
+
+  static std::string getEmailUID(std::string_view line);
+  static std::string getFileName(std::string hostname, std::string mailbox, std::string uid);
+  static std::string getFilePrefix(std::string hostname, std::string mailbox);
+  static std::string getHeaderField(std::string_view header, std::string_view name);
+  static bool isEmailLiteral(std::string_view line);
+};
+
+#endif
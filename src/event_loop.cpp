@@ -0,0 +1,148 @@
+/**
+ * IMAP client
+ *
+ * @file event_loop.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include "event_loop.h"
+
+/**
+ * @brief Construct a new EventLoop object
+ */
+EventLoop::EventLoop() {
+  this->epollFd = epoll_create1(EPOLL_CLOEXEC);
+  if (this->epollFd < 0) {
+    throw std::runtime_error("Could not create event loop.");
+  }
+}
+
+/**
+ * @brief Destroy the EventLoop object
+ */
+EventLoop::~EventLoop() {
+  close(this->epollFd);
+}
+
+/**
+ * @brief Get an awaitable that suspends the awaiting coroutine until a file descriptor is ready
+ *
+ * @param fd File descriptor to wait for
+ * @param events EPOLLIN to wait until data can be read, EPOLLOUT to wait until data can be sent
+ * @return FdAwaiter Awaitable
+ */
+EventLoop::FdAwaiter EventLoop::waitFor(int fd, uint32_t events) {
+  return FdAwaiter{*this, fd, events};
+}
+
+/**
+ * @brief Stop watching a file descriptor before it is closed
+ *
+ * @param fd File descriptor
+ */
+void EventLoop::forget(int fd) {
+  if (this->registeredFds.erase(fd) > 0) {
+    epoll_ctl(this->epollFd, EPOLL_CTL_DEL, fd, nullptr);
+  }
+  this->waiting.erase(fd);
+}
+
+/**
+ * @brief Start a task, which runs when the loop runs
+ *
+ * @param task Task to start
+ */
+void EventLoop::spawn(Task<void> task) {
+  this->ready.push_back(task.getHandle());
+  this->tasks.push_back(std::move(task));
+}
+
+/**
+ * @brief Run spawned tasks until all of them are finished
+ *
+ * The first exception thrown by a task is rethrown after all tasks are finished.
+ */
+void EventLoop::run() {
+  std::vector<epoll_event> events(64);
+
+  while (this->hasUnfinishedTasks()) {
+    // Resume coroutines that do not wait for a socket
+    while (!this->ready.empty()) {
+      std::coroutine_handle<> handle = this->ready.front();
+      this->ready.pop_front();
+      handle.resume();
+    }
+
+    if (!this->hasUnfinishedTasks()) {
+      break;
+    }
+
+    if (this->waiting.empty()) {
+      throw std::runtime_error("Tasks of the event loop can not continue.");
+    }
+
+    int count = epoll_wait(this->epollFd, events.data(), events.size(), -1);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error("Could not wait for events.");
+    }
+
+    for (int event = 0; event < count; event++) {
+      auto waiter = this->waiting.find(events[event].data.fd);
+      if (waiter != this->waiting.end()) {
+        this->ready.push_back(waiter->second);
+        this->waiting.erase(waiter);
+      }
+    }
+  }
+
+  std::vector<Task<void>> finishedTasks = std::move(this->tasks);
+  this->tasks.clear();
+  for (Task<void> &task : finishedTasks) {
+    task.getResult();
+  }
+}
+
+/**
+ * @brief Resume a coroutine once a file descriptor is ready
+ *
+ * Only one coroutine can wait for a file descriptor at a time. The file descriptor is watched only until the first
+ * event, so it does not wake up the loop while nobody waits for it.
+ *
+ * @param fd File descriptor to wait for
+ * @param events Events to wait for
+ * @param handle Coroutine to resume
+ */
+void EventLoop::watch(int fd, uint32_t events, std::coroutine_handle<> handle) {
+  epoll_event event{};
+  event.events = events | EPOLLONESHOT;
+  event.data.fd = fd;
+
+  // A closed file descriptor is removed from epoll, so its number can be registered again by another socket
+  bool isRegistered = this->registeredFds.contains(fd);
+  if (epoll_ctl(this->epollFd, isRegistered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event) != 0 &&
+      (!isRegistered || errno != ENOENT || epoll_ctl(this->epollFd, EPOLL_CTL_ADD, fd, &event) != 0)) {
+    throw std::runtime_error("Could not watch socket.");
+  }
+
+  this->registeredFds.insert(fd);
+  this->waiting[fd] = handle;
+}
+
+/**
+ * @brief Check if any spawned task is not finished
+ *
+ * @return true If a task is not finished
+ * @return false If all tasks are finished
+ */
+bool EventLoop::hasUnfinishedTasks() const {
+  for (const Task<void> &task : this->tasks) {
+    if (!task.isDone()) {
+      return true;
+    }
+  }
+
+  return false;
+}
@@ -0,0 +1,70 @@
+/**
+ * IMAP client
+ *
+ * @file event_loop.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <errno.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "task.h"
+
+/**
+ * @brief Runs tasks on one thread and resumes them when their sockets are ready, using epoll
+ */
+class EventLoop {
+ protected:
+  /// @brief Epoll file descriptor
+  int epollFd;
+  /// @brief Coroutines waiting for a file descriptor to become ready
+  std::unordered_map<int, std::coroutine_handle<>> waiting;
+  /// @brief File descriptors registered in epoll
+  std::unordered_set<int> registeredFds;
+  /// @brief Coroutines that can be resumed without waiting
+  std::deque<std::coroutine_handle<>> ready;
+  /// @brief Tasks started by spawn
+  std::vector<Task<void>> tasks;
+
+  /**
+   * @brief Suspends a coroutine until a file descriptor is ready
+   */
+  struct FdAwaiter {
+    EventLoop &loop;
+    int fd;
+    uint32_t events;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) { this->loop.watch(this->fd, this->events, handle); }
+    void await_resume() const noexcept {}
+  };
+
+ public:
+  EventLoop();
+  EventLoop(const EventLoop &) = delete;
+  ~EventLoop();
+
+  FdAwaiter waitFor(int fd, uint32_t events);
+  void forget(int fd);
+
+  void spawn(Task<void> task);
+  void run();
+
+ protected:
+  void watch(int fd, uint32_t events, std::coroutine_handle<> handle);
+  bool hasUnfinishedTasks() const;
+};
+
+#endif
@@ -0,0 +1,226 @@
+/**
+ * IMAP client
+ *
+ * @file fetched_emails.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include "fetched_emails.h"
+
+/**
+ * @brief Construct a new FetchedEmails object which takes over the memory and emails of another object
+ *
+ * @param other Object which is left without emails, so its next literals get new blocks
+ */
+FetchedEmails::FetchedEmails(FetchedEmails &&other) {
+  *this = std::move(other);
+}
+
+/**
+ * @brief Release the memory of this object and take over the memory and emails of another object
+ *
+ * @param other Object which is left without emails, so its next literals get new blocks
+ * @return FetchedEmails& This object
+ */
+FetchedEmails &FetchedEmails::operator=(FetchedEmails &&other) {
+  if (this == &other) {
+    return *this;
+  }
+
+  this->blocks = std::move(other.blocks);
+  this->freeSpace = other.freeSpace;
+  this->freeSize = other.freeSize;
+  this->emails = std::move(other.emails);
+  this->isReceiving = other.isReceiving;
+  this->body = other.body;
+  this->bodyLength = other.bodyLength;
+  this->bodySize = other.bodySize;
+
+  // The raw pointers of the other object point into blocks that are owned by this object now
+  other.release();
+
+  return *this;
+}
+
+/**
+ * @brief Reserve space for an email announced by a literal of a FETCH response and keep its flags
+ *
+ * @param line Line text which announces the literal
+ * @param size Size of the literal in bytes
+ */
+void FetchedEmails::beginLiteral(std::string_view line, std::size_t size) {
+  // Only literals of FETCH responses contain emails
+  this->isReceiving = EmailWriter::isEmailLiteral(line);
+  if (!this->isReceiving) {
+    return;
+  }
+
+  // Flags are stored right before the contents of the email
+  std::string_view flags = FetchedEmails::parseFlags(line);
+  char *space = this->allocate(flags.length() + size);
+  memcpy(space, flags.data(), flags.length());
+
+  this->body = space + flags.length();
+  this->bodyLength = 0;
+  this->bodySize = size;
+  this->emails.push_back({FetchedEmails::parseUID(line), std::string_view{space, flags.length()}, {}});
+}
+
+/**
+ * @brief Copy a part of the email into its space
+ *
+ * @param data Part of the email
+ * @param size Size of the part
+ */
+void FetchedEmails::writeLiteral(const char *data, std::size_t size) {
+  if (!this->isReceiving) {
+    return;
+  }
+
+  std::size_t count = std::min(size, this->bodySize - this->bodyLength);
+  memcpy(this->body + this->bodyLength, data, count);
+  this->bodyLength += count;
+}
+
+/**
+ * @brief Finish the view of the received email
+ */
+void FetchedEmails::endLiteral() {
+  if (!this->isReceiving) {
+    return;
+  }
+
+  this->emails.back().body = std::string_view{this->body, this->bodyLength};
+  this->isReceiving = false;
+}
+
+/**
+ * @brief Get the received emails
+ *
+ * @return const std::vector<Email>& Views of emails in the order of the responses
+ */
+const std::vector<FetchedEmails::Email> &FetchedEmails::getEmails() const {
+  return this->emails;
+}
+
+/**
+ * @brief Get an iterator to the first received email
+ *
+ * @return std::vector<Email>::const_iterator Iterator to the first email
+ */
+std::vector<FetchedEmails::Email>::const_iterator FetchedEmails::begin() const {
+  return this->emails.cbegin();
+}
+
+/**
+ * @brief Get an iterator past the last received email
+ *
+ * @return std::vector<Email>::const_iterator Iterator past the last email
+ */
+std::vector<FetchedEmails::Email>::const_iterator FetchedEmails::end() const {
+  return this->emails.cend();
+}
+
+/**
+ * @brief Get the number of received emails
+ *
+ * @return std::size_t Number of emails
+ */
+std::size_t FetchedEmails::size() const {
+  return this->emails.size();
+}
+
+/**
+ * @brief Free the memory of all emails, which invalidates their views
+ */
+void FetchedEmails::release() {
+  this->emails.clear();
+  this->blocks.clear();
+  this->freeSpace = nullptr;
+  this->freeSize = 0;
+  this->isReceiving = false;
+  this->body = nullptr;
+  this->bodyLength = 0;
+  this->bodySize = 0;
+}
+
+/**
+ * @brief Get space for data from the last block, or from a new block if it does not fit
+ *
+ * Data larger than a block gets its own block, so the free space of the last block is kept for smaller emails.
+ *
+ * @param size Size of the data in bytes
+ * @return char* Start of the space
+ */
+char *FetchedEmails::allocate(std::size_t size) {
+  if (size > FetchedEmails::BLOCK_SIZE) {
+    this->blocks.push_back(std::make_unique_for_overwrite<char[]>(size));
+    return this->blocks.back().get();
+  }
+
+  if (size > this->freeSize) {
+    this->blocks.push_back(std::make_unique_for_overwrite<char[]>(FetchedEmails::BLOCK_SIZE));
+    this->freeSpace = this->blocks.back().get();
+    this->freeSize = FetchedEmails::BLOCK_SIZE;
+  }
+
+  char *space = this->freeSpace;
+  this->freeSpace += size;
+  this->freeSize -= size;
+
+  return space;
+}
+
+/**
+ * @brief Get the UID of an email from the line of a FETCH response which announces it
+ *
+ * Works like EmailWriter::getEmailUID without copying the line.
+ *
+ * @param line Line in format "* 1 FETCH (UID 42 BODY[] {1024}"
+ * @return unsigned long UID of the email, or its sequence number if the line does not contain it
+ */
+unsigned long FetchedEmails::parseUID(std::string_view line) {
+  std::size_t uidStart = FetchedEmails::find(line, "(uid ");
+  if (uidStart == std::string_view::npos) {
+    uidStart = FetchedEmails::find(line, " uid ");
+  }
+
+  // Use the sequence number
+  uidStart = uidStart == std::string_view::npos ? 2 : uidStart + 5;
+
+  unsigned long uid = 0;
+  for (std::size_t i = uidStart; i < line.length() && std::isdigit(static_cast<unsigned char>(line[i])); i++) {
+    uid = uid * 10 + (line[i] - '0');
+  }
+
+  return uid;
+}
+
+/**
+ * @brief Get the flags from the line of a FETCH response which announces an email
+ *
+ * @param line Line in format "* 1 FETCH (UID 42 FLAGS (\Seen \Flagged) BODY[] {1024}"
+ * @return std::string_view Flags separated by spaces, e.g. "\Seen \Flagged", which point into line
+ */
+std::string_view FetchedEmails::parseFlags(std::string_view line) {
+  std::size_t flagsStart = FetchedEmails::find(line, "flags (");
+  if (flagsStart == std::string_view::npos) {
+    return {};
+  }
+
+  flagsStart += 7;
+  return line.substr(flagsStart, line.find(')', flagsStart) - flagsStart);
+}
+
+/**
+ * @brief Find text in a line regardless of the case of letters
+ *
+ * @param line Line to search
+ * @param text Text in lower case
+ * @return std::size_t Position of the text, std::string_view::npos if the line does not contain it
+ */
+std::size_t FetchedEmails::find(std::string_view line, std::string_view text) {
+  auto position = std::search(line.begin(), line.end(), text.begin(), text.end(),
+                              [](char a, char b) { return std::tolower(static_cast<unsigned char>(a)) == b; });
+  return position == line.end() ? std::string_view::npos : position - line.begin();
+}
@@ -0,0 +1,88 @@
+/**
+ * IMAP client
+ *
+ * @file fetched_emails.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef FETCHED_EMAILS_H
+#define FETCHED_EMAILS_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "email_writer.h"
+#include "literal_sink.h"
+
+/**
+ * @brief Emails from FETCH responses, which are kept in memory blocks owned by this object
+ *
+ * Literals are copied from the receive buffer of the connection straight into a block, where every email gets space
+ * for its flags and contents as soon as the server announces its size. Emails are returned as views into the blocks,
+ * so no email is copied or allocated on its own. The views stay valid while the object exists, also after it is
+ * moved, until release is called.
+ */
+class FetchedEmails : public LiteralSink {
+ public:
+  /// @brief Minimum size of a memory block, larger emails get a block of their size
+  static constexpr std::size_t BLOCK_SIZE = 1024 * 1024;
+
+  /// @brief View of a fetched email
+  struct Email {
+    /// @brief UID of the email, or its sequence number if the server did not send the UID
+    unsigned long uid;
+    /// @brief Flags separated by spaces, e.g. "\Seen \Flagged", empty if the server did not send them before the body
+    std::string_view flags;
+    /// @brief Contents of the email, or only its header
+    std::string_view body;
+  };
+
+ protected:
+  /// @brief Memory blocks, which are never reallocated
+  std::vector<std::unique_ptr<char[]>> blocks;
+  /// @brief Free space at the end of the last block
+  char *freeSpace{nullptr};
+  /// @brief Size of the free space in bytes
+  std::size_t freeSize{0};
+
+  /// @brief Received emails in the order of the responses
+  std::vector<Email> emails;
+  /// @brief Represents if the current literal is an email
+  bool isReceiving{false};
+  /// @brief Start of the space of the email that is currently being received
+  char *body{nullptr};
+  /// @brief Number of received bytes of the current email
+  std::size_t bodyLength{0};
+  /// @brief Size of the space of the current email
+  std::size_t bodySize{0};
+
+ public:
+  FetchedEmails() = default;
+  FetchedEmails(FetchedEmails &&other);
+  FetchedEmails &operator=(FetchedEmails &&other);
+  ~FetchedEmails() override = default;
+
+  void beginLiteral(std::string_view line, std::size_t size) override;
+  void writeLiteral(const char *data, std::size_t size) override;
+  void endLiteral() override;
+
+  const std::vector<Email> &getEmails() const;
+  std::vector<Email>::const_iterator begin() const;
+  std::vector<Email>::const_iterator end() const;
+  std::size_t size() const;
+  void release();
+
+ protected:
+  char *allocate(std::size_t size);
+  static unsigned long parseUID(std::string_view line);
+  static std::string_view parseFlags(std::string_view line);
+  static std::size_t find(std::string_view line, std::string_view text);
+};
+
+#endif
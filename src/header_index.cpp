@@ -0,0 +1,268 @@
+/**
+ * IMAP client
+ *
+ * @file header_index.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include "header_index.h"
+
+/**
+ * @brief Construct a new HeaderIndex object and load the index file
+ *
+ * @param filePath Path of the index file
+ */
+HeaderIndex::HeaderIndex(std::filesystem::path filePath) : filePath{filePath} {
+  try {
+    MappedHeaderIndex index{this->filePath.string()};
+    for (std::size_t row = 0; row < index.getCount(); row++) {
+      Entry entry{std::string{index.getText(MappedHeaderIndex::Field::MESSAGE_ID, row)},
+                  std::string{index.getText(MappedHeaderIndex::Field::FROM, row)},
+                  std::string{index.getText(MappedHeaderIndex::Field::TO, row)},
+                  std::string{index.getText(MappedHeaderIndex::Field::SUBJECT, row)},
+                  index.getDate(row),
+                  index.getSize(row),
+                  index.getFlags(row)};
+      this->entries.emplace(std::make_tuple(std::string{index.getText(MappedHeaderIndex::Field::HOSTNAME, row)},
+                                            std::string{index.getText(MappedHeaderIndex::Field::MAILBOX, row)},
+                                            index.getUid(row)),
+                            std::move(entry));
+    }
+  } catch (const std::exception &) {
+    // The index only mirrors saved emails, so an unreadable one is rebuilt by the next synchronizations
+    this->entries.clear();
+    this->isChanged = true;
+  }
+}
+
+/**
+ * @brief Get the index of an output directory, which is loaded if no session uses it yet
+ *
+ * @param directoryPath Path where emails are saved
+ * @return std::shared_ptr<HeaderIndex> Index shared by all sessions that save emails to the directory
+ */
+std::shared_ptr<HeaderIndex> HeaderIndex::open(std::string directoryPath) {
+  std::string key = std::filesystem::absolute(directoryPath).lexically_normal().string();
+
+  std::lock_guard<std::mutex> lock{HeaderIndex::indexesMutex};
+
+  std::shared_ptr<HeaderIndex> index = HeaderIndex::indexes[key].lock();
+  if (!index) {
+    index = std::make_shared<HeaderIndex>(HeaderIndex::getFilePath(key));
+    HeaderIndex::indexes[key] = index;
+  }
+
+  return index;
+}
+
+/**
+ * @brief Get the path of the index file in an output directory
+ *
+ * @param directoryPath Path where emails are saved
+ * @return std::string Path of the index file
+ */
+std::string HeaderIndex::getFilePath(std::string directoryPath) {
+  return (std::filesystem::path{directoryPath} / HeaderIndex::FILE_NAME).string();
+}
+
+/**
+ * @brief Add a saved email to the index or replace its previous entry
+ *
+ * @param hostname Imap server hostname
+ * @param mailbox Mailbox of the email
+ * @param uid UID of the email
+ * @param entry Parsed header of the email
+ */
+void HeaderIndex::add(std::string hostname, std::string mailbox, std::uint64_t uid, Entry entry) {
+  std::lock_guard<std::mutex> lock{this->mutex};
+  this->entries.insert_or_assign(std::make_tuple(std::move(hostname), std::move(mailbox), uid), std::move(entry));
+  this->isChanged = true;
+}
+
+/**
+ * @brief Update flags of emails from a mailbox after a synchronization and remove emails that are not stored anymore
+ *
+ * @param hostname Imap server hostname
+ * @param mailbox Synchronized mailbox
+ * @param flags Flags of all stored emails of the mailbox, where the key is the UID of an email
+ */
+void HeaderIndex::update(std::string hostname, std::string mailbox, const std::map<unsigned long, std::string> &flags) {
+  std::lock_guard<std::mutex> lock{this->mutex};
+
+  auto entry = this->entries.lower_bound(std::make_tuple(hostname, mailbox, std::uint64_t{0}));
+  while (entry != this->entries.end() && std::get<0>(entry->first) == hostname &&
+         std::get<1>(entry->first) == mailbox) {
+    auto emailFlags = flags.find(std::get<2>(entry->first));
+    if (emailFlags == flags.end()) {
+      entry = this->entries.erase(entry);
+      this->isChanged = true;
+      continue;
+    }
+
+    std::uint32_t bits = MappedHeaderIndex::parseFlags(emailFlags->second);
+    if (entry->second.flags != bits) {
+      entry->second.flags = bits;
+      this->isChanged = true;
+    }
+    entry++;
+  }
+}
+
+/**
+ * @brief Write the index to its file if it changed
+ *
+ * The file is written under a temporary name and renamed, so readers always map a complete index.
+ */
+void HeaderIndex::save() {
+  std::lock_guard<std::mutex> lock{this->mutex};
+  if (!this->isChanged) {
+    return;
+  }
+
+  std::size_t count = this->entries.size();
+  MappedHeaderIndex::Layout layout = MappedHeaderIndex::getLayout(count);
+  std::string contents(layout.strings, '\0');
+  std::string strings;
+
+  // Equal strings, like hostnames, mailboxes and frequent senders, are stored once
+  std::unordered_map<std::string, MappedHeaderIndex::StringRef> references;
+  auto addString = [&strings, &references](const std::string &value) {
+    auto [reference, isAdded] = references.try_emplace(
+        value, MappedHeaderIndex::StringRef{static_cast<std::uint32_t>(strings.length()),
+                                            static_cast<std::uint32_t>(value.length())});
+    if (isAdded) {
+      strings += value;
+    }
+    return reference->second;
+  };
+
+  std::size_t row = 0;
+  for (const auto &[key, entry] : this->entries) {
+    const auto &[hostname, mailbox, uid] = key;
+    MappedHeaderIndex::StringRef texts[] = {addString(hostname),     addString(mailbox), addString(entry.messageId),
+                                            addString(entry.from),   addString(entry.to), addString(entry.subject)};
+    std::size_t textColumns[] = {layout.hostnames, layout.mailboxes,  layout.messageIds,
+                                 layout.senders,   layout.recipients, layout.subjects};
+
+    std::memcpy(contents.data() + layout.uids + row * sizeof(std::uint64_t), &uid, sizeof(std::uint64_t));
+    std::memcpy(contents.data() + layout.sizes + row * sizeof(std::uint64_t), &entry.size, sizeof(std::uint64_t));
+    std::memcpy(contents.data() + layout.dates + row * sizeof(std::int64_t), &entry.date, sizeof(std::int64_t));
+    std::memcpy(contents.data() + layout.flags + row * sizeof(std::uint32_t), &entry.flags, sizeof(std::uint32_t));
+    for (std::size_t column = 0; column < 6; column++) {
+      std::memcpy(contents.data() + textColumns[column] + row * sizeof(MappedHeaderIndex::StringRef), &texts[column],
+                  sizeof(MappedHeaderIndex::StringRef));
+    }
+
+    if (strings.length() > UINT32_MAX) {
+      throw std::runtime_error("Header index is too large.");
+    }
+    row++;
+  }
+
+  MappedHeaderIndex::FileHeader header{};
+  std::memcpy(header.magic, MappedHeaderIndex::MAGIC, sizeof(header.magic));
+  header.count = count;
+  header.stringsSize = strings.length();
+  std::memcpy(contents.data(), &header, sizeof(header));
+
+  std::string temporaryPath = this->filePath.string() + ".tmp";
+  std::ofstream file{temporaryPath, std::ios::binary | std::ios::trunc};
+  file.write(contents.data(), contents.length());
+  file.write(strings.data(), strings.length());
+  file.close();
+  if (!file || std::rename(temporaryPath.c_str(), this->filePath.c_str()) != 0) {
+    throw std::runtime_error("Could not save header index " + this->filePath.string() + ".");
+  }
+
+  this->isChanged = false;
+}
+
+/**
+ * @brief Parse the header of an email into an entry of the index
+ *
+ * @param header Header of the email, the body may follow it
+ * @param size Size of the saved email in bytes
+ * @param flags Flags of the email separated by spaces
+ * @return Entry Entry of the email
+ */
+HeaderIndex::Entry HeaderIndex::parseHeader(std::string_view header, std::uint64_t size, std::string_view flags) {
+  return {EmailWriter::getHeaderField(header, "message-id"),
+          EmailWriter::getHeaderField(header, "from"),
+          EmailWriter::getHeaderField(header, "to"),
+          EmailWriter::getHeaderField(header, "subject"),
+          HeaderIndex::parseDate(EmailWriter::getHeaderField(header, "date")),
+          size,
+          MappedHeaderIndex::parseFlags(flags)};
+}
+
+/**
+ * @brief Parse the header of a saved email into an entry of the index
+ *
+ * @param filePath Path of the email
+ * @param flags Flags of the email separated by spaces
+ * @return Entry Entry of the email
+ */
+HeaderIndex::Entry HeaderIndex::parseFile(std::string filePath, std::string_view flags) {
+  std::ifstream file{filePath, std::ios::binary};
+  std::string header(HeaderIndex::MAX_HEADER_SIZE, '\0');
+  file.read(header.data(), header.length());
+  header.resize(file.gcount());
+
+  std::error_code error;
+  std::uintmax_t size = std::filesystem::file_size(filePath, error);
+  return HeaderIndex::parseHeader(header, error ? header.length() : size, flags);
+}
+
+/**
+ * @brief Parse the Date field of an email
+ *
+ * @param date Value of the field, e.g. "Mon, 1 Jan 2024 10:00:00 +0100"
+ * @return std::int64_t Unix time, 0 if the date is invalid
+ */
+std::int64_t HeaderIndex::parseDate(std::string date) {
+  // The day of the week is optional
+  std::size_t dayOfWeekEnd = date.find(',');
+  if (dayOfWeekEnd != std::string::npos) {
+    date = date.substr(dayOfWeekEnd + 1);
+  }
+
+  // Seconds are optional
+  std::tm time{};
+  char month[4]{};
+  char zone[6]{};
+  if (sscanf(date.c_str(), " %d %3s %d %d:%d:%d %5s", &time.tm_mday, month, &time.tm_year, &time.tm_hour,
+             &time.tm_min, &time.tm_sec, zone) < 6) {
+    time.tm_sec = 0;
+    if (sscanf(date.c_str(), " %d %3s %d %d:%d %5s", &time.tm_mday, month, &time.tm_year, &time.tm_hour,
+               &time.tm_min, zone) < 5) {
+      return 0;
+    }
+  }
+
+  std::string monthName{month};
+  std::transform(monthName.begin(), monthName.end(), monthName.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  const std::string months = "janfebmaraprmayjunjulaugsepoctnovdec";
+  std::size_t monthIndex = months.find(monthName);
+  if (monthName.length() != 3 || monthIndex == std::string::npos || monthIndex % 3 != 0) {
+    return 0;
+  }
+  time.tm_mon = monthIndex / 3;
+
+  // Two digit years are obsolete, but still allowed
+  if (time.tm_year < 50) {
+    time.tm_year += 2000;
+  } else if (time.tm_year < 1000) {
+    time.tm_year += 1900;
+  }
+  time.tm_year -= 1900;
+
+  // Other zones than numeric ones are treated as UTC
+  std::int64_t offset = 0;
+  if ((zone[0] == '+' || zone[0] == '-') && std::strlen(zone) == 5) {
+    int zoneValue = std::atoi(zone + 1);
+    offset = (zoneValue / 100 * 60 + zoneValue % 100) * 60 * (zone[0] == '-' ? -1 : 1);
+  }
+
+  return static_cast<std::int64_t>(timegm(&time)) - offset;
+}
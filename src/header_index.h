@@ -0,0 +1,98 @@
+/**
+ * IMAP client
+ *
+ * @file header_index.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef HEADER_INDEX_H
+#define HEADER_INDEX_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "email_writer.h"
+#include "mapped_header_index.h"
+
+/**
+ * @brief Index of parsed headers of saved emails, which is stored in the output directory for searching offline
+ *
+ * The index is loaded from its file, updated with emails downloaded by a synchronization and written back in the
+ * columnar format read by MappedHeaderIndex. Indexes are shared by all sessions that save emails to the same
+ * directory.
+ */
+class HeaderIndex {
+ public:
+  static inline const std::string FILE_NAME = ".header_index";
+  static const std::size_t MAX_HEADER_SIZE = 64 * 1024;
+
+  /**
+   * @brief Parsed header of an email
+   */
+  struct Entry {
+    /// @brief Message-ID field
+    std::string messageId;
+    /// @brief From field
+    std::string from;
+    /// @brief To field
+    std::string to;
+    /// @brief Subject field
+    std::string subject;
+    /// @brief Date field as unix time, 0 if it is missing or invalid
+    std::int64_t date{0};
+    /// @brief Size of the saved email in bytes
+    std::uint64_t size{0};
+    /// @brief Flags as bits of MappedHeaderIndex::Flag
+    std::uint32_t flags{0};
+  };
+
+ protected:
+  /// @brief Guards the open indexes
+  static inline std::mutex indexesMutex;
+  /// @brief Open indexes by the absolute path of the output directory
+  static inline std::map<std::string, std::weak_ptr<HeaderIndex>> indexes;
+
+  /// @brief Path of the index file
+  std::filesystem::path filePath;
+  /// @brief Guards the entries, sessions on different threads save emails at the same time
+  std::mutex mutex;
+  /// @brief Emails by their hostname, mailbox and UID
+  std::map<std::tuple<std::string, std::string, std::uint64_t>, Entry> entries;
+  /// @brief Represents if the entries changed since they were loaded or saved
+  bool isChanged{false};
+
+ public:
+  explicit HeaderIndex(std::filesystem::path filePath);
+
+  HeaderIndex(const HeaderIndex &) = delete;
+  HeaderIndex &operator=(const HeaderIndex &) = delete;
+
+  static std::shared_ptr<HeaderIndex> open(std::string directoryPath);
+  static std::string getFilePath(std::string directoryPath);
+
+  void add(std::string hostname, std::string mailbox, std::uint64_t uid, Entry entry);
+  void update(std::string hostname, std::string mailbox, const std::map<unsigned long, std::string> &flags);
+  void save();
+
+  static Entry parseHeader(std::string_view header, std::uint64_t size, std::string_view flags);
+  static Entry parseFile(std::string filePath, std::string_view flags);
+  static std::int64_t parseDate(std::string date);
+};
+
+#endif
@@ -20,6 +20,7 @@ IMAPClient::IMAPClient(std::string hostname,
                        std::string certificateFile,
                        std::string certificatesFolderPath)
     : hostname{hostname},
+      port{port},
       certificateFile{certificateFile},
       certificatesFolderPath{certificatesFolderPath},
       usingSecure{true} {
@@ -36,7 +37,7 @@ IMAPClient::IMAPClient(std::string hostname,
  * @param hostname Server hostname
  * @param port Server port
  */
-IMAPClient::IMAPClient(std::string hostname, uint16_t port) : hostname{hostname}, usingSecure{false} {
+IMAPClient::IMAPClient(std::string hostname, uint16_t port) : hostname{hostname}, port{port}, usingSecure{false} {
   // Create a connection to server
   connection = std::make_unique<TCPConnection>(hostname, port);
 
@@ -44,15 +45,107 @@ IMAPClient::IMAPClient(std::string hostname, uint16_t port) : hostname{hostname}
   this->connection->receive();
 }
 
+/**
+ * @brief Construct a new imap client which uses an already created connection
+ *
+ * The server greeting is not received, so the caller must receive it.
+ *
+ * @param connection Connection to the server
+ * @param hostname Server hostname
+ * @param port Server port
+ * @param usingSecure Indicates whether the connection uses TLS
+ */
+IMAPClient::IMAPClient(std::unique_ptr<Connection> connection, std::string hostname, uint16_t port, bool usingSecure)
+    : connection{std::move(connection)}, hostname{hostname}, port{port}, usingSecure{usingSecure} {}
+
+/**
+ * @brief Connect to a server using a tcp connection and record the session to a trace file
+ *
+ * @param tracePath Path to the trace file, which can be replayed by IMAPClient::replay
+ * @param hostname Server hostname
+ * @param port Server port
+ * @return std::unique_ptr<IMAPClient> Connected imap client
+ */
+std::unique_ptr<IMAPClient> IMAPClient::record(std::string tracePath, std::string hostname, uint16_t port) {
+  auto connection = std::make_unique<RecordingConnection>(std::make_unique<TCPConnection>(hostname, port), tracePath);
+  return IMAPClient::greet(std::move(connection), hostname, port, false);
+}
+
+/**
+ * @brief Connect to a server using a ssl connection and record the decrypted session to a trace file
+ *
+ * @param tracePath Path to the trace file, which can be replayed by IMAPClient::replay
+ * @param hostname Server hostname
+ * @param port Server port
+ * @param certificateFile Path to a certificate file used for validating ssl/tls certificate
+ * @param certificatesFolderPath Path to a folder which is used for validating ssl/tls certificates
+ * @return std::unique_ptr<IMAPClient> Connected imap client
+ */
+std::unique_ptr<IMAPClient> IMAPClient::record(std::string tracePath,
+                                               std::string hostname,
+                                               uint16_t port,
+                                               std::string certificateFile,
+                                               std::string certificatesFolderPath) {
+  auto connection = std::make_unique<RecordingConnection>(
+      std::make_unique<SSLConnection>(hostname, port, certificateFile, certificatesFolderPath), tracePath);
+  std::unique_ptr<IMAPClient> client = IMAPClient::greet(std::move(connection), hostname, port, true);
+  client->certificateFile = certificateFile;
+  client->certificatesFolderPath = certificatesFolderPath;
+
+  return client;
+}
+
+/**
+ * @brief Create a client which replays a recorded session instead of connecting to the server
+ *
+ * The client must send the same commands as the recorded one, e.g. it must download to an output directory in the
+ * same state. Other sessions opened by the client and STARTTLS connect to the server.
+ *
+ * @param tracePath Path to a trace file written by IMAPClient::record
+ * @param hostname Hostname of the recorded server
+ * @param port Port of the recorded server
+ * @param usingDelays Represents if responses are delayed like during the recording
+ * @return std::unique_ptr<IMAPClient> Imap client which received the recorded greeting
+ */
+std::unique_ptr<IMAPClient> IMAPClient::replay(std::string tracePath,
+                                               std::string hostname,
+                                               uint16_t port,
+                                               bool usingDelays) {
+  return IMAPClient::greet(std::make_unique<ReplayConnection>(tracePath, usingDelays), hostname, port, false);
+}
+
+/**
+ * @brief Create a client for a connection and receive the server greeting
+ *
+ * @param connection Connection to the server
+ * @param hostname Server hostname
+ * @param port Server port
+ * @param usingSecure Indicates whether the connection uses TLS
+ * @return std::unique_ptr<IMAPClient> Connected imap client
+ */
+std::unique_ptr<IMAPClient> IMAPClient::greet(std::unique_ptr<Connection> connection,
+                                              std::string hostname,
+                                              uint16_t port,
+                                              bool usingSecure) {
+  // Receive server greeting
+  connection->receive();
+
+  return std::unique_ptr<IMAPClient>(new IMAPClient(std::move(connection), hostname, port, usingSecure));
+}
+
 /**
  * @brief Destroy the imap client
  */
 IMAPClient::~IMAPClient() {
-  // Close connection to server
-  this->logout();
+  // Close connection to server, the client may be destroyed because the connection failed, so errors are ignored
+  try {
+    this->logout();
+  } catch (const std::exception &) {
+  }
 
-  if (!this->usingSecure) {
-    reinterpret_cast<TCPConnection *>(this->connection.get())->closeConnection();
+  TCPConnection *tcpConnection = dynamic_cast<TCPConnection *>(this->connection.get());
+  if (!this->usingSecure && tcpConnection != nullptr) {
+    tcpConnection->closeConnection();
   }
 }
 
@@ -72,8 +165,15 @@ void IMAPClient::login(std::string username, std::string password) {
     throw std::runtime_error("Invalid auth credentials.");
   }
 
+  // Capabilities can change after authentication
+  this->capabilities.clear();
+
   this->isLoggedIn = true;
+  this->username = username;
+  this->password = password;
   this->tag++;
+
+  this->startCompression();
 }
 
 /**
@@ -115,27 +215,259 @@ bool IMAPClient::startTls() {
 
   // Delete old TCP connection without closing connection to server and make connection secure
   int fd = this->connection->getFd();
-  this->connection = std::make_unique<SSLConnection>(fd, certificateFile, certificatesFolderPath);
+  this->connection = std::make_unique<SSLConnection>(fd, this->hostname, this->port, this->certificateFile,
+                                                     this->certificatesFolderPath);
   this->usingSecure = true;
+  this->usingStartTls = true;
 
   this->tag++;
   return true;
 }
 
+/**
+ * @brief Get UIDVALIDITY of the selected mailbox
+ *
+ * @return unsigned long UIDVALIDITY, 0 if the server did not send it
+ */
+unsigned long IMAPClient::getUidValidity() {
+  return this->uidValidity;
+}
+
+/**
+ * @brief Check if the server supports a capability by sending the CAPABILITY command to the server
+ *
+ * Capabilities are requested only once per session and again after authentication.
+ *
+ * @param capability Name of the capability
+ * @return true If the server supports the capability
+ * @return false If the server does not support the capability
+ */
+bool IMAPClient::hasCapability(std::string capability) {
+  if (this->capabilities.empty()) {
+    // Send CAPABILITY command to server
+    std::string command = std::to_string(this->tag) + " capability\r\n";
+    std::string response = this->toLowerCase(this->connection->sendCommand(this->tag, command));
+
+    // Verify that getting capabilities was successful
+    if (response.find(std::to_string(this->tag) + " ok") == std::string::npos) {
+      throw std::runtime_error("Could not get capabilities.");
+    }
+
+    this->parseCapabilities(response);
+    this->tag++;
+  }
+
+  return this->capabilities.contains(this->toLowerCase(capability));
+}
+
+/**
+ * @brief Start compressing the connection by sending the COMPRESS command to the server
+ *
+ * @return true If the connection is compressed
+ * @return false If compression is not allowed or the server does not support it
+ */
+bool IMAPClient::startCompression() {
+  if (this->isCompressed) {
+    return true;
+  }
+
+  if (!this->isCompressionAllowed || !this->isLoggedIn || !this->hasCapability("compress=deflate")) {
+    return false;
+  }
+
+  // Send COMPRESS command to server
+  std::string command = std::to_string(this->tag) + " compress deflate\r\n";
+  std::string response = this->connection->sendCommand(this->tag, command);
+
+  // Data after the tagged response is compressed, if the command was successful
+  this->isCompressed = this->toLowerCase(response).find(std::to_string(this->tag) + " ok") != std::string::npos;
+  if (this->isCompressed) {
+    this->connection->startCompression();
+  }
+
+  this->tag++;
+  return this->isCompressed;
+}
+
+/**
+ * @brief Set whether the connection is compressed after login when the server supports it
+ *
+ * @param isCompressionAllowed Use the COMPRESS=DEFLATE extension, sessions opened later use it too
+ */
+void IMAPClient::setCompression(bool isCompressionAllowed) {
+  this->isCompressionAllowed = isCompressionAllowed;
+}
+
+/**
+ * @brief Enable the QRESYNC extension by sending the ENABLE command to the server
+ *
+ * @return true If QRESYNC is enabled
+ * @return false If the server does not support QRESYNC
+ */
+bool IMAPClient::enableQresync() {
+  if (this->isQresyncEnabled) {
+    return true;
+  }
+
+  if (!this->isLoggedIn || !this->hasCapability("qresync")) {
+    return false;
+  }
+
+  // Send ENABLE command to server
+  std::string command = std::to_string(this->tag) + " enable qresync\r\n";
+  std::string response = this->connection->sendCommand(this->tag, command);
+
+  // Verify that enabling QRESYNC was successful
+  this->isQresyncEnabled = this->toLowerCase(response).find(std::to_string(this->tag) + " ok") != std::string::npos;
+
+  this->tag++;
+  return this->isQresyncEnabled;
+}
+
+/**
+ * @brief Open another session to the same server with the same security and credentials
+ *
+ * @return std::unique_ptr<IMAPClient> New imap client, which is logged in if this client is logged in
+ */
+std::unique_ptr<IMAPClient> IMAPClient::openSession() {
+  std::unique_ptr<IMAPClient> session;
+  if (this->usingSecure && !this->usingStartTls) {
+    session = std::make_unique<IMAPClient>(this->hostname, this->port, this->certificateFile,
+                                           this->certificatesFolderPath);
+  } else {
+    session = std::make_unique<IMAPClient>(this->hostname, this->port);
+  }
+  session->setReadSize(this->readSize);
+  session->setCompression(this->isCompressionAllowed);
+  session->setOutputFormat(this->outputFormat);
+  session->setAsyncWrites(this->isWritingAsync);
+  session->setIndexing(this->isIndexing);
+  session->setPartialSize(this->partialSize);
+
+  if (this->usingStartTls) {
+    session->certificateFile = this->certificateFile;
+    session->certificatesFolderPath = this->certificatesFolderPath;
+    session->startTls();
+  }
+
+  if (this->isLoggedIn) {
+    session->login(this->username, this->password);
+  }
+
+  return session;
+}
+
+/**
+ * @brief Set the minimum number of bytes requested from the socket by a single read, sessions opened later use it too
+ *
+ * @param readSize Read size in bytes
+ */
+void IMAPClient::setReadSize(std::size_t readSize) {
+  this->readSize = readSize;
+  this->connection->setReadSize(readSize);
+}
+
+/**
+ * @brief Set the format in which emails are stored in the output directory
+ *
+ * @param outputFormat Format of the output directory, sessions opened later use it too
+ */
+void IMAPClient::setOutputFormat(EmailWriter::Format outputFormat) {
+  this->outputFormat = outputFormat;
+}
+
+/**
+ * @brief Set whether received emails are written in the background while next emails are received
+ *
+ * @param isWritingAsync Write emails using a disk writer, sessions opened later use it too
+ */
+void IMAPClient::setAsyncWrites(bool isWritingAsync) {
+  this->isWritingAsync = isWritingAsync;
+}
+
+/**
+ * @brief Set whether headers of saved emails are added to the header index of the output directory
+ *
+ * @param isIndexing Update the header index, sessions opened later use it too
+ */
+void IMAPClient::setIndexing(bool isIndexing) {
+  this->isIndexing = isIndexing;
+}
+
+/**
+ * @brief Set the size above which emails are fetched in resumable ranges
+ *
+ * @param partialSize Size of a range in bytes, 0 fetches every email at once, sessions opened later use it too
+ */
+void IMAPClient::setPartialSize(std::size_t partialSize) {
+  this->partialSize = partialSize;
+}
+
+/**
+ * @brief Get names of all mailboxes by sending the LIST command to the server
+ *
+ * @return std::vector<std::string> Names of mailboxes that can be selected
+ */
+std::vector<std::string> IMAPClient::list() {
+  // User must be logged in before listing mailboxes
+  if (!this->isLoggedIn) {
+    throw std::runtime_error("User must be logged in before listing mailboxes.");
+  }
+
+  // Send LIST command to server
+  std::string command = std::to_string(this->tag) + " list \"\" *\r\n";
+  std::string response = this->connection->sendCommand(this->tag, command);
+
+  // Verify that listing mailboxes was successful
+  if (this->toLowerCase(response).find(std::to_string(this->tag) + " ok") == std::string::npos) {
+    throw std::runtime_error("Could not list mailboxes.");
+  }
+
+  this->tag++;
+  return this->parseMailboxes(response);
+}
+
 /**
  * @brief Select a mailbox by sending the SELECT command to the server
  *
+ * If the state of the last synchronization is set and the server supports QRESYNC, the server also reports emails
+ * that were removed, added or changed since then.
+ *
  * @param mailbox Name of mailbox to select
+ * @param state State of the last synchronization of the mailbox, if set
  */
-void IMAPClient::select(std::string mailbox) {
+void IMAPClient::select(std::string mailbox, const SyncState *state) {
+  // Send QRESYNC parameters with the known UIDVALIDITY and HIGHESTMODSEQ
+  std::string parameters;
+  bool isResyncRequested = false;
+  if (state != nullptr && this->enableQresync()) {
+    isResyncRequested = state->uidValidity != 0 && state->highestModSeq != 0;
+    parameters = isResyncRequested ? " (qresync (" + std::to_string(state->uidValidity) + " " +
+                                         std::to_string(state->highestModSeq) + "))"
+                                   : " (condstore)";
+  }
+
   // Send SELECT command to server
-  std::string command = std::to_string(this->tag) + " select " + mailbox + "\r\n";
+  std::string command = std::to_string(this->tag) + " select " + this->quote(mailbox) + parameters + "\r\n";
   std::string response = this->connection->sendCommand(this->tag, command);
 
   // Verify that selecting mailbox was successful
   if (this->toLowerCase(response).find(std::to_string(this->tag) + " ok") == std::string::npos) {
     throw std::runtime_error("Could not select mailbox.");
   }
+
+  this->parseSelectResponse(mailbox, response, isResyncRequested ? state : nullptr);
+  this->tag++;
+}
+
+/**
+ * @brief Parse a SELECT response into the state of the selected mailbox
+ *
+ * @param mailbox Name of the selected mailbox
+ * @param response SELECT response sent from the server
+ * @param resyncState State of the last synchronization if QRESYNC parameters were sent, otherwise nullptr
+ */
+void IMAPClient::parseSelectResponse(std::string mailbox, std::string response, const SyncState *resyncState) {
   this->mailbox = mailbox;
 
   // Check if mailbox is empty
@@ -144,20 +476,32 @@ void IMAPClient::select(std::string mailbox) {
   if (emailCountStart == std::string::npos || emailCountEnd == std::string::npos) {
     throw std::runtime_error("Invalid select response format.");
   }
-  int emailCount = std::stoi(response.substr(emailCountStart + 1, emailCountEnd - emailCountStart - 1));
-  this->isMailboxEmpty = emailCount == 0;
+  this->emailCount = std::stoul(response.substr(emailCountStart + 1, emailCountEnd - emailCountStart - 1));
+  this->isMailboxEmpty = this->emailCount == 0;
 
-  this->tag++;
+  // Parse UIDVALIDITY and UIDNEXT of the mailbox
+  this->uidValidity = this->parseResponseCode(response, "uidvalidity");
+  this->uidNext = this->parseResponseCode(response, "uidnext");
+  this->highestModSeq = this->parseResponseCode(response, "highestmodseq");
+
+  // Parse changes since the last synchronization
+  this->isResynchronized = resyncState != nullptr && resyncState->uidValidity == this->uidValidity;
+  this->vanishedUIDs.clear();
+  this->changedEmails.clear();
+  if (this->isResynchronized) {
+    this->parseResyncResponse(response, *resyncState);
+  }
 }
 
 /**
  * @brief Get all emails in selected mailbox by sending the FETCH command to the server
  *
  * @param options Specify which email contents to fetch
+ * @param batch Specify how to split emails into multiple FETCH commands
  * @return std::unordered_map<std::string, std::string> Pairs, where the key is the UID of an email and the value is the
  * contents of the email
  */
-std::unordered_map<std::string, std::string> IMAPClient::fetch(FetchOptions options) {
+std::unordered_map<std::string, std::string> IMAPClient::fetch(FetchOptions options, BatchOptions batch) {
   // User must be logged in before fetching emails
   if (!this->isLoggedIn) {
     throw std::runtime_error("User must be logged in before fetching emails.");
@@ -168,30 +512,28 @@ std::unordered_map<std::string, std::string> IMAPClient::fetch(FetchOptions opti
     return {};
   }
 
-  // Send FETCH command to server
-  std::string command =
-      std::to_string(this->tag) + " fetch 1:* body.peek[" + (options == FetchOptions::ALL ? "" : "header") + "]\r\n";
-  std::string response = this->connection->sendCommand(this->tag, command);
+  // Search for new emails in the same round trip as the FETCH commands
+  unsigned int searchTag = this->submitSearchNew();
+  std::vector<std::string> responses = this->sendFetch(this->getBatches("1:*", batch), options, batch.window, nullptr);
+  this->markAsSeen(this->receiveNewEmailUIDs(searchTag));
 
-  // Verify that fetching emails was successful
-  if (this->toLowerCase(response).find(std::to_string(this->tag) + " ok") == std::string::npos) {
-    throw std::runtime_error("Could not fetch emails.");
+  std::unordered_map<std::string, std::string> emails;
+  for (std::string &response : responses) {
+    emails.merge(this->parseEmails(response));
   }
 
-  this->tag++;
-  this->read();
-
-  return this->parseEmails(response);
+  return emails;
 }
 
 /**
  * @brief Get only new emails in selected mailbox by sending the FETCH command to the server
  *
  * @param options Specify which email contents to fetch
+ * @param batch Specify how to split emails into multiple FETCH commands
  * @return std::unordered_map<std::string, std::string> Pairs, where the key is the UID of an email and the value is the
  * contents of the email
  */
-std::unordered_map<std::string, std::string> IMAPClient::fetchNew(FetchOptions options) {
+std::unordered_map<std::string, std::string> IMAPClient::fetchNew(FetchOptions options, BatchOptions batch) {
   // User must be logged in before fetching emails
   if (!this->isLoggedIn) {
     throw std::runtime_error("User must be logged in before fetching emails.");
@@ -208,120 +550,1438 @@ std::unordered_map<std::string, std::string> IMAPClient::fetchNew(FetchOptions o
     return {};
   }
 
-  // Send FETCH command to server
-  std::string command = std::to_string(this->tag) + " fetch " + uids + " body.peek[" +
-                        (options == FetchOptions::ALL ? "" : "header") + "]\r\n";
-  std::string response = this->connection->sendCommand(this->tag, command);
+  std::vector<std::string> responses = this->sendFetch(this->getBatches(uids, batch), options, batch.window, nullptr);
+  this->markAsSeen(uids);
 
-  // Verify that fetching emails was successful
-  if (this->toLowerCase(response).find(std::to_string(this->tag) + " ok") == std::string::npos) {
-    throw std::runtime_error("Could not fetch emails.");
+  std::unordered_map<std::string, std::string> emails;
+  for (std::string &response : responses) {
+    emails.merge(this->parseEmails(response));
   }
 
-  this->tag++;
-  this->read();
-
-  return this->parseEmails(response);
+  return emails;
 }
 
-void IMAPClient::read() {
+/**
+ * @brief Get all emails in selected mailbox with their flags as views into memory owned by the result
+ *
+ * Works like IMAPClient::fetch, but every email is copied only once, from the receive buffer of the connection into
+ * the memory of the result, instead of into a string of the response, its own string and the returned map.
+ *
+ * @param options Specify which email contents to fetch
+ * @param batch Specify how to split emails into multiple FETCH commands
+ * @return FetchedEmails Emails, whose views are valid until the result is released or destroyed
+ */
+FetchedEmails IMAPClient::fetchViews(FetchOptions options, BatchOptions batch) {
   // User must be logged in before fetching emails
   if (!this->isLoggedIn) {
-    throw std::runtime_error("User must be logged in before reading emails.");
+    throw std::runtime_error("User must be logged in before fetching emails.");
   }
 
-  // Get UIDs of new emails
-  std::string uids = this->getNewEmailUIDs();
-  if (uids.empty()) {
-    return;
+  // Selected mailbox must not be empty
+  FetchedEmails emails;
+  if (this->isMailboxEmpty) {
+    return emails;
   }
 
-  // Send STORE command to server
-  std::string command = std::to_string(this->tag) + " store " + uids + " +flags.silent (\\seen)\r\n";
-  std::string response = this->connection->sendCommand(this->tag, command);
-
-  // Verify that storing flags was successful
-  if (this->toLowerCase(response).find(std::to_string(this->tag) + " ok") == std::string::npos) {
-    throw std::runtime_error("Could not store flags.");
-  }
+  // Search for new emails in the same round trip as the FETCH commands
+  unsigned int searchTag = this->submitSearchNew();
+  this->sendFetch(this->getBatches("1:*", batch), options, batch.window, &emails, true);
+  this->markAsSeen(this->receiveNewEmailUIDs(searchTag));
 
-  this->tag++;
+  return emails;
 }
 
 /**
- * @brief Parses a FETCH response into a map of emails
+ * @brief Get only new emails in selected mailbox with their flags as views into memory owned by the result
  *
- * @param fetchResponse FETCH response sent from the server
- * @return std::unordered_map<std::string, std::string> Pairs, where the key is the UID of an email and the value is the
- * contents of the email
+ * Works like IMAPClient::fetchNew with the memory of IMAPClient::fetchViews.
+ *
+ * @param options Specify which email contents to fetch
+ * @param batch Specify how to split emails into multiple FETCH commands
+ * @return FetchedEmails Emails, whose views are valid until the result is released or destroyed
  */
-std::unordered_map<std::string, std::string> IMAPClient::parseEmails(std::string fetchResponse) {
-  std::unordered_map<std::string, std::string> emails;
-  unsigned long pointer = 0;  // Position in the fetch response
-  unsigned long lastRowStartIndex = fetchResponse.substr(0, fetchResponse.length() - 2).find_last_of("\r\n");
-
-  while (pointer < lastRowStartIndex) {
-    // Parse the first line of currently proccessed email
-    std::string firstLine = fetchResponse.substr(pointer, fetchResponse.substr(pointer).find_first_of("\r\n"));
-    std::string emailUID = firstLine.substr(2, firstLine.substr(2).find_first_of(" "));
-
-    // Parse the email size
-    unsigned long emailSizeStart = firstLine.find_first_of("{");
-    unsigned long emailSizeEnd = firstLine.find_first_of("}");
-    if (emailSizeStart == std::string::npos || emailSizeEnd == std::string::npos) {
-      throw std::runtime_error("Invalid fetch response format.");
-    }
-    int emailSize = std::stoi(firstLine.substr(emailSizeStart + 1, emailSizeEnd - emailSizeStart - 1));
+FetchedEmails IMAPClient::fetchNewViews(FetchOptions options, BatchOptions batch) {
+  // User must be logged in before fetching emails
+  if (!this->isLoggedIn) {
+    throw std::runtime_error("User must be logged in before fetching emails.");
+  }
 
-    // Parse the email content
-    std::string email = fetchResponse.substr(pointer + emailSizeEnd + 3, emailSize);
-    std::string fileName = this->hostname + "_" + this->mailbox + "_" + emailUID + ".eml";
-    emails.insert({fileName, email});
+  // Selected mailbox must not be empty
+  FetchedEmails emails;
+  if (this->isMailboxEmpty) {
+    return emails;
+  }
 
-    pointer += emailSizeEnd + 3 + emailSize + 3;
+  // Get UIDs of new emails
+  std::string uids = this->getNewEmailUIDs();
+  if (uids.empty()) {
+    return emails;
   }
 
+  this->sendFetch(this->getBatches(uids, batch), options, batch.window, &emails, true);
+  this->markAsSeen(uids);
+
   return emails;
 }
 
 /**
- * @brief Get UIDs of emails that are new by sending a SEARCH command to the server
+ * @brief Save all emails in selected mailbox to a directory while they are received from the server
  *
- * @return std::string Sequence set representing UIDs of new emails
+ * @param options Specify which email contents to fetch
+ * @param directoryPath Path where to save emails
+ * @param batch Specify how to split emails into multiple FETCH commands
+ * @param connectionCount Number of connections that download emails in parallel
+ * @return std::size_t Number of saved emails
  */
-std::string IMAPClient::getNewEmailUIDs() {
-  // User must be logged in
+std::size_t IMAPClient::download(FetchOptions options,
+                                 std::string directoryPath,
+                                 BatchOptions batch,
+                                 unsigned int connectionCount) {
+  // User must be logged in before fetching emails
   if (!this->isLoggedIn) {
     throw std::runtime_error("User must be logged in before fetching emails.");
   }
 
-  // Send SEARCH command to server
-  std::string command = std::to_string(this->tag) + " search new\r\n";
-  std::string response = this->connection->sendCommand(this->tag, command);
-
-  // Verify that searching emails was successful
-  if (this->toLowerCase(response).find(std::to_string(this->tag) + " ok") == std::string::npos) {
-    throw std::runtime_error("Could not search emails.");
+  // Selected mailbox must not be empty
+  if (this->isMailboxEmpty) {
+    return 0;
   }
 
-  // Parse the response
-  std::string firstLine = response.substr(0, response.find_first_of("\r\n"));
-  if (firstLine.length() == 8) {
-    return "";
-  }
-  std::string uids = response.substr(9, response.find_first_of("\r\n") - 9);
+  // Search for new emails in the same round trip as the FETCH commands
+  unsigned int searchTag = this->submitSearchNew();
+  std::size_t count = this->downloadSequenceSet("1:*", options, directoryPath, batch, connectionCount);
+  this->markAsSeen(this->receiveNewEmailUIDs(searchTag));
 
-  // Replace all spaces with commas to create a valid sequence set
-  for (char &character : uids) {
-    if (character == ' ') {
-      character = ',';
+  return count;
+}
+
+/**
+ * @brief Save only new emails in selected mailbox to a directory while they are received from the server
+ *
+ * @param options Specify which email contents to fetch
+ * @param directoryPath Path where to save emails
+ * @param batch Specify how to split emails into multiple FETCH commands
+ * @param connectionCount Number of connections that download emails in parallel
+ * @return std::size_t Number of saved emails
+ */
+std::size_t IMAPClient::downloadNew(FetchOptions options,
+                                    std::string directoryPath,
+                                    BatchOptions batch,
+                                    unsigned int connectionCount) {
+  // User must be logged in before fetching emails
+  if (!this->isLoggedIn) {
+    throw std::runtime_error("User must be logged in before fetching emails.");
+  }
+
+  // Selected mailbox must not be empty
+  if (this->isMailboxEmpty) {
+    return 0;
+  }
+
+  // Get UIDs of new emails
+  std::string uids = this->getNewEmailUIDs();
+  if (uids.empty()) {
+    return 0;
+  }
+
+  std::size_t count = this->downloadSequenceSet(uids, options, directoryPath, batch, connectionCount);
+  this->markAsSeen(uids);
+
+  return count;
+}
+
+/**
+ * @brief Synchronize the output directory with selected mailbox using the state of the last synchronization
+ *
+ * Only emails whose UIDs are not stored yet are downloaded and only files of emails that were removed from the mailbox
+ * are deleted. If UIDNEXT and the number of emails did not change, nothing is sent to the server. The caller must
+ * start with an empty state if UIDVALIDITY of the mailbox changed.
+ *
+ * @param options Specify which email contents to fetch
+ * @param directoryPath Path where emails are saved
+ * @param state State of the last synchronization, which is updated
+ * @param batch Specify how to split emails into multiple FETCH commands
+ * @param connectionCount Number of connections that download emails in parallel
+ * @return std::size_t Number of downloaded emails
+ */
+std::size_t IMAPClient::sync(FetchOptions options,
+                             std::string directoryPath,
+                             SyncState &state,
+                             BatchOptions batch,
+                             unsigned int connectionCount) {
+  // User must be logged in before fetching emails
+  if (!this->isLoggedIn) {
+    throw std::runtime_error("User must be logged in before fetching emails.");
+  }
+
+  // Nothing was added or removed since the last synchronization
+  if (this->uidNext != 0 && state.uidNext == this->uidNext && state.uids.size() == this->emailCount &&
+      state.highestModSeq == this->highestModSeq) {
+    return 0;
+  }
+
+  // Apply only changes reported by QRESYNC
+  if (this->isResynchronized) {
+    return this->resync(options, directoryPath, state, batch, connectionCount);
+  }
+
+  // Search for new emails in the same round trip as the FETCH commands
+  unsigned int searchTag = this->submitSearchNew();
+  std::map<unsigned long, std::string> flags;
+  std::vector<unsigned long> uids = this->fetchUIDs(flags);
+
+  // Download emails that are not stored yet
+  std::string newEmails = this->reconcileState(uids, directoryPath, state);
+  std::size_t count = 0;
+  if (!newEmails.empty()) {
+    count = this->downloadSequenceSet(newEmails, options, directoryPath, batch, connectionCount, &uids);
+  }
+  this->markAsSeen(this->receiveNewEmailUIDs(searchTag));
+
+  this->updateState(state, uids, flags);
+  this->updateIndex(directoryPath, state);
+  return count;
+}
+
+/**
+ * @brief Delete files of emails that were removed from the mailbox and find emails that are not stored yet
+ *
+ * @param uids UIDs of emails in the mailbox, where the index is the sequence number minus one
+ * @param directoryPath Path where emails are saved
+ * @param state State of the last synchronization
+ * @return std::string Sequence set of emails that are not stored yet
+ */
+std::string IMAPClient::reconcileState(const std::vector<unsigned long> &uids,
+                                       std::string directoryPath,
+                                       const SyncState &state) {
+  // Delete files of emails that were removed from the mailbox
+  std::set<unsigned long> serverUIDs{uids.begin(), uids.end()};
+  std::unique_ptr<EmailWriter> writer = this->createWriter(directoryPath, true);
+  for (unsigned long uid : state.uids) {
+    if (!serverUIDs.contains(uid)) {
+      writer->deleteEmail(std::to_string(uid));
+    }
+  }
+
+  std::vector<unsigned long> newEmails;
+  for (unsigned long number = 1; number <= uids.size(); number++) {
+    if (!state.uids.contains(uids[number - 1])) {
+      newEmails.push_back(number);
+    }
+  }
+
+  return this->toSequenceSet(newEmails.cbegin(), newEmails.cend());
+}
+
+/**
+ * @brief Store the selected mailbox in the state after all of its emails were downloaded
+ *
+ * @param state State of the synchronization
+ * @param uids UIDs of emails in the mailbox
+ * @param flags Flags of emails, where the key is the UID of an email
+ */
+void IMAPClient::updateState(SyncState &state,
+                             const std::vector<unsigned long> &uids,
+                             std::map<unsigned long, std::string> flags) {
+  state.uidValidity = this->uidValidity;
+  state.uidNext = this->uidNext;
+  state.highestModSeq = this->highestModSeq;
+  state.uids = {uids.begin(), uids.end()};
+  state.uids.erase(0);
+  state.flags = std::move(flags);
+}
+
+/**
+ * @brief Synchronize the output directory using changes reported by QRESYNC when the mailbox was selected
+ *
+ * Falls back to comparing all UIDs if the changes do not match the number of emails in the mailbox.
+ *
+ * @param options Specify which email contents to fetch
+ * @param directoryPath Path where emails are saved
+ * @param state State of the last synchronization, which is updated
+ * @param batch Specify how to split emails into multiple FETCH commands
+ * @param connectionCount Number of connections that download emails in parallel
+ * @return std::size_t Number of downloaded emails
+ */
+std::size_t IMAPClient::resync(FetchOptions options,
+                               std::string directoryPath,
+                               SyncState &state,
+                               BatchOptions batch,
+                               unsigned int connectionCount) {
+  std::set<unsigned long> uids = state.uids;
+  for (unsigned long uid : this->vanishedUIDs) {
+    uids.erase(uid);
+  }
+
+  std::vector<unsigned long> newEmails;
+  for (const ChangedEmail &email : this->changedEmails) {
+    if (!uids.contains(email.uid)) {
+      newEmails.push_back(email.sequenceNumber);
+      uids.insert(email.uid);
+    }
+  }
+
+  // The server did not report all changes, so compare all UIDs instead
+  if (uids.size() != this->emailCount) {
+    this->isResynchronized = false;
+    return this->sync(options, directoryPath, state, batch, connectionCount);
+  }
+
+  // Delete files of emails that were removed from the mailbox
+  std::unique_ptr<EmailWriter> writer = this->createWriter(directoryPath, true);
+  for (unsigned long uid : this->vanishedUIDs) {
+    if (state.uids.contains(uid)) {
+      writer->deleteEmail(std::to_string(uid));
+      state.flags.erase(uid);
+    }
+  }
+
+  // Download emails that are not stored yet
+  std::size_t count = 0;
+  if (!newEmails.empty()) {
+    std::sort(newEmails.begin(), newEmails.end());
+    unsigned int searchTag = this->submitSearchNew();
+    count = this->downloadSequenceSet(this->toSequenceSet(newEmails.cbegin(), newEmails.cend()), options,
+                                      directoryPath, batch, connectionCount);
+    this->markAsSeen(this->receiveNewEmailUIDs(searchTag));
+  }
+
+  for (const ChangedEmail &email : this->changedEmails) {
+    state.flags[email.uid] = email.flags;
+  }
+
+  state.uidNext = this->uidNext;
+  state.highestModSeq = this->highestModSeq;
+  state.uids = uids;
+  this->updateIndex(directoryPath, state);
+
+  return count;
+}
+/**
+ * @brief Mark new emails in selected mailbox as seen
+ */
+void IMAPClient::read() {
+  // User must be logged in before fetching emails
+  if (!this->isLoggedIn) {
+    throw std::runtime_error("User must be logged in before reading emails.");
+  }
+
+  // Get UIDs of new emails
+  this->markAsSeen(this->getNewEmailUIDs());
+}
+
+/**
+ * @brief Start waiting for changes of the selected mailbox by sending the IDLE command to the server
+ */
+void IMAPClient::startIdle() {
+  // User must be logged in before idling
+  if (!this->isLoggedIn) {
+    throw std::runtime_error("User must be logged in before idling.");
+  }
+
+  if (!this->hasCapability("idle")) {
+    throw std::runtime_error("Server does not support IDLE.");
+  }
+
+  // Send IDLE command to server
+  std::string command = std::to_string(this->tag) + " idle\r\n";
+  this->connection->submitCommand(this->tag, command);
+  this->idleTag = this->tag;
+  this->tag++;
+
+  // Wait for the continuation request, which confirms that the server is idling
+  while (true) {
+    std::string response = this->connection->readAvailable(this->idleTag);
+    this->parseIdleResponse(response);
+
+    if (response.starts_with("+") || response.find("\r\n+") != std::string::npos) {
+      break;
+    }
+    std::string idleTagString = std::to_string(this->idleTag) + " ";
+    if (response.starts_with(idleTagString) || response.find("\r\n" + idleTagString) != std::string::npos) {
+      this->connection->readResponse(this->idleTag);
+      this->idleTag = 0;
+      throw std::runtime_error("Could not start IDLE.");
+    }
+  }
+}
+
+/**
+ * @brief Read responses that the server sent while idling
+ *
+ * Waits for the server if no data was received yet.
+ *
+ * @return true If emails were added to or removed from the selected mailbox
+ * @return false If the responses did not change the selected mailbox
+ */
+bool IMAPClient::readIdle() {
+  if (!this->isMailboxChanged) {
+    this->parseIdleResponse(this->connection->readAvailable(this->idleTag));
+  }
+
+  bool isChanged = this->isMailboxChanged;
+  this->isMailboxChanged = false;
+
+  return isChanged;
+}
+
+/**
+ * @brief Stop idling by sending DONE to the server
+ */
+void IMAPClient::stopIdle() {
+  if (this->idleTag == 0) {
+    return;
+  }
+
+  this->connection->sendData("DONE\r\n");
+  std::string response = this->connection->readResponse(this->idleTag);
+  this->parseIdleResponse(response);
+
+  // Verify that IDLE was successful
+  if (this->toLowerCase(response).find(std::to_string(this->idleTag) + " ok") == std::string::npos) {
+    this->idleTag = 0;
+    throw std::runtime_error("Could not stop IDLE.");
+  }
+
+  this->idleTag = 0;
+}
+
+/**
+ * @brief Check if responses from the server can be read without waiting
+ *
+ * @return true If data was received or a change of the mailbox was not handled yet
+ * @return false If reading would wait for the server
+ */
+bool IMAPClient::hasPendingData() {
+  return this->isMailboxChanged || this->connection->hasPendingData();
+}
+
+/**
+ * @brief Get the socket of the connection, which can be used to wait for data from the server
+ *
+ * @return int File descriptor of the socket
+ */
+int IMAPClient::getFd() {
+  return this->connection->getFd();
+}
+
+/**
+ * @brief Send FETCH commands for sets of emails to the server
+ *
+ * Up to window commands are sent before waiting for a response, so the next batches are already requested while the
+ * current one is being received.
+ *
+ * @param sequenceSets Sequence sets of emails to fetch, one for each FETCH command
+ * @param options Specify which email contents to fetch
+ * @param window Maximum number of commands waiting for a response
+ * @param sink Receives the contents of emails instead of the returned responses, if set
+ * @param usingFlags Represents if flags of emails are fetched in any output format
+ * @param usingUIDs Represents if the sets contain UIDs instead of sequence numbers
+ * @return std::vector<std::string> Responses from the server
+ */
+std::vector<std::string> IMAPClient::sendFetch(std::vector<std::string> sequenceSets,
+                                               FetchOptions options,
+                                               unsigned int window,
+                                               LiteralSink *sink,
+                                               bool usingFlags,
+                                               bool usingUIDs) {
+  std::vector<std::string> responses;
+  std::size_t sentCount = 0;
+  window = std::max(window, 1u);
+
+  while (responses.size() < sequenceSets.size()) {
+    // Send FETCH commands to server until the window is full
+    while (sentCount < sequenceSets.size() && sentCount - responses.size() < window) {
+      std::string command = std::to_string(this->tag) + " " +
+                            this->getFetchArguments(sequenceSets[sentCount], options, usingFlags, usingUIDs) + "\r\n";
+      this->connection->submitCommand(this->tag, command);
+
+      this->tag++;
+      sentCount++;
+    }
+
+    // Receive response of the oldest sent command
+    unsigned int responseTag = this->tag - (sentCount - responses.size());
+    std::string response = this->connection->readResponse(responseTag, sink);
+
+    // Verify that fetching emails was successful
+    if (this->toLowerCase(response).find(std::to_string(responseTag) + " ok") == std::string::npos) {
+      throw std::runtime_error("Could not fetch emails.");
+    }
+
+    responses.push_back(response);
+  }
+
+  return responses;
+}
+
+/**
+ * @brief Save a set of emails to a directory while they are received from the server
+ *
+ * With the store output format, full emails whose Message-ID and size are already in the store are linked without
+ * downloading them. Full emails larger than the partial size are downloaded in resumable ranges by this client.
+ *
+ * @param sequenceSet Sequence set of emails to download
+ * @param options Specify which email contents to fetch
+ * @param directoryPath Path where to save emails
+ * @param batch Specify how to split emails into multiple FETCH commands
+ * @param connectionCount Number of connections that download emails in parallel
+ * @param uids UIDs of emails in the mailbox, where the index is the sequence number minus one, fetched if needed and
+ * not set
+ * @return std::size_t Number of saved emails
+ */
+std::size_t IMAPClient::downloadSequenceSet(std::string sequenceSet,
+                                            FetchOptions options,
+                                            std::string directoryPath,
+                                            BatchOptions batch,
+                                            unsigned int connectionCount,
+                                            const std::vector<unsigned long> *uids) {
+  if (options != FetchOptions::ALL) {
+    return this->downloadParts(sequenceSet, options, directoryPath, batch, connectionCount, uids);
+  }
+
+  // Link emails that are already in the store instead of downloading them
+  std::size_t count = 0;
+  std::string response;
+  if (this->outputFormat == EmailWriter::Format::STORE) {
+    std::string command = std::to_string(this->tag) + " " + this->getMessageIdArguments(sequenceSet) + "\r\n";
+    response = this->connection->sendCommand(this->tag, command);
+
+    // Verify that fetching Message-IDs was successful
+    if (this->toLowerCase(response).find(std::to_string(this->tag) + " ok") == std::string::npos) {
+      throw std::runtime_error("Could not fetch Message-IDs.");
+    }
+
+    this->tag++;
+    sequenceSet = this->linkStoredEmails(sequenceSet, response, directoryPath, count);
+    if (sequenceSet.empty()) {
+      return count;
+    }
+  }
+
+  // Download large emails in ranges, the response with Message-IDs contains their sizes too
+  if (this->partialSize != 0) {
+    if (response.empty()) {
+      std::string command = std::to_string(this->tag) + " fetch " + sequenceSet + " (uid rfc822.size)\r\n";
+      response = this->connection->sendCommand(this->tag, command);
+
+      // Verify that fetching sizes was successful
+      if (this->toLowerCase(response).find(std::to_string(this->tag) + " ok") == std::string::npos) {
+        throw std::runtime_error("Could not fetch email sizes.");
+      }
+
+      this->tag++;
+    }
+
+    std::vector<std::pair<unsigned long, std::size_t>> largeEmails;
+    sequenceSet = this->splitLargeEmails(sequenceSet, response, largeEmails);
+    count += this->downloadLargeEmails(largeEmails, directoryPath);
+    if (sequenceSet.empty()) {
+      return count;
+    }
+  }
+
+  return count + this->downloadParts(sequenceSet, options, directoryPath, batch, connectionCount, uids);
+}
+
+/**
+ * @brief Save a set of emails to a directory using one or more connections
+ *
+ * With more than one connection, UIDs of the emails are split into contiguous parts and each part is downloaded by its
+ * own session in a separate thread with UID FETCH, because sequence numbers of sessions differ when an email is
+ * expunged or added between their SELECT commands. The first part is downloaded by this client.
+ *
+ * @param sequenceSet Sequence set of emails to download
+ * @param options Specify which email contents to fetch
+ * @param directoryPath Path where to save emails
+ * @param batch Specify how to split emails into multiple FETCH commands
+ * @param connectionCount Number of connections that download emails in parallel
+ * @param uids UIDs of emails in the mailbox, where the index is the sequence number minus one, fetched if needed and
+ * not set
+ * @return std::size_t Number of saved emails
+ */
+std::size_t IMAPClient::downloadParts(std::string sequenceSet,
+                                      FetchOptions options,
+                                      std::string directoryPath,
+                                      BatchOptions batch,
+                                      unsigned int connectionCount,
+                                      const std::vector<unsigned long> *uids) {
+  if (connectionCount <= 1) {
+    std::unique_ptr<EmailWriter> writer = this->createWriter(directoryPath);
+    this->sendFetch(this->getBatches(sequenceSet, batch), options, batch.window, writer.get());
+    writer->flush();
+
+    return writer->getCount();
+  }
+
+  std::map<unsigned long, std::string> flags;
+  std::vector<unsigned long> fetchedUIDs;
+  if (uids == nullptr) {
+    fetchedUIDs = this->fetchUIDs(flags);
+    uids = &fetchedUIDs;
+  }
+
+  std::vector<unsigned long> emailUIDs;
+  for (unsigned long number : this->parseSequenceSet(sequenceSet)) {
+    if (number >= 1 && number <= uids->size() && (*uids)[number - 1] != 0) {
+      emailUIDs.push_back((*uids)[number - 1]);
+    }
+  }
+  std::sort(emailUIDs.begin(), emailUIDs.end());
+
+  // Split UIDs into one contiguous part for every connection
+  std::vector<std::string> parts;
+  for (unsigned int part = 0; part < connectionCount; part++) {
+    auto partStart = emailUIDs.cbegin() + emailUIDs.size() * part / connectionCount;
+    auto partEnd = emailUIDs.cbegin() + emailUIDs.size() * (part + 1) / connectionCount;
+    if (partStart != partEnd) {
+      parts.push_back(this->toSequenceSet(partStart, partEnd));
+    }
+  }
+
+  if (parts.empty()) {
+    return 0;
+  }
+
+  std::atomic<std::size_t> count{0};
+  std::vector<std::exception_ptr> errors(parts.size());
+  std::vector<std::thread> workers;
+
+  for (std::size_t part = 1; part < parts.size(); part++) {
+    workers.emplace_back([this, &parts, &count, &errors, part, options, directoryPath, batch]() {
+      try {
+        std::unique_ptr<IMAPClient> session = this->openSession();
+        session->select(this->mailbox);
+        count += session->downloadUIDs(parts[part], options, directoryPath, batch);
+      } catch (...) {
+        errors[part] = std::current_exception();
+      }
+    });
+  }
+
+  try {
+    count += this->downloadUIDs(parts.front(), options, directoryPath, batch);
+  } catch (...) {
+    errors.front() = std::current_exception();
+  }
+
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+
+  for (std::exception_ptr &error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+  return count;
+}
+
+/**
+ * @brief Save a set of emails given by their UIDs to a directory while they are received from the server
+ *
+ * @param uidSet UID set of emails to download
+ * @param options Specify which email contents to fetch
+ * @param directoryPath Path where to save emails
+ * @param batch Specify how to split emails into multiple UID FETCH commands
+ * @return std::size_t Number of saved emails
+ */
+std::size_t IMAPClient::downloadUIDs(std::string uidSet,
+                                     FetchOptions options,
+                                     std::string directoryPath,
+                                     BatchOptions batch) {
+  std::unique_ptr<EmailWriter> writer = this->createWriter(directoryPath);
+  this->sendFetch(this->getBatches(uidSet, batch, true), options, batch.window, writer.get(), false, true);
+  writer->flush();
+
+  return writer->getCount();
+}
+
+/**
+ * @brief Separate emails larger than the partial size from a sequence set
+ *
+ * @param sequenceSet Sequence set of emails
+ * @param response FETCH response with UIDs and sizes of the emails
+ * @param largeEmails Pairs of a UID and a size of every large email, which are added
+ * @return std::string Sequence set of the remaining emails
+ */
+std::string IMAPClient::splitLargeEmails(std::string sequenceSet,
+                                         std::string response,
+                                         std::vector<std::pair<unsigned long, std::size_t>> &largeEmails) {
+  // Parse lines in format "* 1 FETCH (UID 7 RFC822.SIZE 42 ..."
+  std::unordered_map<unsigned long, std::pair<unsigned long, std::size_t>> emails;
+  response = this->toLowerCase(response);
+  std::size_t lineStart = 0;
+  while (lineStart < response.length()) {
+    std::size_t lineEnd = response.find("\r\n", lineStart);
+    if (lineEnd == std::string::npos) {
+      lineEnd = response.length();
+    }
+
+    std::string line = response.substr(lineStart, lineEnd - lineStart);
+    std::size_t uidStart = line.find("uid ");
+    std::size_t sizeStart = line.find("rfc822.size ");
+    if (line.starts_with("* ") && line.find(" fetch ") != std::string::npos && uidStart != std::string::npos &&
+        sizeStart != std::string::npos) {
+      emails[std::stoul(line.substr(2))] = {std::stoul(line.substr(uidStart + 4)),
+                                            std::stoull(line.substr(sizeStart + 12))};
+    }
+
+    lineStart = lineEnd + 2;
+  }
+
+  std::vector<unsigned long> numbers = this->parseSequenceSet(sequenceSet);
+  std::vector<unsigned long> remainingNumbers;
+  for (unsigned long number : numbers) {
+    auto email = emails.find(number);
+    if (email != emails.end() && email->second.second > this->partialSize) {
+      largeEmails.push_back(email->second);
+    } else {
+      remainingNumbers.push_back(number);
+    }
+  }
+
+  return this->toSequenceSet(remainingNumbers.cbegin(), remainingNumbers.cend());
+}
+
+/**
+ * @brief Save large emails to a directory by fetching them in ranges of the partial size
+ *
+ * A range is requested only after the previous one was received and recorded, so an interrupted download loses at
+ * most one range.
+ *
+ * @param largeEmails Pairs of a UID and a size of every email
+ * @param directoryPath Path where to save emails
+ * @return std::size_t Number of saved emails
+ */
+std::size_t IMAPClient::downloadLargeEmails(const std::vector<std::pair<unsigned long, std::size_t>> &largeEmails,
+                                            std::string directoryPath) {
+  if (largeEmails.empty()) {
+    return 0;
+  }
+
+  std::unique_ptr<EmailWriter> writer = this->createWriter(directoryPath);
+  for (const auto &[uid, size] : largeEmails) {
+    PartialDownload download{directoryPath, this->hostname, this->mailbox, this->uidValidity, uid, size};
+
+    while (!download.isComplete()) {
+      std::string command =
+          std::to_string(this->tag) + " " + download.getFetchArguments(this->partialSize) + "\r\n";
+      std::string response = this->connection->sendCommand(this->tag, command, &download);
+
+      // Verify that fetching the range was successful and the email is still in the mailbox
+      if (this->toLowerCase(response).find(std::to_string(this->tag) + " ok") == std::string::npos ||
+          !download.checkRange(response)) {
+        throw std::runtime_error("Could not fetch emails.");
+      }
+
+      this->tag++;
+    }
+
+    download.deliver(*writer);
+  }
+  writer->flush();
+
+  return writer->getCount();
+}
+
+/**
+ * @brief Split a sequence set into batches
+ *
+ * @param sequenceSet Sequence set of emails to fetch
+ * @param batch Specify how to split the emails
+ * @param usingUIDs Represents if the set contains UIDs instead of sequence numbers
+ * @return std::vector<std::string> Sequence sets, one for each batch
+ */
+std::vector<std::string> IMAPClient::getBatches(std::string sequenceSet, BatchOptions batch, bool usingUIDs) {
+  if (batch.emailCount == 0 && batch.byteCount == 0) {
+    return {sequenceSet};
+  }
+
+  std::unordered_map<unsigned long, std::size_t> sizes;
+  if (batch.byteCount != 0) {
+    sizes = this->getEmailSizes(sequenceSet, usingUIDs);
+  }
+
+  return this->splitBatches(sequenceSet, sizes, batch);
+}
+
+/**
+ * @brief Split a sequence set into batches using known sizes of emails
+ *
+ * @param sequenceSet Sequence set of emails to fetch
+ * @param sizes Sizes of emails, where the key is the sequence number of an email
+ * @param batch Specify how to split the emails
+ * @return std::vector<std::string> Sequence sets, one for each batch
+ */
+std::vector<std::string> IMAPClient::splitBatches(std::string sequenceSet,
+                                                  std::unordered_map<unsigned long, std::size_t> sizes,
+                                                  BatchOptions batch) {
+  std::vector<unsigned long> numbers = this->parseSequenceSet(sequenceSet);
+  std::vector<std::string> batches;
+  auto batchStart = numbers.cbegin();
+  std::size_t batchSize = 0;
+
+  for (auto number = numbers.cbegin(); number != numbers.cend(); number++) {
+    std::size_t emailSize = sizes.contains(*number) ? sizes[*number] : 0;
+
+    // Start a new batch if adding the email would exceed any of the limits
+    bool isCountExceeded = batch.emailCount != 0 && static_cast<unsigned long>(number - batchStart) >= batch.emailCount;
+    bool isSizeExceeded = batch.byteCount != 0 && batchSize + emailSize > batch.byteCount;
+    if (number != batchStart && (isCountExceeded || isSizeExceeded)) {
+      batches.push_back(this->toSequenceSet(batchStart, number));
+      batchStart = number;
+      batchSize = 0;
+    }
+
+    batchSize += emailSize;
+  }
+
+  if (batchStart != numbers.cend()) {
+    batches.push_back(this->toSequenceSet(batchStart, numbers.cend()));
+  }
+
+  return batches;
+}
+
+/**
+ * @brief Get sizes of emails by sending a FETCH RFC822.SIZE command to the server
+ *
+ * @param sequenceSet Sequence set of emails
+ * @param usingUIDs Represents if the set contains UIDs instead of sequence numbers, which are then used as keys
+ * @return std::unordered_map<unsigned long, std::size_t> Pairs, where the key is the sequence number of an email and
+ * the value is its size in bytes
+ */
+std::unordered_map<unsigned long, std::size_t> IMAPClient::getEmailSizes(std::string sequenceSet, bool usingUIDs) {
+  // Send FETCH command to server
+  std::string command =
+      std::to_string(this->tag) + (usingUIDs ? " uid fetch " : " fetch ") + sequenceSet + " rfc822.size\r\n";
+  std::string response = this->toLowerCase(this->connection->sendCommand(this->tag, command));
+
+  // Verify that fetching sizes was successful
+  if (response.find(std::to_string(this->tag) + " ok") == std::string::npos) {
+    throw std::runtime_error("Could not fetch email sizes.");
+  }
+
+  this->tag++;
+  return this->parseEmailSizes(response, usingUIDs);
+}
+
+/**
+ * @brief Parse a FETCH RFC822.SIZE response into sizes of emails
+ *
+ * @param response Response from the server in lower case
+ * @param usingUIDs Represents if UIDs of emails are used as keys, which UID FETCH responses contain
+ * @return std::unordered_map<unsigned long, std::size_t> Pairs, where the key is the sequence number of an email and
+ * the value is its size in bytes
+ */
+std::unordered_map<unsigned long, std::size_t> IMAPClient::parseEmailSizes(std::string response, bool usingUIDs) {
+  // Parse lines in format "* 1 FETCH (RFC822.SIZE 42)"
+  std::unordered_map<unsigned long, std::size_t> sizes;
+  std::size_t lineStart = 0;
+  while (lineStart < response.length()) {
+    std::size_t lineEnd = response.find("\r\n", lineStart);
+    if (lineEnd == std::string::npos) {
+      lineEnd = response.length();
+    }
+
+    std::string line = response.substr(lineStart, lineEnd - lineStart);
+    std::size_t sizeStart = line.find("rfc822.size ");
+    std::size_t uidStart = line.find("uid ");
+    if (line.starts_with("* ") && sizeStart != std::string::npos && (!usingUIDs || uidStart != std::string::npos)) {
+      unsigned long key = usingUIDs ? std::stoul(line.substr(uidStart + 4)) : std::stoul(line.substr(2));
+      sizes[key] = std::stoull(line.substr(sizeStart + 12));
+    }
+
+    lineStart = lineEnd + 2;
+  }
+
+  return sizes;
+}
+
+/**
+ * @brief Expand a sequence set into a list of sequence numbers
+ *
+ * @param sequenceSet Sequence set, e.g. "1:3,7"
+ * @return std::vector<unsigned long> Sequence numbers
+ */
+std::vector<unsigned long> IMAPClient::parseSequenceSet(std::string sequenceSet) {
+  std::vector<unsigned long> numbers;
+  for (auto [first, last] : this->parseSequenceRanges(sequenceSet)) {
+    for (unsigned long number = first; number <= last; number++) {
+      numbers.push_back(number);
+    }
+  }
+
+  return numbers;
+}
+
+/**
+ * @brief Split a sequence set into ranges without expanding them
+ *
+ * @param sequenceSet Sequence set, e.g. "1:3,7"
+ * @return std::vector<std::pair<unsigned long, unsigned long>> Ranges with the lower number first, e.g. [1, 3] and
+ * [7, 7]
+ */
+std::vector<std::pair<unsigned long, unsigned long>> IMAPClient::parseSequenceRanges(std::string sequenceSet) {
+  std::vector<std::pair<unsigned long, unsigned long>> ranges;
+  std::size_t partStart = 0;
+
+  while (partStart < sequenceSet.length()) {
+    std::size_t partEnd = sequenceSet.find(',', partStart);
+    if (partEnd == std::string::npos) {
+      partEnd = sequenceSet.length();
+    }
+
+    std::string part = sequenceSet.substr(partStart, partEnd - partStart);
+    std::size_t rangeSeparator = part.find(':');
+    std::string first = part.substr(0, rangeSeparator);
+    std::string last = rangeSeparator == std::string::npos ? first : part.substr(rangeSeparator + 1);
+
+    // "*" represents the last email in the mailbox
+    unsigned long firstNumber = first == "*" ? this->emailCount : std::stoul(first);
+    unsigned long lastNumber = last == "*" ? this->emailCount : std::stoul(last);
+    ranges.emplace_back(std::min(firstNumber, lastNumber), std::max(firstNumber, lastNumber));
+
+    partStart = partEnd + 1;
+  }
+
+  return ranges;
+}
+
+/**
+ * @brief Create a compact sequence set from a list of sequence numbers
+ *
+ * @param begin Start of the list
+ * @param end End of the list
+ * @return std::string Sequence set, where consecutive numbers are joined into ranges
+ */
+std::string IMAPClient::toSequenceSet(std::vector<unsigned long>::const_iterator begin,
+                                      std::vector<unsigned long>::const_iterator end) {
+  std::string sequenceSet;
+
+  for (auto rangeStart = begin; rangeStart != end;) {
+    auto rangeEnd = rangeStart + 1;
+    while (rangeEnd != end && *rangeEnd == *(rangeEnd - 1) + 1) {
+      rangeEnd++;
+    }
+
+    sequenceSet += (sequenceSet.empty() ? "" : ",") + std::to_string(*rangeStart);
+    if (rangeEnd - rangeStart > 1) {
+      sequenceSet += ":" + std::to_string(*(rangeEnd - 1));
+    }
+
+    rangeStart = rangeEnd;
+  }
+
+  return sequenceSet;
+}
+
+/**
+ * @brief Create a writer which stores emails from the selected mailbox in the output format
+ *
+ * @param directoryPath Path where emails are saved
+ * @param isDeleting Represents if the writer only deletes emails, so it does not start writing in the background
+ * @return std::unique_ptr<EmailWriter> Email writer
+ */
+std::unique_ptr<EmailWriter> IMAPClient::createWriter(std::string directoryPath, bool isDeleting) {
+  std::unique_ptr<EmailWriter> writer = EmailWriter::create(this->outputFormat, directoryPath, this->hostname,
+                                                            this->mailbox, this->isWritingAsync && !isDeleting);
+  if (this->isIndexing) {
+    writer = std::make_unique<IndexingWriter>(std::move(writer), directoryPath, this->hostname, this->mailbox);
+  }
+
+  return writer;
+}
+
+/**
+ * @brief Update flags of emails from the selected mailbox in the header index after a synchronization
+ *
+ * @param directoryPath Path where emails are saved
+ * @param state State of the synchronization
+ */
+void IMAPClient::updateIndex(std::string directoryPath, const SyncState &state) {
+  if (!this->isIndexing) {
+    return;
+  }
+
+  std::shared_ptr<HeaderIndex> index = HeaderIndex::open(directoryPath);
+  index->update(this->hostname, this->mailbox, state.flags);
+  index->save();
+}
+
+/**
+ * @brief Parse a CAPABILITY response into the capabilities of the server
+ *
+ * @param response CAPABILITY response sent from the server in lower case
+ */
+void IMAPClient::parseCapabilities(std::string response) {
+  // Parse line in format "* CAPABILITY IMAP4rev1 IDLE"
+  std::size_t lineStart = response.find("* capability ");
+  std::size_t lineEnd = response.find("\r\n", lineStart);
+  if (lineStart != std::string::npos) {
+    std::string line = response.substr(lineStart + 13, lineEnd - lineStart - 13) + " ";
+    for (std::size_t start = 0, end = line.find(' '); end != std::string::npos;
+         start = end + 1, end = line.find(' ', start)) {
+      this->capabilities.insert(line.substr(start, end - start));
+    }
+  }
+}
+
+/**
+ * @brief Parse a LIST response into names of mailboxes
+ *
+ * @param response LIST response sent from the server
+ * @return std::vector<std::string> Names of mailboxes that can be selected
+ */
+std::vector<std::string> IMAPClient::parseMailboxes(std::string response) {
+  std::string lowerCaseResponse = this->toLowerCase(response);
+
+  // Parse lines in format '* LIST (\HasNoChildren) "/" "INBOX"', the name can also be an atom or a literal
+  std::vector<std::string> mailboxes;
+  std::size_t position = 0;
+  while (position < response.length()) {
+    std::size_t lineEnd = response.find("\r\n", position);
+    if (lineEnd == std::string::npos) {
+      break;
+    }
+
+    if (!lowerCaseResponse.substr(position, lineEnd - position).starts_with("* list (")) {
+      position = lineEnd + 2;
+      continue;
+    }
+
+    // Skip mailboxes that can not be selected
+    std::size_t flagsEnd = response.find(')', position);
+    std::string flags = lowerCaseResponse.substr(position, flagsEnd - position);
+    bool isSelectable =
+        flags.find("\\noselect") == std::string::npos && flags.find("\\nonexistent") == std::string::npos;
+
+    // Skip the hierarchy delimiter
+    std::size_t nameStart = flagsEnd + 2;
+    if (response[nameStart] == '"') {
+      nameStart = response.find('"', response[nameStart + 1] == '\\' ? nameStart + 3 : nameStart + 2) + 2;
+    } else {
+      nameStart = response.find(' ', nameStart) + 1;
+    }
+
+    std::string name;
+    if (response[nameStart] == '{') {
+      std::size_t literalEnd = response.find("}\r\n", nameStart);
+      std::size_t literalSize = std::stoul(response.substr(nameStart + 1, literalEnd - nameStart - 1));
+      name = response.substr(literalEnd + 3, literalSize);
+      lineEnd = response.find("\r\n", literalEnd + 3 + literalSize);
+    } else if (response[nameStart] == '"') {
+      std::size_t character = nameStart + 1;
+      for (; character < lineEnd && response[character] != '"'; character++) {
+        if (response[character] == '\\') {
+          character++;
+        }
+        name += response[character];
+      }
+    } else {
+      name = response.substr(nameStart, lineEnd - nameStart);
+    }
+
+    if (isSelectable) {
+      mailboxes.push_back(name);
+    }
+
+    position = lineEnd + 2;
+  }
+
+  return mailboxes;
+}
+
+/**
+ * @brief Get arguments of a FETCH command that fetches contents of emails
+ *
+ * @param sequenceSet Sequence set of emails to fetch
+ * @param options Specify which email contents to fetch
+ * @param usingFlags Represents if flags are fetched in any output format
+ * @param usingUIDs Represents if the set contains UIDs, which are fetched by UID FETCH
+ * @return std::string Command without the tag
+ */
+std::string IMAPClient::getFetchArguments(std::string sequenceSet,
+                                          FetchOptions options,
+                                          bool usingFlags,
+                                          bool usingUIDs) {
+  // Maildir stores flags of emails in their file names and the header index stores them too
+  bool isFlagged = usingFlags || this->outputFormat == EmailWriter::Format::MAILDIR || this->isIndexing;
+  std::string flags = isFlagged ? "flags " : "";
+  return (usingUIDs ? "uid fetch " : "fetch ") + sequenceSet + " (uid " + flags + "body.peek[" +
+         (options == FetchOptions::ALL ? "" : "header") + "])";
+}
+
+/**
+ * @brief Get arguments of a FETCH command that fetches Message-IDs and sizes of emails
+ *
+ * @param sequenceSet Sequence set of emails
+ * @return std::string Command without the tag
+ */
+std::string IMAPClient::getMessageIdArguments(std::string sequenceSet) {
+  // Linked emails are added to the header index with their flags
+  std::string flags = this->isIndexing ? "flags " : "";
+  return "fetch " + sequenceSet + " (uid " + flags + "rfc822.size body.peek[header.fields (message-id)])";
+}
+
+/**
+ * @brief Link emails that are already in the store to their files using their Message-IDs and sizes
+ *
+ * @param sequenceSet Sequence set of the emails
+ * @param response FETCH response with Message-IDs and sizes of the emails
+ * @param directoryPath Path where emails are saved
+ * @param count Number of linked emails, which is increased
+ * @return std::string Sequence set of emails that are not in the store and must be downloaded
+ */
+std::string IMAPClient::linkStoredEmails(std::string sequenceSet,
+                                         std::string response,
+                                         std::string directoryPath,
+                                         std::size_t &count) {
+  std::shared_ptr<MessageStore> store = MessageStore::open(directoryPath);
+  std::shared_ptr<HeaderIndex> index = this->isIndexing ? HeaderIndex::open(directoryPath) : nullptr;
+  std::unordered_set<unsigned long> linkedNumbers;
+  std::size_t position = 0;
+
+  while (position < response.length()) {
+    std::size_t lineEnd = response.find("\r\n", position);
+    if (lineEnd == std::string::npos) {
+      break;
+    }
+    std::string line = response.substr(position, lineEnd - position);
+    position = lineEnd + 2;
+
+    // Skip the header fields, which follow the line as a literal
+    std::string messageId;
+    std::size_t literalStart = line.find_last_of('{');
+    if (literalStart != std::string::npos && line.ends_with("}")) {
+      std::size_t literalSize = std::stoul(line.substr(literalStart + 1));
+      messageId = MessageStore::getMessageId(std::string_view{response}.substr(position, literalSize));
+      position += literalSize;
+    }
+
+    std::string lowerCaseLine = this->toLowerCase(line);
+    std::size_t sizeStart = lowerCaseLine.find("rfc822.size ");
+    if (!line.starts_with("* ") || messageId.empty() || sizeStart == std::string::npos) {
+      continue;
+    }
+
+    std::size_t size = std::stoul(line.substr(sizeStart + 12));
+    std::string uid = EmailWriter::getEmailUID(line);
+    std::string filePath =
+        (std::filesystem::path{directoryPath} / EmailWriter::getFileName(this->hostname, this->mailbox, uid)).string();
+    if (!store->link(messageId, size, filePath)) {
+      continue;
+    }
+
+    linkedNumbers.insert(std::stoul(line.substr(2)));
+    if (index) {
+      index->add(this->hostname, this->mailbox, std::stoull(uid),
+                 HeaderIndex::parseFile(filePath, this->parseFlags(line)));
+    }
+  }
+
+  if (index) {
+    index->save();
+  }
+
+  // Download emails that were not linked
+  std::vector<unsigned long> numbers = this->parseSequenceSet(sequenceSet);
+  std::erase_if(numbers, [&linkedNumbers](unsigned long number) { return linkedNumbers.contains(number); });
+  count += linkedNumbers.size();
+
+  return this->toSequenceSet(numbers.cbegin(), numbers.cend());
+}
+
+/**
+ * @brief Parses a FETCH response into a map of emails
+ *
+ * @param fetchResponse FETCH response sent from the server
+ * @return std::unordered_map<std::string, std::string> Pairs, where the key is the UID of an email and the value is the
+ * contents of the email
+ */
+std::unordered_map<std::string, std::string> IMAPClient::parseEmails(std::string fetchResponse) {
+  std::unordered_map<std::string, std::string> emails;
+  unsigned long pointer = 0;  // Position in the fetch response
+  unsigned long lastRowStartIndex = fetchResponse.substr(0, fetchResponse.length() - 2).find_last_of("\r\n");
+
+  while (pointer < lastRowStartIndex) {
+    // Parse the first line of currently proccessed email
+    std::string firstLine = fetchResponse.substr(pointer, fetchResponse.substr(pointer).find_first_of("\r\n"));
+    std::string emailUID = EmailWriter::getEmailUID(firstLine);
+
+    // Parse the email size
+    unsigned long emailSizeStart = firstLine.find_first_of("{");
+    unsigned long emailSizeEnd = firstLine.find_first_of("}");
+    if (emailSizeStart == std::string::npos || emailSizeEnd == std::string::npos) {
+      throw std::runtime_error("Invalid fetch response format.");
     }
+    int emailSize = std::stoi(firstLine.substr(emailSizeStart + 1, emailSizeEnd - emailSizeStart - 1));
+
+    // Parse the email content
+    std::string email = fetchResponse.substr(pointer + emailSizeEnd + 3, emailSize);
+    std::string fileName = EmailWriter::getFileName(this->hostname, this->mailbox, emailUID);
+    emails.insert({fileName, email});
+
+    pointer += emailSizeEnd + 3 + emailSize + 3;
+  }
+
+  return emails;
+}
+
+/**
+ * @brief Get UIDs and flags of all emails in selected mailbox by sending a FETCH command to the server
+ *
+ * @param flags Receives flags of emails, where the key is the UID of an email
+ * @return std::vector<unsigned long> UIDs of emails, where the index is the sequence number minus one
+ */
+std::vector<unsigned long> IMAPClient::fetchUIDs(std::map<unsigned long, std::string> &flags) {
+  if (this->isMailboxEmpty) {
+    return {};
+  }
+
+  // Send FETCH command to server
+  std::string command = std::to_string(this->tag) + " fetch 1:* (uid flags)\r\n";
+  std::string response = this->connection->sendCommand(this->tag, command);
+
+  // Verify that fetching UIDs was successful
+  if (this->toLowerCase(response).find(std::to_string(this->tag) + " ok") == std::string::npos) {
+    throw std::runtime_error("Could not fetch email UIDs.");
   }
 
   this->tag++;
+  return this->parseFetchedUIDs(response, flags);
+}
+
+/**
+ * @brief Parse a FETCH (UID FLAGS) response into UIDs and flags of emails
+ *
+ * @param response Response from the server
+ * @param flags Receives flags of emails, where the key is the UID of an email
+ * @return std::vector<unsigned long> UIDs of emails, where the index is the sequence number minus one
+ */
+std::vector<unsigned long> IMAPClient::parseFetchedUIDs(std::string response,
+                                                       std::map<unsigned long, std::string> &flags) {
+  std::string lowerCaseResponse = this->toLowerCase(response);
+
+  // Parse lines in format "* 1 FETCH (UID 42 FLAGS (\Seen))"
+  std::vector<unsigned long> uids(this->emailCount, 0);
+  std::size_t lineStart = 0;
+  while (lineStart < response.length()) {
+    std::size_t lineEnd = response.find("\r\n", lineStart);
+    if (lineEnd == std::string::npos) {
+      lineEnd = response.length();
+    }
+
+    std::string line = lowerCaseResponse.substr(lineStart, lineEnd - lineStart);
+    std::size_t uidStart = line.find("uid ");
+    if (line.starts_with("* ") && uidStart != std::string::npos) {
+      unsigned long number = std::stoul(line.substr(2));
+      if (number >= 1 && number <= uids.size()) {
+        uids[number - 1] = std::stoul(line.substr(uidStart + 4));
+        flags[uids[number - 1]] = this->parseFlags(response.substr(lineStart, lineEnd - lineStart));
+      }
+    }
+
+    lineStart = lineEnd + 2;
+  }
+
+  return uids;
+}
+
+/**
+ * @brief Get UIDs of emails that are new by sending a SEARCH command to the server
+ *
+ * @return std::string Sequence set representing UIDs of new emails
+ */
+std::string IMAPClient::getNewEmailUIDs() {
+  // User must be logged in
+  if (!this->isLoggedIn) {
+    throw std::runtime_error("User must be logged in before fetching emails.");
+  }
+
+  return this->receiveNewEmailUIDs(this->submitSearchNew());
+}
+
+/**
+ * @brief Send a SEARCH command for new emails to the server without waiting for its response
+ *
+ * @return unsigned int Tag of the sent command
+ */
+unsigned int IMAPClient::submitSearchNew() {
+  // Send SEARCH command to server
+  std::string command = std::to_string(this->tag) + " search new\r\n";
+  this->connection->submitCommand(this->tag, command);
+
+  return this->tag++;
+}
+
+/**
+ * @brief Receive the response of a SEARCH command for new emails
+ *
+ * @param searchTag Tag of the sent SEARCH command
+ * @return std::string Sequence set representing UIDs of new emails
+ */
+std::string IMAPClient::receiveNewEmailUIDs(unsigned int searchTag) {
+  std::string response = this->connection->readResponse(searchTag);
+
+  // Verify that searching emails was successful
+  if (this->toLowerCase(response).find(std::to_string(searchTag) + " ok") == std::string::npos) {
+    throw std::runtime_error("Could not search emails.");
+  }
+
+  return this->parseSearchResponse(response);
+}
+
+/**
+ * @brief Parse a SEARCH response into a sequence set
+ *
+ * @param response SEARCH response sent from the server
+ * @return std::string Sequence set representing found emails
+ */
+std::string IMAPClient::parseSearchResponse(std::string response) {
+  // Parse the response
+  std::string firstLine = response.substr(0, response.find_first_of("\r\n"));
+  if (firstLine.length() == 8) {
+    return "";
+  }
+  std::string uids = response.substr(9, response.find_first_of("\r\n") - 9);
+
+  // Replace all spaces with commas to create a valid sequence set
+  for (char &character : uids) {
+    if (character == ' ') {
+      character = ',';
+    }
+  }
+
   return uids;
 }
 
+/**
+ * @brief Mark emails as seen by sending a STORE command to the server
+ *
+ * @param uids Sequence set representing UIDs of emails
+ */
+void IMAPClient::markAsSeen(std::string uids) {
+  if (uids.empty()) {
+    return;
+  }
+
+  // Send STORE command to server
+  std::string command = std::to_string(this->tag) + " store " + uids + " +flags.silent (\\seen)\r\n";
+  std::string response = this->connection->sendCommand(this->tag, command);
+
+  // Verify that storing flags was successful
+  if (this->toLowerCase(response).find(std::to_string(this->tag) + " ok") == std::string::npos) {
+    throw std::runtime_error("Could not store flags.");
+  }
+
+  this->tag++;
+}
+
+/**
+ * @brief Parse changes reported in a SELECT response with QRESYNC parameters
+ *
+ * @param response Response from the server with lines in format "* VANISHED (EARLIER) 3:5" and
+ * "* 1 FETCH (UID 42 FLAGS (\Seen) MODSEQ (7))"
+ * @param state State of the last synchronization, whose UIDs are looked up in vanished ranges
+ */
+void IMAPClient::parseResyncResponse(std::string response, const SyncState &state) {
+  std::string lowerCaseResponse = this->toLowerCase(response);
+  std::size_t lineStart = 0;
+
+  while (lineStart < response.length()) {
+    std::size_t lineEnd = response.find("\r\n", lineStart);
+    if (lineEnd == std::string::npos) {
+      lineEnd = response.length();
+    }
+
+    std::string line = lowerCaseResponse.substr(lineStart, lineEnd - lineStart);
+    std::size_t uidStart = line.find("uid ");
+    if (line.starts_with("* vanished (earlier) ")) {
+      // Ranges can span billions of UIDs, so only the stored UIDs inside them are kept
+      for (auto [first, last] : this->parseSequenceRanges(line.substr(21))) {
+        auto end = state.uids.upper_bound(last);
+        for (auto uid = state.uids.lower_bound(first); uid != end; uid++) {
+          this->vanishedUIDs.insert(*uid);
+        }
+      }
+    } else if (line.starts_with("* ") && line.find(" fetch (") != std::string::npos && uidStart != std::string::npos) {
+      this->changedEmails.push_back({std::stoul(line.substr(2)), std::stoul(line.substr(uidStart + 4)),
+                                     this->parseFlags(response.substr(lineStart, lineEnd - lineStart))});
+    }
+
+    lineStart = lineEnd + 2;
+  }
+}
+
+/**
+ * @brief Parse untagged responses received while idling
+ *
+ * @param response Response from the server with lines in format "* 5 EXISTS" or "* 3 EXPUNGE"
+ */
+void IMAPClient::parseIdleResponse(std::string response) {
+  std::string lowerCaseResponse = this->toLowerCase(response);
+  std::size_t lineStart = 0;
+
+  while (lineStart < lowerCaseResponse.length()) {
+    std::size_t lineEnd = lowerCaseResponse.find("\r\n", lineStart);
+    if (lineEnd == std::string::npos) {
+      lineEnd = lowerCaseResponse.length();
+    }
+
+    std::string line = lowerCaseResponse.substr(lineStart, lineEnd - lineStart);
+    if (line.starts_with("* bye")) {
+      throw std::runtime_error("Server closed the connection.");
+    } else if (line.starts_with("* ") && line.ends_with(" exists")) {
+      this->emailCount = std::stoul(line.substr(2));
+      this->isMailboxEmpty = this->emailCount == 0;
+      this->isMailboxChanged = true;
+    } else if (line.starts_with("* ") && line.ends_with(" expunge")) {
+      this->emailCount -= std::min(this->emailCount, 1ul);
+      this->isMailboxEmpty = this->emailCount == 0;
+      this->isMailboxChanged = true;
+    } else if (line.starts_with("* vanished ")) {
+      this->isMailboxChanged = true;
+    }
+
+    lineStart = lineEnd + 2;
+  }
+}
+
+/**
+ * @brief Get the flags from a line of a FETCH response
+ *
+ * @param line Line in format "* 1 FETCH (FLAGS (\Seen \Flagged))"
+ * @return std::string Flags separated by spaces, e.g. "\Seen \Flagged"
+ */
+std::string IMAPClient::parseFlags(std::string line) {
+  std::size_t flagsStart = this->toLowerCase(line).find("flags (");
+  if (flagsStart == std::string::npos) {
+    return "";
+  }
+
+  flagsStart += 7;
+  return line.substr(flagsStart, line.find(')', flagsStart) - flagsStart);
+}
+
+/**
+ * @brief Get the value of a numeric response code, e.g. "[UIDNEXT 42]"
+ *
+ * @param response Response from the server
+ * @param code Name of the response code in lower case
+ * @return unsigned long Value of the response code, 0 if the response does not contain it
+ */
+unsigned long IMAPClient::parseResponseCode(std::string response, std::string code) {
+  std::size_t codeStart = this->toLowerCase(response).find("[" + code + " ");
+  if (codeStart == std::string::npos) {
+    return 0;
+  }
+
+  return std::stoul(response.substr(codeStart + code.length() + 2));
+}
+
 /**
  * @brief Convert a string to lower case
  *
@@ -334,3 +1994,25 @@ std::string IMAPClient::toLowerCase(std::string input) {
 
   return output;
 }
+
+/**
+ * @brief Convert a mailbox name to a quoted string if it contains characters that are not allowed in an atom
+ *
+ * @param input Mailbox name
+ * @return std::string Mailbox name that can be sent to the server
+ */
+std::string IMAPClient::quote(std::string input) {
+  if (!input.empty() && input.find_first_of(" \"\\(){%*") == std::string::npos) {
+    return input;
+  }
+
+  std::string output = "\"";
+  for (char character : input) {
+    if (character == '"' || character == '\\') {
+      output += '\\';
+    }
+    output += character;
+  }
+
+  return output + "\"";
+}
@@ -9,16 +9,45 @@
 #define IMAP_CLIENT_H
 
 #include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <exception>
+#include <filesystem>
 #include <memory>
+#include <set>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "connection.h"
+#include "email_writer.h"
+#include "fetched_emails.h"
+#include "header_index.h"
+#include "indexing_writer.h"
+#include "message_store.h"
+#include "partial_download.h"
+#include "recording_connection.h"
+#include "replay_connection.h"
+#include "sync_state.h"
 #include "ssl_connection.h"
 #include "tcp_connection.h"
 
+/**
+ * @brief Represents how emails are split into multiple FETCH commands
+ */
+struct BatchOptions {
+  /// @brief Maximum number of emails fetched by one command, 0 means unlimited
+  unsigned long emailCount{0};
+  /// @brief Maximum total size of emails fetched by one command in bytes, 0 means unlimited
+  std::size_t byteCount{0};
+  /// @brief Maximum number of FETCH commands sent to the server before their responses are received
+  unsigned int window{1};
+};
+
 /**
  * @brief Represents a imap client
  */
@@ -27,48 +56,226 @@ class IMAPClient {
   /// @brief Represent whether to fetch only headers or the full contents of an email
   enum class FetchOptions { ALL, HEADERS };
 
+  /// @brief Represents an email that was added or whose flags changed since the last synchronization
+  struct ChangedEmail {
+    /// @brief Sequence number of the email
+    unsigned long sequenceNumber;
+    /// @brief UID of the email
+    unsigned long uid;
+    /// @brief Flags of the email
+    std::string flags;
+  };
+
  protected:
   /// @brief Connection to an imap server
   std::unique_ptr<Connection> connection;
   /// @brief Imap server hostname
   std::string hostname;
+  /// @brief Imap server port
+  uint16_t port;
   /// @brief Path to a certificate file used for validating ssl/tls certificate
   std::string certificateFile;
   /// @brief Path to a folder which is used for validating ssl/tls certificates
   std::string certificatesFolderPath;
   /// @brief Indicates whether using TLS
   bool usingSecure;
+  /// @brief Indicates whether TLS was started by the STARTTLS command
+  bool usingStartTls{false};
+  /// @brief Minimum number of bytes requested from the socket by a single read
+  std::size_t readSize{ReceiveBuffer::DEFAULT_READ_SIZE};
 
   /// @brief Represents if the user is logged in
   bool isLoggedIn{false};
+  /// @brief Username of the logged in user
+  std::string username;
+  /// @brief Password of the logged in user
+  std::string password;
   /// @brief Tag used in commands that are sent to the server
   unsigned int tag{0};
+  /// @brief Capabilities of the server in lower case
+  std::unordered_set<std::string> capabilities;
+  /// @brief Represents if the QRESYNC extension was enabled
+  bool isQresyncEnabled{false};
+  /// @brief Represents if the COMPRESS=DEFLATE extension is used after login when the server supports it
+  bool isCompressionAllowed{true};
+  /// @brief Represents if the connection is compressed
+  bool isCompressed{false};
+  /// @brief Format in which emails are stored in the output directory
+  EmailWriter::Format outputFormat{EmailWriter::Format::FILES};
+  /// @brief Represents if received emails are written in the background while next emails are received
+  bool isWritingAsync{false};
+  /// @brief Represents if headers of saved emails are added to the header index of the output directory
+  bool isIndexing{false};
+  /// @brief Emails larger than this are fetched in ranges of this size in bytes, 0 fetches every email at once
+  std::size_t partialSize{0};
 
   /// @brief Selected mailbox
   std::string mailbox{"inbox"};
   /// @brief Represents if the selected mailbox is empty
   bool isMailboxEmpty{true};
+  /// @brief Number of emails in the selected mailbox
+  unsigned long emailCount{0};
+  /// @brief UIDVALIDITY of the selected mailbox
+  unsigned long uidValidity{0};
+  /// @brief UIDNEXT of the selected mailbox
+  unsigned long uidNext{0};
+  /// @brief HIGHESTMODSEQ of the selected mailbox, 0 if the server does not support CONDSTORE
+  unsigned long highestModSeq{0};
+  /// @brief Represents if the mailbox was selected with QRESYNC parameters that match its UIDVALIDITY
+  bool isResynchronized{false};
+  /// @brief UIDs of stored emails removed since the last synchronization, reported by QRESYNC
+  std::set<unsigned long> vanishedUIDs;
+  /// @brief Emails added or changed since the last synchronization, reported by QRESYNC
+  std::vector<ChangedEmail> changedEmails;
+
+  /// @brief Tag of the running IDLE command, 0 if the client is not idling
+  unsigned int idleTag{0};
+  /// @brief Represents if the server reported added or removed emails that were not handled yet
+  bool isMailboxChanged{false};
 
  public:
   IMAPClient(std::string hostname, uint16_t port);
   IMAPClient(std::string hostname, uint16_t port, std::string certificateFile, std::string certificatesFolderPath);
-  ~IMAPClient();
+  virtual ~IMAPClient();
+
+  static std::unique_ptr<IMAPClient> record(std::string tracePath, std::string hostname, uint16_t port);
+  static std::unique_ptr<IMAPClient> record(std::string tracePath,
+                                            std::string hostname,
+                                            uint16_t port,
+                                            std::string certificateFile,
+                                            std::string certificatesFolderPath);
+  static std::unique_ptr<IMAPClient> replay(std::string tracePath,
+                                            std::string hostname,
+                                            uint16_t port,
+                                            bool usingDelays = false);
 
   void login(std::string username, std::string password);
   void logout();
 
   bool startTls();
+  bool hasCapability(std::string capability);
+  bool enableQresync();
+  bool startCompression();
+  void setCompression(bool isCompressionAllowed);
+  void setOutputFormat(EmailWriter::Format outputFormat);
+  void setAsyncWrites(bool isWritingAsync);
+  void setIndexing(bool isIndexing);
+  void setPartialSize(std::size_t partialSize);
 
-  void select(std::string mailbox);
-  std::unordered_map<std::string, std::string> fetch(FetchOptions options);
-  std::unordered_map<std::string, std::string> fetchNew(FetchOptions options);
+  std::vector<std::string> list();
+  void select(std::string mailbox, const SyncState *state = nullptr);
+  std::unordered_map<std::string, std::string> fetch(FetchOptions options, BatchOptions batch = {});
+  std::unordered_map<std::string, std::string> fetchNew(FetchOptions options, BatchOptions batch = {});
+  FetchedEmails fetchViews(FetchOptions options, BatchOptions batch = {});
+  FetchedEmails fetchNewViews(FetchOptions options, BatchOptions batch = {});
+  std::size_t download(FetchOptions options,
+                       std::string directoryPath,
+                       BatchOptions batch = {},
+                       unsigned int connectionCount = 1);
+  std::size_t downloadNew(FetchOptions options,
+                          std::string directoryPath,
+                          BatchOptions batch = {},
+                          unsigned int connectionCount = 1);
+  std::size_t sync(FetchOptions options,
+                   std::string directoryPath,
+                   SyncState &state,
+                   BatchOptions batch = {},
+                   unsigned int connectionCount = 1);
   void read();
 
+  void startIdle();
+  bool readIdle();
+  void stopIdle();
+  bool hasPendingData();
+  int getFd();
+
+  unsigned long getUidValidity();
+
+  std::unique_ptr<IMAPClient> openSession();
+  void setReadSize(std::size_t readSize);
+
  protected:
+  IMAPClient(std::unique_ptr<Connection> connection, std::string hostname, uint16_t port, bool usingSecure);
+
+  static std::unique_ptr<IMAPClient> greet(std::unique_ptr<Connection> connection,
+                                           std::string hostname,
+                                           uint16_t port,
+                                           bool usingSecure);
+
+  std::unique_ptr<EmailWriter> createWriter(std::string directoryPath, bool isDeleting = false);
+  void updateIndex(std::string directoryPath, const SyncState &state);
+  void parseCapabilities(std::string response);
+  std::vector<std::string> parseMailboxes(std::string response);
+  void parseSelectResponse(std::string mailbox, std::string response, const SyncState *resyncState);
   std::unordered_map<std::string, std::string> parseEmails(std::string fetchResponse);
   std::string getNewEmailUIDs();
+  std::vector<unsigned long> fetchUIDs(std::map<unsigned long, std::string> &flags);
+  std::vector<unsigned long> parseFetchedUIDs(std::string response, std::map<unsigned long, std::string> &flags);
+  std::string reconcileState(const std::vector<unsigned long> &uids, std::string directoryPath, const SyncState &state);
+  void updateState(SyncState &state,
+                   const std::vector<unsigned long> &uids,
+                   std::map<unsigned long, std::string> flags);
+  std::size_t resync(FetchOptions options,
+                     std::string directoryPath,
+                     SyncState &state,
+                     BatchOptions batch,
+                     unsigned int connectionCount);
+  void parseResyncResponse(std::string response, const SyncState &state);
+  void parseIdleResponse(std::string response);
+  unsigned int submitSearchNew();
+  std::string receiveNewEmailUIDs(unsigned int searchTag);
+  std::string parseSearchResponse(std::string response);
+  void markAsSeen(std::string uids);
+  std::vector<std::string> sendFetch(std::vector<std::string> sequenceSets,
+                                     FetchOptions options,
+                                     unsigned int window,
+                                     LiteralSink *sink,
+                                     bool usingFlags = false,
+                                     bool usingUIDs = false);
+
+  std::size_t downloadSequenceSet(std::string sequenceSet,
+                                  FetchOptions options,
+                                  std::string directoryPath,
+                                  BatchOptions batch,
+                                  unsigned int connectionCount,
+                                  const std::vector<unsigned long> *uids = nullptr);
+  std::size_t downloadParts(std::string sequenceSet,
+                            FetchOptions options,
+                            std::string directoryPath,
+                            BatchOptions batch,
+                            unsigned int connectionCount,
+                            const std::vector<unsigned long> *uids = nullptr);
+  std::size_t downloadUIDs(std::string uidSet, FetchOptions options, std::string directoryPath, BatchOptions batch);
+
+  std::string getFetchArguments(std::string sequenceSet,
+                                FetchOptions options,
+                                bool usingFlags = false,
+                                bool usingUIDs = false);
+  std::string getMessageIdArguments(std::string sequenceSet);
+  std::string linkStoredEmails(std::string sequenceSet,
+                               std::string response,
+                               std::string directoryPath,
+                               std::size_t &count);
+  std::string splitLargeEmails(std::string sequenceSet,
+                               std::string response,
+                               std::vector<std::pair<unsigned long, std::size_t>> &largeEmails);
+  std::size_t downloadLargeEmails(const std::vector<std::pair<unsigned long, std::size_t>> &largeEmails,
+                                  std::string directoryPath);
+  std::vector<std::string> getBatches(std::string sequenceSet, BatchOptions batch, bool usingUIDs = false);
+  std::vector<std::string> splitBatches(std::string sequenceSet,
+                                        std::unordered_map<unsigned long, std::size_t> sizes,
+                                        BatchOptions batch);
+  std::unordered_map<unsigned long, std::size_t> getEmailSizes(std::string sequenceSet, bool usingUIDs = false);
+  std::unordered_map<unsigned long, std::size_t> parseEmailSizes(std::string response, bool usingUIDs = false);
+  std::vector<unsigned long> parseSequenceSet(std::string sequenceSet);
+  std::vector<std::pair<unsigned long, unsigned long>> parseSequenceRanges(std::string sequenceSet);
+  std::string toSequenceSet(std::vector<unsigned long>::const_iterator begin,
+                            std::vector<unsigned long>::const_iterator end);
 
+  unsigned long parseResponseCode(std::string response, std::string code);
+  std::string parseFlags(std::string line);
   std::string toLowerCase(std::string input);
+  std::string quote(std::string input);
 };
 
 #endif
@@ -0,0 +1,112 @@
+/**
+ * IMAP client
+ *
+ * @file indexing_writer.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include "indexing_writer.h"
+
+/**
+ * @brief Construct a new indexing writer
+ *
+ * @param writer Writer which saves the emails
+ * @param directoryPath Path where to save emails, which contains the index
+ * @param hostname Imap server hostname
+ * @param mailbox Mailbox from where emails are fetched
+ */
+IndexingWriter::IndexingWriter(std::unique_ptr<EmailWriter> writer,
+                               std::string directoryPath,
+                               std::string hostname,
+                               std::string mailbox)
+    : EmailWriter{directoryPath, hostname, mailbox},
+      writer{std::move(writer)},
+      index{HeaderIndex::open(directoryPath)} {}
+
+/**
+ * @brief Pass the start of a literal to the writer and start collecting the header of the email
+ *
+ * @param line Line text which announces the literal, e.g. "* 1 FETCH (UID 7 FLAGS (\Seen) BODY[] {42}"
+ * @param size Size of the email in bytes
+ */
+void IndexingWriter::beginLiteral(std::string_view line, std::size_t size) {
+  this->writer->beginLiteral(line, size);
+
+  this->isWriting = EmailWriter::isEmailLiteral(line);
+  if (!this->isWriting) {
+    return;
+  }
+
+  // An email without a valid UID is written, but not indexed
+  std::string uid = EmailWriter::getEmailUID(line);
+  if (std::from_chars(uid.data(), uid.data() + uid.length(), this->uid).ec != std::errc{}) {
+    this->isWriting = false;
+    return;
+  }
+
+  std::string lowerCaseLine{line};
+  std::transform(lowerCaseLine.begin(), lowerCaseLine.end(), lowerCaseLine.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  std::size_t flagsStart = lowerCaseLine.find("flags (");
+  this->flags = flagsStart == std::string::npos
+                    ? ""
+                    : std::string{line.substr(flagsStart + 7, line.find(')', flagsStart) - flagsStart - 7)};
+
+  this->size = size;
+  this->header.clear();
+}
+
+/**
+ * @brief Pass a part of the email to the writer and keep it if it belongs to the header
+ *
+ * @param data Part of the email
+ * @param size Size of the part
+ */
+void IndexingWriter::writeLiteral(const char *data, std::size_t size) {
+  this->writer->writeLiteral(data, size);
+
+  if (this->isWriting && this->header.length() < HeaderIndex::MAX_HEADER_SIZE &&
+      this->header.find("\r\n\r\n") == std::string::npos) {
+    this->header.append(data, std::min(size, HeaderIndex::MAX_HEADER_SIZE - this->header.length()));
+  }
+}
+
+/**
+ * @brief Pass the end of the literal to the writer and add the email to the index
+ */
+void IndexingWriter::endLiteral() {
+  this->writer->endLiteral();
+  this->count = this->writer->getCount();
+
+  if (!this->isWriting) {
+    return;
+  }
+
+  this->isWriting = false;
+  this->index->add(this->hostname, this->mailbox, this->uid,
+                   HeaderIndex::parseHeader(this->header, this->size, this->flags));
+}
+
+/**
+ * @brief Flush the writer and save the index
+ */
+void IndexingWriter::flush() {
+  this->writer->flush();
+  this->index->save();
+}
+
+/**
+ * @brief Delete the file of an email, its entry is removed when the index is updated after the synchronization
+ *
+ * @param uid UID of the email
+ */
+void IndexingWriter::deleteEmail(std::string uid) {
+  this->writer->deleteEmail(uid);
+}
+
+/**
+ * @brief Delete files of all emails from the mailbox
+ */
+void IndexingWriter::deleteAll() {
+  this->writer->deleteAll();
+}
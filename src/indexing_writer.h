@@ -0,0 +1,54 @@
+/**
+ * IMAP client
+ *
+ * @file indexing_writer.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef INDEXING_WRITER_H
+#define INDEXING_WRITER_H
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "email_writer.h"
+#include "header_index.h"
+
+/**
+ * @brief Passes emails to another writer and adds their headers to the header index of the output directory
+ */
+class IndexingWriter : public EmailWriter {
+ protected:
+  /// @brief Writer which saves the emails
+  std::unique_ptr<EmailWriter> writer;
+  /// @brief Index shared by all writers of the output directory
+  std::shared_ptr<HeaderIndex> index;
+  /// @brief UID of the email that is currently being written
+  std::uint64_t uid{0};
+  /// @brief Flags of the email that is currently being written
+  std::string flags;
+  /// @brief Size of the email that is currently being written
+  std::size_t size{0};
+  /// @brief Start of the email that is currently being written, which contains its header
+  std::string header;
+
+ public:
+  IndexingWriter(std::unique_ptr<EmailWriter> writer,
+                 std::string directoryPath,
+                 std::string hostname,
+                 std::string mailbox);
+
+  void beginLiteral(std::string_view line, std::size_t size) override;
+  void writeLiteral(const char *data, std::size_t size) override;
+  void endLiteral() override;
+
+  void flush() override;
+  void deleteEmail(std::string uid) override;
+  void deleteAll() override;
+};
+
+#endif
@@ -0,0 +1,302 @@
+/**
+ * IMAP client
+ *
+ * @file io_uring_disk_writer.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include "io_uring_disk_writer.h"
+
+/**
+ * @brief Construct a new IOUringDiskWriter object
+ *
+ * Throws an exception if the kernel does not support io_uring or its file operations.
+ *
+ * @param queueDepth Maximum number of files that are written at once
+ */
+IOUringDiskWriter::IOUringDiskWriter(std::size_t queueDepth) : queueDepth{queueDepth} {
+  io_uring_params params{};
+  this->ringFd = syscall(__NR_io_uring_setup, queueDepth, &params);
+  if (this->ringFd < 0) {
+    throw std::runtime_error("Could not create io_uring.");
+  }
+
+  try {
+    // Map both queue rings, older kernels need two mappings
+    this->submissionRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    this->completionRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      this->submissionRingSize = std::max(this->submissionRingSize, this->completionRingSize);
+    }
+
+    this->submissionRing = mmap(nullptr, this->submissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                this->ringFd, IORING_OFF_SQ_RING);
+    if (this->submissionRing == MAP_FAILED) {
+      this->submissionRing = nullptr;
+      throw std::runtime_error("Could not map io_uring.");
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      this->completionRing = this->submissionRing;
+    } else {
+      this->completionRing = mmap(nullptr, this->completionRingSize, PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_POPULATE, this->ringFd, IORING_OFF_CQ_RING);
+      if (this->completionRing == MAP_FAILED) {
+        this->completionRing = nullptr;
+        throw std::runtime_error("Could not map io_uring.");
+      }
+    }
+
+    this->entryCount = params.sq_entries;
+    void *entries = mmap(nullptr, this->entryCount * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, this->ringFd, IORING_OFF_SQES);
+    if (entries == MAP_FAILED) {
+      throw std::runtime_error("Could not map io_uring.");
+    }
+    this->entries = static_cast<io_uring_sqe *>(entries);
+
+    char *submissionRing = static_cast<char *>(this->submissionRing);
+    this->submissionTail = reinterpret_cast<unsigned int *>(submissionRing + params.sq_off.tail);
+    this->submissionMask = *reinterpret_cast<unsigned int *>(submissionRing + params.sq_off.ring_mask);
+    this->submissionArray = reinterpret_cast<unsigned int *>(submissionRing + params.sq_off.array);
+
+    char *completionRing = static_cast<char *>(this->completionRing);
+    this->completionHead = reinterpret_cast<unsigned int *>(completionRing + params.cq_off.head);
+    this->completionTail = reinterpret_cast<unsigned int *>(completionRing + params.cq_off.tail);
+    this->completionMask = *reinterpret_cast<unsigned int *>(completionRing + params.cq_off.ring_mask);
+    this->completions = reinterpret_cast<io_uring_cqe *>(completionRing + params.cq_off.cqes);
+
+    this->checkSupport();
+  } catch (...) {
+    this->release();
+    throw;
+  }
+}
+
+/**
+ * @brief Destroy the IOUringDiskWriter object after submitted files are written
+ */
+IOUringDiskWriter::~IOUringDiskWriter() {
+  try {
+    while (!this->requests.empty()) {
+      this->enter(1);
+      this->reap();
+    }
+  } catch (const std::exception &) {
+    // The kernel finishes operations of a closed ring, only their results are lost
+  }
+
+  this->release();
+}
+
+/**
+ * @brief Start writing a file, waits while QUEUE_DEPTH files are being written
+ *
+ * @param path Path of the file
+ * @param data Contents of the file
+ */
+void IOUringDiskWriter::submit(std::string path, std::string data) {
+  while (this->requests.size() >= this->queueDepth) {
+    this->enter(1);
+    this->reap();
+  }
+
+  std::uint64_t id = this->nextRequestId++;
+  Request &request = this->requests[id];
+  request.path = std::move(path);
+  request.data = std::move(data);
+  this->prepare(id, request);
+
+  // Operations that complete right away let the next operations of their files start without waiting
+  while (this->unsubmittedCount > 0) {
+    this->enter(0);
+    this->reap();
+  }
+}
+
+/**
+ * @brief Wait until all submitted files are written
+ */
+void IOUringDiskWriter::wait() {
+  while (!this->requests.empty()) {
+    this->enter(1);
+    this->reap();
+  }
+
+  // The failure is kept, so files submitted before it are never treated as written
+  if (!this->failedPath.empty()) {
+    throw std::runtime_error("Could not write email to file " + this->failedPath + ".");
+  }
+}
+
+/**
+ * @brief Check if the kernel supports the operations used for writing files
+ */
+void IOUringDiskWriter::checkSupport() {
+  // Probe with room for all operations, which is allocated as 64-bit words for alignment
+  const unsigned int operationCount = 256;
+  std::size_t size = sizeof(io_uring_probe) + operationCount * sizeof(io_uring_probe_op);
+  std::unique_ptr<std::uint64_t[]> memory = std::make_unique<std::uint64_t[]>((size + 7) / 8);
+  io_uring_probe *probe = reinterpret_cast<io_uring_probe *>(memory.get());
+
+  if (syscall(__NR_io_uring_register, this->ringFd, IORING_REGISTER_PROBE, probe, operationCount) < 0) {
+    throw std::runtime_error("Could not probe io_uring operations.");
+  }
+
+  for (unsigned int operation : {IORING_OP_OPENAT, IORING_OP_WRITE, IORING_OP_CLOSE}) {
+    if (operation > probe->last_op || !(probe->ops[operation].flags & IO_URING_OP_SUPPORTED)) {
+      throw std::runtime_error("Io_uring does not support file operations.");
+    }
+  }
+}
+
+/**
+ * @brief Add the operation of the current stage of a file to the submission queue
+ *
+ * Every file has at most one operation in the queue, so the queue can not overflow.
+ *
+ * @param id Identifier of the file
+ * @param request File that is being written
+ */
+void IOUringDiskWriter::prepare(std::uint64_t id, Request &request) {
+  unsigned int tail = *this->submissionTail;
+  unsigned int index = tail & this->submissionMask;
+  io_uring_sqe &entry = this->entries[index];
+
+  std::memset(&entry, 0, sizeof(entry));
+  entry.user_data = id;
+  switch (request.stage) {
+    case Stage::OPEN:
+      entry.opcode = IORING_OP_OPENAT;
+      entry.fd = AT_FDCWD;
+      entry.addr = reinterpret_cast<std::uintptr_t>(request.path.c_str());
+      entry.len = 0666;
+      entry.open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+      break;
+    case Stage::WRITE:
+      entry.opcode = IORING_OP_WRITE;
+      entry.fd = request.fd;
+      entry.addr = reinterpret_cast<std::uintptr_t>(request.data.data() + request.offset);
+      entry.len = std::min<std::size_t>(request.data.size() - request.offset, 1 << 30);
+      entry.off = request.offset;
+      break;
+    case Stage::CLOSE:
+      entry.opcode = IORING_OP_CLOSE;
+      entry.fd = request.fd;
+      break;
+  }
+
+  this->submissionArray[index] = index;
+  std::atomic_ref<unsigned int>{*this->submissionTail}.store(tail + 1, std::memory_order_release);
+  this->unsubmittedCount++;
+}
+
+/**
+ * @brief Submit queued operations to the kernel
+ *
+ * @param minimumCompletions Number of completions to wait for
+ */
+void IOUringDiskWriter::enter(unsigned int minimumCompletions) {
+  unsigned int flags = minimumCompletions > 0 ? IORING_ENTER_GETEVENTS : 0;
+  while (true) {
+    int result = syscall(__NR_io_uring_enter, this->ringFd, this->unsubmittedCount, minimumCompletions, flags,
+                         nullptr, 0);
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (result < 0) {
+      throw std::runtime_error("Could not submit disk writes.");
+    }
+
+    this->unsubmittedCount -= result;
+    return;
+  }
+}
+
+/**
+ * @brief Advance a file to its next operation after the previous one completed
+ *
+ * @param id Identifier of the file
+ * @param result Result of the completed operation
+ */
+void IOUringDiskWriter::complete(std::uint64_t id, int result) {
+  Request &request = this->requests.at(id);
+  switch (request.stage) {
+    case Stage::OPEN:
+      if (result < 0) {
+        request.isFailed = true;
+        break;
+      }
+
+      request.fd = result;
+      request.stage = request.data.empty() ? Stage::CLOSE : Stage::WRITE;
+      this->prepare(id, request);
+      return;
+    case Stage::WRITE:
+      if (result == -EINTR || result == -EAGAIN) {
+        this->prepare(id, request);
+        return;
+      }
+
+      // The file is closed even if it could not be written
+      if (result <= 0) {
+        request.isFailed = true;
+      } else {
+        request.offset += result;
+      }
+
+      if (request.isFailed || request.offset == request.data.size()) {
+        request.stage = Stage::CLOSE;
+      }
+      this->prepare(id, request);
+      return;
+    case Stage::CLOSE:
+      if (result < 0) {
+        request.isFailed = true;
+      }
+      break;
+  }
+
+  if (request.isFailed && this->failedPath.empty()) {
+    this->failedPath = request.path;
+  }
+  this->requests.erase(id);
+}
+
+/**
+ * @brief Handle all operations that completed
+ */
+void IOUringDiskWriter::reap() {
+  unsigned int head = *this->completionHead;
+  unsigned int tail = std::atomic_ref<unsigned int>{*this->completionTail}.load(std::memory_order_acquire);
+
+  while (head != tail) {
+    const io_uring_cqe &completion = this->completions[head & this->completionMask];
+    this->complete(completion.user_data, completion.res);
+    head++;
+  }
+
+  std::atomic_ref<unsigned int>{*this->completionHead}.store(head, std::memory_order_release);
+}
+
+/**
+ * @brief Unmap the rings and close the io_uring file descriptor
+ */
+void IOUringDiskWriter::release() {
+  if (this->entries) {
+    munmap(this->entries, this->entryCount * sizeof(io_uring_sqe));
+  }
+
+  if (this->completionRing && this->completionRing != this->submissionRing) {
+    munmap(this->completionRing, this->completionRingSize);
+  }
+
+  if (this->submissionRing) {
+    munmap(this->submissionRing, this->submissionRingSize);
+  }
+
+  if (this->ringFd >= 0) {
+    close(this->ringFd);
+  }
+}
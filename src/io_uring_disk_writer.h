@@ -0,0 +1,121 @@
+/**
+ * IMAP client
+ *
+ * @file io_uring_disk_writer.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef IO_URING_DISK_WRITER_H
+#define IO_URING_DISK_WRITER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "disk_writer.h"
+
+/**
+ * @brief Writes files using io_uring, so the kernel creates, writes and closes them without blocking the thread
+ *
+ * Every file goes through the OPENAT, WRITE and CLOSE operations, the next one is submitted when the previous one
+ * completes. Completions are collected whenever a file is submitted, so no extra thread is needed. The ring is used
+ * through raw system calls, so liburing is not required.
+ */
+class IOUringDiskWriter : public DiskWriter {
+ protected:
+  /**
+   * @brief Operation of a file that is being written
+   */
+  enum class Stage { OPEN, WRITE, CLOSE };
+
+  /**
+   * @brief File that is being written
+   */
+  struct Request {
+    /// @brief Path of the file
+    std::string path;
+    /// @brief Contents of the file
+    std::string data;
+    /// @brief Number of bytes that were written
+    std::size_t offset{0};
+    /// @brief File descriptor of the opened file
+    int fd{-1};
+    /// @brief Operation that was submitted last
+    Stage stage{Stage::OPEN};
+    /// @brief Represents if the file could not be written
+    bool isFailed{false};
+  };
+
+  /// @brief Io_uring file descriptor
+  int ringFd{-1};
+  /// @brief Mapped submission queue ring
+  void *submissionRing{nullptr};
+  /// @brief Size of the mapped submission queue ring
+  std::size_t submissionRingSize{0};
+  /// @brief Mapped completion queue ring, which is the submission queue ring if the kernel maps them together
+  void *completionRing{nullptr};
+  /// @brief Size of the mapped completion queue ring
+  std::size_t completionRingSize{0};
+  /// @brief Mapped submission queue entries
+  io_uring_sqe *entries{nullptr};
+  /// @brief Number of submission queue entries
+  unsigned int entryCount{0};
+
+  /// @brief Submission queue tail, which is written by this thread
+  unsigned int *submissionTail{nullptr};
+  /// @brief Submission queue index mask
+  unsigned int submissionMask{0};
+  /// @brief Submission queue array of entry indexes
+  unsigned int *submissionArray{nullptr};
+  /// @brief Completion queue head, which is written by this thread
+  unsigned int *completionHead{nullptr};
+  /// @brief Completion queue tail, which is written by the kernel
+  unsigned int *completionTail{nullptr};
+  /// @brief Completion queue index mask
+  unsigned int completionMask{0};
+  /// @brief Completion queue entries
+  io_uring_cqe *completions{nullptr};
+
+  /// @brief Number of entries added to the submission queue, but not submitted to the kernel yet
+  unsigned int unsubmittedCount{0};
+  /// @brief Files that are being written by their identifier, which is the user data of their operations
+  std::unordered_map<std::uint64_t, Request> requests;
+  /// @brief Identifier of the next file
+  std::uint64_t nextRequestId{0};
+  /// @brief Maximum number of files that are written at once
+  std::size_t queueDepth;
+  /// @brief Path of the first file that could not be written, empty if all files were written
+  std::string failedPath;
+
+ public:
+  explicit IOUringDiskWriter(std::size_t queueDepth);
+  ~IOUringDiskWriter() override;
+
+  IOUringDiskWriter(const IOUringDiskWriter &) = delete;
+  IOUringDiskWriter &operator=(const IOUringDiskWriter &) = delete;
+
+  void submit(std::string path, std::string data) override;
+  void wait() override;
+
+ protected:
+  void checkSupport();
+  void prepare(std::uint64_t id, Request &request);
+  void enter(unsigned int minimumCompletions);
+  void complete(std::uint64_t id, int result);
+  void reap();
+  void release();
+};
+
+#endif
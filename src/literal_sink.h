@@ -0,0 +1,43 @@
+/**
+ * IMAP client
+ *
+ * @file literal_sink.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef LITERAL_SINK_H
+#define LITERAL_SINK_H
+
+#include <cstddef>
+#include <string_view>
+
+/**
+ * @brief Receives the contents of literals as they arrive from the server
+ */
+class LiteralSink {
+ public:
+  virtual ~LiteralSink() = default;
+
+  /**
+   * @brief Called when the server announces a literal
+   *
+   * @param line Line text which announces the literal
+   * @param size Size of the literal in bytes
+   */
+  virtual void beginLiteral(std::string_view line, std::size_t size) = 0;
+
+  /**
+   * @brief Called for every received part of the literal
+   *
+   * @param data Part of the literal
+   * @param size Size of the part
+   */
+  virtual void writeLiteral(const char *data, std::size_t size) = 0;
+
+  /**
+   * @brief Called after the whole literal was received
+   */
+  virtual void endLiteral() = 0;
+};
+
+#endif
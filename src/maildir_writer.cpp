@@ -0,0 +1,278 @@
+/**
+ * IMAP client
+ *
+ * @file maildir_writer.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include "maildir_writer.h"
+
+/**
+ * @brief Construct a new Maildir writer, the Maildir of the mailbox is created when the first email is written
+ *
+ * @param directoryPath Path where Maildirs of mailboxes are created
+ * @param hostname Imap server hostname
+ * @param mailbox Mailbox from where emails are fetched
+ */
+MaildirWriter::MaildirWriter(std::string directoryPath, std::string hostname, std::string mailbox)
+    : EmailWriter{directoryPath, hostname, mailbox},
+      maildirPath{std::filesystem::path{directoryPath} / MaildirWriter::getMaildirName(hostname, mailbox)} {}
+
+/**
+ * @brief Destroy the Maildir writer, emails that were written completely are moved to the Maildir
+ */
+MaildirWriter::~MaildirWriter() {
+  // Remove the email which was interrupted
+  if (this->emailFd >= 0) {
+    close(this->emailFd);
+    unlinkat(this->temporaryFd, this->email.temporaryName.c_str(), 0);
+  }
+
+  try {
+    this->flush();
+  } catch (const std::exception &) {
+    // Emails which were not moved stay in tmp/, where Maildir readers ignore them
+  }
+
+  for (int fd : {this->temporaryFd, this->newFd, this->currentFd}) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+/**
+ * @brief Create the file of an email announced in a FETCH response in tmp/
+ *
+ * @param line Line text which announces the literal, e.g. "* 1 FETCH (UID 7 FLAGS (\Seen) BODY[] {42}"
+ * @param size Size of the email in bytes
+ */
+void MaildirWriter::beginLiteral(std::string_view line, std::size_t size) {
+  // Only literals of FETCH responses contain emails
+  if (!EmailWriter::isEmailLiteral(line)) {
+    this->isWriting = false;
+    return;
+  }
+
+  // Deleting emails does not create the Maildir, only writing them does
+  if (this->temporaryFd < 0) {
+    this->temporaryFd = this->openDirectory("tmp");
+    this->newFd = this->openDirectory("new");
+    this->currentFd = this->openDirectory("cur");
+  }
+
+  // UIDs are unique in the Maildir of the mailbox until UIDVALIDITY changes, which deletes all emails
+  std::string uid = EmailWriter::getEmailUID(line);
+  std::string info = MaildirWriter::getInfo(line);
+  if (info.empty()) {
+    this->email = {uid, this->newFd, uid};
+  } else {
+    this->email = {uid, this->currentFd, uid + ":2," + info};
+  }
+
+  // Keep the email in memory, the disk writer writes it after it is received
+  if (this->diskWriter) {
+    this->contentPath = (this->maildirPath / "tmp" / uid).string();
+    this->content.clear();
+    this->content.reserve(size);
+    this->isWriting = true;
+    return;
+  }
+
+  this->emailFd = openat(this->temporaryFd, uid.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+  if (this->emailFd < 0) {
+    throw std::runtime_error("Could not open file " + (this->maildirPath / "tmp" / uid).string() + ".");
+  }
+  this->isWriting = true;
+}
+
+/**
+ * @brief Append a part of the email to its file
+ *
+ * @param data Part of the email
+ * @param size Size of the part
+ */
+void MaildirWriter::writeLiteral(const char *data, std::size_t size) {
+  if (!this->isWriting) {
+    return;
+  }
+
+  if (this->diskWriter) {
+    this->content.append(data, size);
+    return;
+  }
+
+  while (size > 0) {
+    ssize_t bytes = write(this->emailFd, data, size);
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (bytes < 0) {
+      throw std::runtime_error("Could not write email to file.");
+    }
+
+    data += bytes;
+    size -= bytes;
+  }
+}
+
+/**
+ * @brief Close the file of the email, it is moved to the Maildir with the next batch
+ */
+void MaildirWriter::endLiteral() {
+  if (!this->isWriting) {
+    return;
+  }
+
+  this->isWriting = false;
+  if (this->diskWriter) {
+    this->diskWriter->submit(std::move(this->contentPath), std::move(this->content));
+    this->content = {};
+  } else {
+    // Start writing the email to the disk without waiting for it, the batch waits for all emails at once
+    sync_file_range(this->emailFd, 0, 0, SYNC_FILE_RANGE_WRITE);
+    int result = close(this->emailFd);
+    this->emailFd = -1;
+    if (result < 0) {
+      throw std::runtime_error("Could not write email to file.");
+    }
+  }
+
+  this->pendingEmails.push_back(this->email);
+  this->count++;
+
+  if (this->pendingEmails.size() >= MaildirWriter::SYNC_BATCH_SIZE) {
+    this->flush();
+  }
+}
+
+/**
+ * @brief Move written emails from tmp/ to new/ or cur/, after their contents are on the disk
+ *
+ * One syncfs call synchronizes all files of the batch and one fsync per target directory makes the moves durable,
+ * instead of one fsync per email. Writeback of every email is started when its file is closed, so syncfs mostly
+ * waits for writes that are already running. Emails written in the background are waited for first.
+ */
+void MaildirWriter::flush() {
+  if (this->diskWriter) {
+    this->diskWriter->wait();
+  }
+
+  if (this->pendingEmails.empty()) {
+    return;
+  }
+
+  if (syncfs(this->temporaryFd) < 0) {
+    throw std::runtime_error("Could not synchronize emails to disk.");
+  }
+
+  for (const PendingEmail &pendingEmail : this->pendingEmails) {
+    if (renameat(this->temporaryFd, pendingEmail.temporaryName.c_str(), pendingEmail.targetFd,
+                 pendingEmail.targetName.c_str()) < 0) {
+      throw std::runtime_error("Could not move email " + pendingEmail.temporaryName + " to Maildir.");
+    }
+  }
+  this->pendingEmails.clear();
+
+  if (fsync(this->newFd) < 0 || fsync(this->currentFd) < 0) {
+    throw std::runtime_error("Could not synchronize Maildir to disk.");
+  }
+}
+
+/**
+ * @brief Delete the file of an email, whose flags can be changed by a Maildir reader
+ *
+ * @param uid UID of the email
+ */
+void MaildirWriter::deleteEmail(std::string uid) {
+  std::filesystem::remove(this->maildirPath / "new" / uid);
+  if (!std::filesystem::is_directory(this->maildirPath / "cur")) {
+    return;
+  }
+
+  for (const auto &file : std::filesystem::directory_iterator(this->maildirPath / "cur")) {
+    std::string name = file.path().filename().string();
+    if (name == uid || name.starts_with(uid + ":")) {
+      std::filesystem::remove(file.path());
+    }
+  }
+}
+
+/**
+ * @brief Delete files of all emails from the Maildir of the mailbox
+ */
+void MaildirWriter::deleteAll() {
+  for (std::string name : {"tmp", "new", "cur"}) {
+    if (!std::filesystem::is_directory(this->maildirPath / name)) {
+      continue;
+    }
+
+    for (const auto &file : std::filesystem::directory_iterator(this->maildirPath / name)) {
+      if (file.is_regular_file()) {
+        std::filesystem::remove(file.path());
+      }
+    }
+  }
+}
+
+/**
+ * @brief Get the name of the Maildir of a mailbox
+ *
+ * @param hostname Imap server hostname
+ * @param mailbox Name of the mailbox
+ * @return std::string Directory name, where hierarchy separators in the mailbox name are replaced
+ */
+std::string MaildirWriter::getMaildirName(std::string hostname, std::string mailbox) {
+  std::string prefix = EmailWriter::getFilePrefix(hostname, mailbox);
+  return prefix.substr(0, prefix.length() - 1);
+}
+
+/**
+ * @brief Get the Maildir info of an email from the flags in the line of a FETCH response
+ *
+ * @param line Line text, e.g. "* 1 FETCH (UID 7 FLAGS (\Seen \Answered) BODY[] {42}"
+ * @return std::string Maildir flags in alphabetical order, e.g. "RS", empty if the email has no flags
+ */
+std::string MaildirWriter::getInfo(std::string_view line) {
+  std::string lowerCaseLine{line};
+  std::transform(lowerCaseLine.begin(), lowerCaseLine.end(), lowerCaseLine.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+
+  std::size_t flagsStart = lowerCaseLine.find("flags (");
+  if (flagsStart == std::string::npos) {
+    return "";
+  }
+  flagsStart += 7;
+  std::string flags = lowerCaseLine.substr(flagsStart, lowerCaseLine.find(')', flagsStart) - flagsStart) + " ";
+
+  // Maildir flags in alphabetical order
+  std::string info;
+  for (const auto &[flag, letter] : {std::pair{"\\draft ", 'D'}, std::pair{"\\flagged ", 'F'},
+                                     std::pair{"\\answered ", 'R'}, std::pair{"\\seen ", 'S'},
+                                     std::pair{"\\deleted ", 'T'}}) {
+    if (flags.find(flag) != std::string::npos) {
+      info += letter;
+    }
+  }
+
+  return info;
+}
+
+/**
+ * @brief Create a subdirectory of the Maildir if it does not exist and open it
+ *
+ * @param name Name of the subdirectory
+ * @return int Directory file descriptor
+ */
+int MaildirWriter::openDirectory(std::string name) {
+  std::filesystem::path path = this->maildirPath / name;
+  std::filesystem::create_directories(path);
+
+  int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    throw std::runtime_error("Could not open Maildir directory " + path.string() + ".");
+  }
+
+  return fd;
+}
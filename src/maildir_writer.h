@@ -0,0 +1,89 @@
+/**
+ * IMAP client
+ *
+ * @file maildir_writer.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef MAILDIR_WRITER_H
+#define MAILDIR_WRITER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "email_writer.h"
+
+/**
+ * @brief Writes emails from a FETCH response to a Maildir, with one Maildir for every mailbox
+ *
+ * An email is written to tmp/ and moved to new/, or to cur/ with its flags if the server reports any. Emails are moved
+ * in batches, whose files are synchronized to the disk at once before they are moved, and the target directories are
+ * synchronized after they are moved. So an email is either complete or missing after a crash.
+ */
+class MaildirWriter : public EmailWriter {
+ public:
+  static const std::size_t SYNC_BATCH_SIZE = 256;
+
+ protected:
+  /**
+   * @brief Email written to tmp/ which was not moved yet
+   */
+  struct PendingEmail {
+    /// @brief File name in tmp/
+    std::string temporaryName;
+    /// @brief Directory file descriptor of new/ or cur/
+    int targetFd;
+    /// @brief File name in the target directory
+    std::string targetName;
+  };
+
+  /// @brief Path of the Maildir of the mailbox
+  std::filesystem::path maildirPath;
+  /// @brief File descriptor of tmp/
+  int temporaryFd{-1};
+  /// @brief File descriptor of new/
+  int newFd{-1};
+  /// @brief File descriptor of cur/
+  int currentFd{-1};
+
+  /// @brief File descriptor of the email that is currently being written
+  int emailFd{-1};
+  /// @brief Email that is currently being written
+  PendingEmail email;
+  /// @brief Written emails that were not moved yet
+  std::vector<PendingEmail> pendingEmails;
+
+ public:
+  MaildirWriter(std::string directoryPath, std::string hostname, std::string mailbox);
+  ~MaildirWriter() override;
+
+  MaildirWriter(const MaildirWriter &) = delete;
+  MaildirWriter &operator=(const MaildirWriter &) = delete;
+
+  void beginLiteral(std::string_view line, std::size_t size) override;
+  void writeLiteral(const char *data, std::size_t size) override;
+  void endLiteral() override;
+
+  void flush() override;
+  void deleteEmail(std::string uid) override;
+  void deleteAll() override;
+
+  static std::string getMaildirName(std::string hostname, std::string mailbox);
+  static std::string getInfo(std::string_view line);
+
+ protected:
+  int openDirectory(std::string name);
+};
+
+#endif
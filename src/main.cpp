@@ -5,22 +5,39 @@
  * @author Christian Saloň <xsalon02>
  */
 
+#include <atomic>
 #include <cstdint>
+#include <ctime>
 #include <exception>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
+#include <poll.h>
 #include <string.h>
+#include <unistd.h>
 
+#include "async_imap_client.h"
+#include "command_stats.h"
+#include "event_loop.h"
+#include "header_index.h"
 #include "imap_client.h"
+#include "mapped_header_index.h"
+#include "ssl_context.h"
+#include "ssl_session_cache.h"
+#include "task.h"
 
 const uint16_t IMAP_PORT = 143;
 const uint16_t IMAPS_PORT = 993;
 const std::string DEFAULT_CERTIFICATES_DIRECTORY = "/etc/ssl/certs";
 const std::string DEFAULT_MAILBOX = "INBOX";
+// IDLE is restarted before servers drop idle clients after 30 minutes (RFC 2177)
+const int IDLE_RESTART_TIMEOUT = 29 * 60 * 1000;
 
 /**
  * @brief Get output message when downloading all emails
@@ -69,6 +86,78 @@ const std::string getNewHeadersOutputMessage(std::size_t count, std::string mail
          " from mailbox " + mailbox + ".";
 }
 
+/**
+ * @brief Represents how emails are downloaded from a mailbox
+ */
+struct SyncOptions {
+  /// @brief Download only new emails
+  bool useOnlyNewMessages{false};
+  /// @brief Download only headers of emails
+  bool useOnlyHeaders{false};
+  /// @brief Path where to save emails
+  std::string outputDirectory;
+  /// @brief Specify how to split emails into multiple FETCH commands
+  BatchOptions batch;
+  /// @brief Number of connections that download emails from the mailbox in parallel
+  unsigned int connectionCount{1};
+  /// @brief Format in which emails are stored in the output directory
+  EmailWriter::Format outputFormat{EmailWriter::Format::FILES};
+  /// @brief Write received emails in the background while next emails are received
+  bool useAsyncWrites{false};
+  /// @brief Add headers of saved emails to the header index of the output directory
+  bool useIndex{false};
+  /// @brief Emails larger than this are fetched in resumable ranges of this size in bytes, 0 disables ranges
+  std::size_t partialSize{0};
+};
+
+/**
+ * @brief Represents the result of downloading emails from a mailbox
+ */
+struct SyncResult {
+  /// @brief Name of the mailbox
+  std::string mailbox;
+  /// @brief Output message displayed to user
+  std::string message;
+  /// @brief Represents if downloading failed
+  bool isError{false};
+};
+
+/**
+ * @brief Represents how to connect and authenticate to the server
+ */
+struct ServerOptions {
+  /// @brief Server hostname
+  std::string hostname;
+  /// @brief Server port
+  uint16_t port;
+  /// @brief Use a ssl connection
+  bool useSecure{false};
+  /// @brief Path to a certificate file used for validating ssl/tls certificate
+  std::string certificateFile;
+  /// @brief Path to a folder which is used for validating ssl/tls certificates
+  std::string certificatesDirectory;
+  /// @brief Username used for authentication
+  std::string username;
+  /// @brief Password used for authentication
+  std::string password;
+  /// @brief Minimum number of bytes requested from the socket by a single read
+  std::size_t readSize{ReceiveBuffer::DEFAULT_READ_SIZE};
+  /// @brief Compress the connection if the server supports it
+  bool useCompression{true};
+};
+
+/**
+ * @brief Represents mailboxes that are shared by sessions running on one thread
+ */
+struct MailboxPool {
+  /// @brief Names of mailboxes to download
+  std::vector<std::string> mailboxes;
+  /// @brief Index of the next mailbox that no session has taken yet
+  std::size_t nextMailbox{0};
+  /// @brief Results in the order of mailboxes
+  std::vector<SyncResult> results;
+};
+
 /**
  * @brief Convert a string to lower case
  *
@@ -83,42 +172,338 @@ std::string toLowerCase(std::string input) {
 }
 
 /**
- * @brief Save emails to selected directory
+ * @brief Delete all saved emails of a mailbox
+ *
+ * @param hostname Server hostname
+ * @param mailbox Mailbox of the emails
+ * @param directoryPath Path where emails are saved
+ * @param outputFormat Format in which emails are saved
+ */
+void deleteEmails(std::string hostname,
+                  std::string mailbox,
+                  std::string directoryPath,
+                  EmailWriter::Format outputFormat) {
+  EmailWriter::create(outputFormat, directoryPath, hostname, mailbox)->deleteAll();
+}
+
+/**
+ * @brief Select a mailbox and download its emails to the output directory
+ *
+ * Without only new emails, the output directory is synchronized with the mailbox using the state of the last run.
  *
- * @param emails Pairs, where the key is the UID of an email and the value is the contents of the email
- * @param directoryPath Path where to save emails
+ * @param client Logged in imap client
+ * @param hostname Server hostname
+ * @param mailbox Mailbox from where to download emails
+ * @param options Specify how to download emails
+ * @return std::string Output message displayed to user
  */
-void deleteEmails(std::string hostname, std::string mailbox, std::string directoryPath) {
-  // Check if email directory exists
-  if (!std::filesystem::exists(directoryPath) || !std::filesystem::is_directory(directoryPath)) {
-    return;
+std::string syncMailbox(IMAPClient &client, std::string hostname, std::string mailbox, const SyncOptions &options) {
+  IMAPClient::FetchOptions fetchOptions =
+      options.useOnlyHeaders ? IMAPClient::FetchOptions::HEADERS : IMAPClient::FetchOptions::ALL;
+
+  // Download emails from server directly to the output directory
+  if (options.useOnlyNewMessages) {
+    client.select(mailbox);
+    std::size_t count =
+        client.downloadNew(fetchOptions, options.outputDirectory, options.batch, options.connectionCount);
+    return options.useOnlyHeaders ? getNewHeadersOutputMessage(count, mailbox) : getNewOutputMessage(count, mailbox);
   }
 
-  for (const auto &file : std::filesystem::directory_iterator(directoryPath)) {
-    if (file.is_regular_file()) {
-      std::string filename = file.path().filename().string();
+  // Let the server report changes since the last synchronization of the same contents
+  std::string stateFilePath = SyncState::getFilePath(options.outputDirectory, hostname, mailbox);
+  SyncState state = SyncState::load(stateFilePath);
+  client.select(mailbox, state.onlyHeaders == options.useOnlyHeaders ? &state : nullptr);
+  if (state.uidValidity == 0 || state.uidValidity != client.getUidValidity() ||
+      state.onlyHeaders != options.useOnlyHeaders) {
+    // Delete emails that are in selected mailbox, because they can not be matched to emails on the server
+    deleteEmails(hostname, mailbox, options.outputDirectory, options.outputFormat);
+    state = SyncState{client.getUidValidity(), options.useOnlyHeaders};
+  }
+
+  // Download only emails that are not stored yet
+  std::size_t count =
+      client.sync(fetchOptions, options.outputDirectory, state, options.batch, options.connectionCount);
+  state.save(stateFilePath);
+
+  return options.useOnlyHeaders ? getHeadersOutputMessage(count, mailbox) : getAllOutputMessage(count, mailbox);
+}
+
+/**
+ * @brief Download new emails of a mailbox as soon as the server reports them, until the user enters a command
+ *
+ * Waits for the server socket and the standard input at the same time, so no commands are sent while nothing happens.
+ *
+ * @param client Logged in imap client
+ * @param mailbox Mailbox to watch
+ * @param options Specify how to download emails
+ * @return std::string Command entered by the user
+ */
+std::string idleMailbox(IMAPClient &client, std::string mailbox, const SyncOptions &options) {
+  IMAPClient::FetchOptions fetchOptions =
+      options.useOnlyHeaders ? IMAPClient::FetchOptions::HEADERS : IMAPClient::FetchOptions::ALL;
+
+  // Download emails that arrived before idling
+  client.select(mailbox);
+  std::size_t count = client.downloadNew(fetchOptions, options.outputDirectory, options.batch, options.connectionCount);
+  std::cout << (options.useOnlyHeaders ? getNewHeadersOutputMessage(count, mailbox)
+                                       : getNewOutputMessage(count, mailbox))
+            << std::endl;
+
+  client.startIdle();
+  while (true) {
+    // Input may already be buffered by the stream, which is not visible on the file descriptor
+    bool isInputReady = std::cin.rdbuf()->in_avail() > 0;
+    bool isServerReady = client.hasPendingData();
+
+    if (!isInputReady && !isServerReady) {
+      pollfd fds[] = {{STDIN_FILENO, POLLIN, 0}, {client.getFd(), POLLIN, 0}};
+      int ready = poll(fds, 2, IDLE_RESTART_TIMEOUT);
+      if (ready < 0) {
+        throw std::runtime_error("Could not wait for data.");
+      }
+
+      if (ready == 0) {
+        client.stopIdle();
+        client.startIdle();
+        continue;
+      }
+
+      isInputReady = fds[0].revents != 0;
+      isServerReady = fds[1].revents != 0;
+    }
+
+    if (isServerReady && client.readIdle()) {
+      // Download emails reported by the server
+      client.stopIdle();
+      count = client.downloadNew(fetchOptions, options.outputDirectory, options.batch, options.connectionCount);
+      if (count > 0) {
+        std::cout << (options.useOnlyHeaders ? getNewHeadersOutputMessage(count, mailbox)
+                                             : getNewOutputMessage(count, mailbox))
+                  << std::endl;
+      }
+      client.startIdle();
+    }
 
-      // Check if email filename starts with hostname and mailbox
-      if (filename.starts_with(hostname + "_" + mailbox)) {
-        std::filesystem::remove(file.path());
+    if (isInputReady) {
+      client.stopIdle();
+
+      std::string input;
+      if (!std::getline(std::cin, input)) {
+        // Standard input was closed
+        return "quit";
       }
+      return input;
     }
   }
 }
 
 /**
- * @brief Save emails to selected directory
+ * @brief Download emails from all mailboxes using a pool of sessions that work concurrently
+ *
+ * Every session downloads one mailbox at a time and takes the next mailbox when it is done.
+ *
+ * @param client Logged in imap client, which is used as the first session of the pool
+ * @param hostname Server hostname
+ * @param options Specify how to download emails, the connection count is the size of the pool
+ * @return std::vector<SyncResult> Results in the order of mailboxes returned by the server
+ */
+std::vector<SyncResult> syncAllMailboxes(IMAPClient &client, std::string hostname, const SyncOptions &options) {
+  std::vector<std::string> mailboxes = client.list();
+  std::vector<SyncResult> results(mailboxes.size());
+  std::atomic<std::size_t> nextMailbox{0};
+
+  SyncOptions mailboxOptions = options;
+  mailboxOptions.connectionCount = 1;
+
+  // Download mailboxes until there are none left
+  auto work = [&](IMAPClient &session) {
+    for (std::size_t index = nextMailbox++; index < mailboxes.size(); index = nextMailbox++) {
+      results[index].mailbox = mailboxes[index];
+      try {
+        results[index].message = syncMailbox(session, hostname, mailboxes[index], mailboxOptions);
+      } catch (const std::exception &e) {
+        results[index].message = e.what();
+        results[index].isError = true;
+      }
+    }
+  };
+
+  std::size_t sessionCount = std::min<std::size_t>(std::max(options.connectionCount, 1u), mailboxes.size());
+  std::vector<std::thread> workers;
+  for (std::size_t session = 1; session < sessionCount; session++) {
+    workers.emplace_back([&]() {
+      try {
+        std::unique_ptr<IMAPClient> poolSession = client.openSession();
+        work(*poolSession);
+      } catch (const std::exception &e) {
+        // Remaining mailboxes are downloaded by other sessions
+        std::cerr << "ERROR: " << e.what() << std::endl;
+      }
+    });
+  }
+
+  work(client);
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+
+  return results;
+}
+
+/**
+ * @brief Select a mailbox and download its emails to the output directory without blocking the event loop
+ *
+ * Works like syncMailbox.
  *
- * @param emails Pairs, where the key is the UID of an email and the value is the contents of the email
- * @param directoryPath Path where to save emails
+ * @param client Logged in imap client
+ * @param hostname Server hostname
+ * @param mailbox Mailbox from where to download emails
+ * @param options Specify how to download emails
+ * @return Task<std::string> Output message displayed to user
  */
-void saveEmails(std::unordered_map<std::string, std::string> emails, std::string directoryPath) {
-  for (std::pair<std::string, std::string> email : emails) {
-    std::string outputFilePath = directoryPath + (directoryPath.ends_with("/") ? "" : "/") + email.first;
-    std::ofstream outputFile{outputFilePath};
-    outputFile.write(email.second.c_str(), email.second.length());
-    outputFile.close();
+Task<std::string> syncMailboxAsync(AsyncIMAPClient &client,
+                                   std::string hostname,
+                                   std::string mailbox,
+                                   SyncOptions options) {
+  IMAPClient::FetchOptions fetchOptions =
+      options.useOnlyHeaders ? IMAPClient::FetchOptions::HEADERS : IMAPClient::FetchOptions::ALL;
+
+  co_await client.selectAsync(mailbox);
+  if (options.useOnlyNewMessages) {
+    std::size_t count = co_await client.downloadNewAsync(fetchOptions, options.outputDirectory, options.batch);
+    co_return options.useOnlyHeaders ? getNewHeadersOutputMessage(count, mailbox) : getNewOutputMessage(count, mailbox);
   }
+
+  std::string stateFilePath = SyncState::getFilePath(options.outputDirectory, hostname, mailbox);
+  SyncState state = SyncState::load(stateFilePath);
+  if (state.uidValidity == 0 || state.uidValidity != client.getUidValidity() ||
+      state.onlyHeaders != options.useOnlyHeaders) {
+    // Delete emails that are in selected mailbox, because they can not be matched to emails on the server
+    deleteEmails(hostname, mailbox, options.outputDirectory, options.outputFormat);
+    state = SyncState{client.getUidValidity(), options.useOnlyHeaders};
+  }
+
+  // Download only emails that are not stored yet
+  std::size_t count = co_await client.syncAsync(fetchOptions, options.outputDirectory, state, options.batch);
+  state.save(stateFilePath);
+
+  co_return options.useOnlyHeaders ? getHeadersOutputMessage(count, mailbox) : getAllOutputMessage(count, mailbox);
+}
+
+/**
+ * @brief Connect a session to the server and download mailboxes from the pool until there are none left
+ *
+ * @param loop Event loop that runs the session
+ * @param server Specify how to connect to the server
+ * @param options Specify how to download emails
+ * @param pool Mailboxes shared with other sessions
+ * @param isFirstSession Fill an empty pool with all mailboxes on the server and start the other sessions
+ */
+Task<void> syncMailboxPoolAsync(EventLoop &loop,
+                                ServerOptions server,
+                                SyncOptions options,
+                                MailboxPool &pool,
+                                bool isFirstSession) {
+  std::unique_ptr<AsyncIMAPClient> client;
+  try {
+    if (server.useSecure) {
+      client = co_await AsyncIMAPClient::connect(loop, server.hostname, server.port, server.certificateFile,
+                                                 server.certificatesDirectory);
+    } else {
+      client = co_await AsyncIMAPClient::connect(loop, server.hostname, server.port);
+    }
+    client->setReadSize(server.readSize);
+    client->setCompression(server.useCompression);
+    client->setOutputFormat(options.outputFormat);
+    client->setAsyncWrites(options.useAsyncWrites);
+    client->setIndexing(options.useIndex);
+    client->setPartialSize(options.partialSize);
+    co_await client->loginAsync(server.username, server.password);
+  } catch (const std::exception &e) {
+    if (isFirstSession) {
+      throw;
+    }
+
+    // Remaining mailboxes are downloaded by other sessions
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    co_return;
+  }
+
+  // The first session lists mailboxes and starts the other sessions
+  if (isFirstSession) {
+    if (pool.mailboxes.empty()) {
+      pool.mailboxes = co_await client->listAsync();
+      pool.results.resize(pool.mailboxes.size());
+    }
+
+    std::size_t sessionCount = std::min<std::size_t>(std::max(options.connectionCount, 1u), pool.mailboxes.size());
+    for (std::size_t session = 1; session < sessionCount; session++) {
+      loop.spawn(syncMailboxPoolAsync(loop, server, options, pool, false));
+    }
+  }
+
+  for (std::size_t index = pool.nextMailbox++; index < pool.mailboxes.size(); index = pool.nextMailbox++) {
+    pool.results[index].mailbox = pool.mailboxes[index];
+    try {
+      pool.results[index].message =
+          co_await syncMailboxAsync(*client, server.hostname, pool.mailboxes[index], options);
+    } catch (const std::exception &e) {
+      pool.results[index].message = e.what();
+      pool.results[index].isError = true;
+    }
+  }
+
+  co_await client->logoutAsync();
+}
+
+/**
+ * @brief Print results of downloading mailboxes
+ *
+ * @param results Results of downloading mailboxes
+ * @return true If downloading any mailbox failed
+ * @return false If all mailboxes were downloaded
+ */
+bool printResults(const std::vector<SyncResult> &results) {
+  bool isError = false;
+  for (const SyncResult &result : results) {
+    if (result.isError) {
+      std::cerr << "ERROR: " << result.mailbox << ": " << result.message << std::endl;
+      isError = true;
+    } else {
+      std::cout << result.message << std::endl;
+    }
+  }
+
+  return isError;
+}
+
+/**
+ * @brief Print emails from the header index of the output directory that match a query
+ *
+ * @param directoryPath Path where emails are saved
+ * @param text Query, see MappedHeaderIndex::Query::parse
+ */
+void searchIndex(std::string directoryPath, std::string text) {
+  MappedHeaderIndex::Query query = MappedHeaderIndex::Query::parse(text);
+  MappedHeaderIndex index{HeaderIndex::getFilePath(directoryPath)};
+  std::vector<std::size_t> rows = index.search(query);
+
+  for (std::size_t row : rows) {
+    // Print the date in UTC, emails without a valid date have no date
+    char date[20] = "";
+    std::time_t time = index.getDate(row);
+    std::tm dateTime;
+    if (time != 0 && gmtime_r(&time, &dateTime)) {
+      std::strftime(date, sizeof(date), "%Y-%m-%d %H:%M", &dateTime);
+    }
+
+    std::cout << date << "\t" << index.getText(MappedHeaderIndex::Field::HOSTNAME, row) << "\t"
+              << index.getText(MappedHeaderIndex::Field::MAILBOX, row) << "\t" << index.getUid(row) << "\t"
+              << index.getText(MappedHeaderIndex::Field::FROM, row) << "\t"
+              << index.getText(MappedHeaderIndex::Field::SUBJECT, row) << "\n";
+  }
+
+  std::cout << "Found " << rows.size() << " email" << (rows.size() == 1 ? "" : "s") << "." << std::endl;
 }
 
 /**
@@ -141,6 +526,25 @@ int main(int argc, char **argv) {
   std::string mailbox = DEFAULT_MAILBOX;
   std::string outputDirectory;
   bool interactiveMode = false;
+  bool useAllMailboxes = false;
+  bool useAsync = false;
+  BatchOptions batch;
+  unsigned int connectionCount = 1;
+  std::size_t readSize = ReceiveBuffer::DEFAULT_READ_SIZE;
+  bool useCompression = true;
+  EmailWriter::Format outputFormat = EmailWriter::Format::FILES;
+  bool useAsyncWrites = false;
+  bool useIndex = false;
+  std::size_t partialSize = 0;
+  bool useQuery = false;
+  std::string query;
+  std::string tlsSessionCachePath;
+  bool useKernelTls = false;
+  bool useStats = false;
+  std::string recordPath;
+  std::string replayPath;
+  bool useReplayDelays = false;
+  CommandStats::Format statsFormat = CommandStats::Format::JSON;
 
   // Proccess command line arguments
   for (int i = 1; i < argc; i++) {
@@ -169,19 +573,98 @@ int main(int argc, char **argv) {
       outputDirectory = argv[++i];
     } else if (strcmp(argv[i], "-i") == 0) {
       interactiveMode = true;
+    } else if (strcmp(argv[i], "--all-mailboxes") == 0) {
+      useAllMailboxes = true;
+    } else if (strcmp(argv[i], "--async") == 0) {
+      useAsync = true;
+    } else if (strcmp(argv[i], "-j") == 0) {
+      connectionCount = std::stoul(argv[++i]);
+    } else if (strcmp(argv[i], "--batch-size") == 0) {
+      batch.emailCount = std::stoul(argv[++i]);
+    } else if (strcmp(argv[i], "--batch-bytes") == 0) {
+      batch.byteCount = std::stoull(argv[++i]);
+    } else if (strcmp(argv[i], "--window") == 0) {
+      batch.window = std::stoul(argv[++i]);
+    } else if (strcmp(argv[i], "--tls-session-cache") == 0) {
+      tlsSessionCachePath = argv[++i];
+    } else if (strcmp(argv[i], "--maildir") == 0) {
+      outputFormat = EmailWriter::Format::MAILDIR;
+    } else if (strcmp(argv[i], "--dedup") == 0) {
+      outputFormat = EmailWriter::Format::STORE;
+    } else if (strcmp(argv[i], "--async-writes") == 0) {
+      useAsyncWrites = true;
+    } else if (strcmp(argv[i], "--index") == 0) {
+      useIndex = true;
+    } else if (strcmp(argv[i], "--partial-size") == 0) {
+      partialSize = std::stoull(argv[++i]);
+    } else if (strcmp(argv[i], "--query") == 0) {
+      useQuery = true;
+      query = argv[++i];
+    } else if (strcmp(argv[i], "--no-compress") == 0) {
+      useCompression = false;
+    } else if (strcmp(argv[i], "--ktls") == 0) {
+      useKernelTls = true;
+    } else if (strcmp(argv[i], "--stats") == 0) {
+      std::string format = argv[++i];
+      if (format != "json" && format != "histogram") {
+        std::cerr << "ERROR: " << "Invalid statistics format, use json or histogram." << std::endl;
+        return 1;
+      }
+
+      useStats = true;
+      statsFormat = format == "json" ? CommandStats::Format::JSON : CommandStats::Format::HISTOGRAM;
+    } else if (strcmp(argv[i], "--record") == 0) {
+      recordPath = argv[++i];
+    } else if (strcmp(argv[i], "--replay") == 0) {
+      replayPath = argv[++i];
+    } else if (strcmp(argv[i], "--replay-delays") == 0) {
+      useReplayDelays = true;
+    } else if (strcmp(argv[i], "--read-size") == 0) {
+      readSize = std::stoul(argv[++i]);
     } else {
       serverAddress = argv[i];
     }
   }
 
+  // Search the header index without connecting to the server
+  if (useQuery && !outputDirectory.empty()) {
+    try {
+      searchIndex(outputDirectory, query);
+    } catch (const std::exception &e) {
+      std::cerr << "ERROR: " << e.what() << std::endl;
+      return 1;
+    }
+
+    return 0;
+  }
+
   // Check if required command line arguments are set
   if (serverAddress.empty() || authFilePath.empty() || outputDirectory.empty()) {
     std::cerr << "How to run the program: ./imapcl server [-p port] [-T [-c certfile] [-C certaddr]] [-n] [-h] -a "
-                 "auth_file [-b MAILBOX] -o out_dir"
+                 "auth_file [-b MAILBOX | --all-mailboxes] -o out_dir [--maildir | --dedup] [--async-writes] "
+                 "[--index] [-i] [-j connections] [--batch-size count] [--batch-bytes bytes] [--window count] "
+                 "[--partial-size bytes] [--read-size bytes] [--tls-session-cache file] [--ktls] [--no-compress] "
+                 "[--stats json|histogram] [--record trace | --replay trace [--replay-delays]] [--async]\n"
+                 "       ./imapcl -o out_dir --query QUERY"
               << std::endl;
     return 1;
   }
 
+  // The store hashes emails while it writes them, so it writes them itself
+  if (useAsyncWrites && outputFormat == EmailWriter::Format::STORE) {
+    std::cerr << "ERROR: " << "--async-writes can not be used with --dedup." << std::endl;
+    return 1;
+  }
+
+  // Only a single synchronous session is recorded or replayed, -i and -j open more sessions
+  if ((!recordPath.empty() || !replayPath.empty()) && (useAsync || interactiveMode || connectionCount > 1)) {
+    std::cerr << "ERROR: " << "--record and --replay can not be used with --async, -i or -j." << std::endl;
+    return 1;
+  }
+
+  IMAPClient::FetchOptions fetchOptions =
+      useOnlyHeaders ? IMAPClient::FetchOptions::HEADERS : IMAPClient::FetchOptions::ALL;
+
   // Get credentails from auth file
   std::ifstream authFile{authFilePath};
   std::string line;
@@ -205,16 +688,70 @@ int main(int argc, char **argv) {
   // Close auth file
   authFile.close();
 
+  SSLContext::setKernelTls(useKernelTls);
+
+  // Print per-command latencies and byte counts when the program exits
+  if (useStats) {
+    CommandStats::enable(statsFormat);
+  }
+
+  // Resume tls sessions saved by previous runs
+  if (!tlsSessionCachePath.empty()) {
+    SSLSessionCache::open(tlsSessionCachePath);
+  }
+
   try {
+    if (useAsync && !interactiveMode) {
+      // Run all sessions as coroutines on this thread
+      ServerOptions server{serverAddress, port, useSecure, certificateFilePath, certificatesDirectory, username,
+                           password, readSize, useCompression};
+      SyncOptions options{useOnlyNewMessages, useOnlyHeaders, outputDirectory, batch, connectionCount, outputFormat,
+                          useAsyncWrites, useIndex, partialSize};
+      MailboxPool pool;
+      if (!useAllMailboxes) {
+        pool.mailboxes = {mailbox};
+        pool.results.resize(1);
+      }
+
+      EventLoop loop;
+      loop.spawn(syncMailboxPoolAsync(loop, server, options, pool, true));
+      loop.run();
+
+      return printResults(pool.results) ? 1 : 0;
+    }
+
     // Initialize imap client
-    IMAPClient client = useSecure ? IMAPClient{serverAddress, port, certificateFilePath, certificatesDirectory}
-                                  : IMAPClient{serverAddress, port};
+    std::unique_ptr<IMAPClient> clientPointer;
+    if (!replayPath.empty()) {
+      clientPointer = IMAPClient::replay(replayPath, serverAddress, port, useReplayDelays);
+    } else if (!recordPath.empty()) {
+      clientPointer = useSecure ? IMAPClient::record(recordPath, serverAddress, port, certificateFilePath,
+                                                     certificatesDirectory)
+                                : IMAPClient::record(recordPath, serverAddress, port);
+    } else {
+      clientPointer = useSecure ? std::make_unique<IMAPClient>(serverAddress, port, certificateFilePath,
+                                                               certificatesDirectory)
+                                : std::make_unique<IMAPClient>(serverAddress, port);
+    }
+    IMAPClient &client = *clientPointer;
+    client.setReadSize(readSize);
+    client.setCompression(useCompression);
+    client.setOutputFormat(outputFormat);
+    client.setAsyncWrites(useAsyncWrites);
+    client.setIndexing(useIndex);
+    client.setPartialSize(partialSize);
 
     if (interactiveMode) {
+      SyncOptions options{true, useOnlyHeaders, outputDirectory, batch, connectionCount, outputFormat,
+                          useAsyncWrites, useIndex, partialSize};
       std::string input;
+      bool isInputPending = false;
       while (true) {
-        // Get input from user
-        std::getline(std::cin, input);
+        // Get input from user, unless it was entered while idling
+        if (!isInputPending) {
+          std::getline(std::cin, input);
+        }
+        isInputPending = false;
         std::string lowerCaseInput = toLowerCase(input);
 
         // Parse user command
@@ -225,15 +762,13 @@ int main(int argc, char **argv) {
             selectedMailbox = input.substr(12);
           }
 
-          // Select mailbox and fetch all emails
+          // Select mailbox and download all emails
           client.select(selectedMailbox);
-          std::unordered_map<std::string, std::string> emails =
-              client.fetch(useOnlyHeaders ? IMAPClient::FetchOptions::HEADERS : IMAPClient::FetchOptions::ALL);
           // Delete emails that are in selected mailbox to ensure client is synced with server
-          deleteEmails(serverAddress, selectedMailbox, outputDirectory);
-          saveEmails(emails, outputDirectory);
-          std::cout << (useOnlyHeaders ? getHeadersOutputMessage(emails.size(), selectedMailbox)
-                                       : getAllOutputMessage(emails.size(), selectedMailbox))
+          deleteEmails(serverAddress, selectedMailbox, outputDirectory, outputFormat);
+          std::size_t count = client.download(fetchOptions, outputDirectory, batch, connectionCount);
+          std::cout << (useOnlyHeaders ? getHeadersOutputMessage(count, selectedMailbox)
+                                       : getAllOutputMessage(count, selectedMailbox))
                     << std::endl;
         } else if (lowerCaseInput.starts_with("downloadnew")) {
           std::string selectedMailbox = mailbox;
@@ -242,13 +777,11 @@ int main(int argc, char **argv) {
             selectedMailbox = input.substr(12);
           }
 
-          // Select mailbox and fetch new emails
+          // Select mailbox and download new emails
           client.select(selectedMailbox);
-          std::unordered_map<std::string, std::string> emails =
-              client.fetchNew(useOnlyHeaders ? IMAPClient::FetchOptions::HEADERS : IMAPClient::FetchOptions::ALL);
-          saveEmails(emails, outputDirectory);
-          std::cout << (useOnlyHeaders ? getNewHeadersOutputMessage(emails.size(), selectedMailbox)
-                                       : getNewOutputMessage(emails.size(), selectedMailbox))
+          std::size_t count = client.downloadNew(fetchOptions, outputDirectory, batch, connectionCount);
+          std::cout << (useOnlyHeaders ? getNewHeadersOutputMessage(count, selectedMailbox)
+                                       : getNewOutputMessage(count, selectedMailbox))
                     << std::endl;
         } else if (lowerCaseInput.starts_with("readnew")) {
           std::string selectedMailbox = mailbox;
@@ -262,6 +795,16 @@ int main(int argc, char **argv) {
           client.read();
 
           std::cout << "Emails in mailbox " << selectedMailbox << " were read." << std::endl;
+        } else if (lowerCaseInput.starts_with("idle")) {
+          std::string selectedMailbox = mailbox;
+          if (input.length() >= 6) {
+            // Select mailbox in user command
+            selectedMailbox = input.substr(5);
+          }
+
+          // Download new emails as they arrive until the user enters the next command
+          input = idleMailbox(client, selectedMailbox, options);
+          isInputPending = true;
         } else if (lowerCaseInput.starts_with("quit")) {
           break;
         } else if (lowerCaseInput.starts_with("starttls")) {
@@ -280,28 +823,15 @@ int main(int argc, char **argv) {
       // Authenticate user
       client.login(username, password);
 
-      // Fetch emails from server
-      std::unordered_map<std::string, std::string> emails;
-      client.select(mailbox);
-      if (useOnlyNewMessages) {
-        emails = client.fetchNew(useOnlyHeaders ? IMAPClient::FetchOptions::HEADERS : IMAPClient::FetchOptions::ALL);
+      SyncOptions options{useOnlyNewMessages, useOnlyHeaders, outputDirectory, batch, connectionCount, outputFormat,
+                          useAsyncWrites, useIndex, partialSize};
+      if (!useAllMailboxes) {
+        std::cout << syncMailbox(client, serverAddress, mailbox, options) << std::endl;
       } else {
-        // Delete emails that are in selected mailbox to ensure client is synced with server
-        deleteEmails(serverAddress, mailbox, outputDirectory);
-
-        emails = client.fetch(useOnlyHeaders ? IMAPClient::FetchOptions::HEADERS : IMAPClient::FetchOptions::ALL);
-      }
-
-      saveEmails(emails, outputDirectory);
-
-      if (useOnlyNewMessages) {
-        std::cout << (useOnlyHeaders ? getNewHeadersOutputMessage(emails.size(), mailbox)
-                                     : getNewOutputMessage(emails.size(), mailbox))
-                  << std::endl;
-      } else {
-        std::cout << (useOnlyHeaders ? getHeadersOutputMessage(emails.size(), mailbox)
-                                     : getAllOutputMessage(emails.size(), mailbox))
-                  << std::endl;
+        // Print a summary for every mailbox
+        if (printResults(syncAllMailboxes(client, serverAddress, options))) {
+          return 1;
+        }
       }
     }
   } catch (const std::exception &e) {
@@ -0,0 +1,393 @@
+/**
+ * IMAP client
+ *
+ * @file mapped_header_index.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include "mapped_header_index.h"
+
+/**
+ * @brief Parse a query, whose terms separated by spaces must all match
+ *
+ * Terms are "from:", "to:", "subject:", "id:", "mailbox:" and "host:" followed by a text, "uid:", "larger:" and
+ * "smaller:" followed by a number, "since:" and "before:" followed by a date in format YYYY-MM-DD and "flag:" and
+ * "noflag:" followed by seen, answered, flagged, deleted or draft. Other terms are searched in the sender, recipients
+ * and subject. Texts with spaces can be enclosed in double quotes.
+ *
+ * @param text Query text, e.g. "from:alice subject:\"weekly report\" since:2024-01-01 noflag:seen"
+ * @return Query Parsed query
+ */
+MappedHeaderIndex::Query MappedHeaderIndex::Query::parse(std::string text) {
+  Query query;
+  std::size_t position = 0;
+
+  while (position < text.length()) {
+    if (text[position] == ' ') {
+      position++;
+      continue;
+    }
+
+    // Read one term, spaces inside double quotes do not end it
+    std::string term;
+    bool isQuoted = false;
+    for (; position < text.length() && (isQuoted || text[position] != ' '); position++) {
+      if (text[position] == '"') {
+        isQuoted = !isQuoted;
+      } else {
+        term += text[position];
+      }
+    }
+
+    std::size_t separator = term.find(':');
+    std::string name = separator == std::string::npos ? "" : term.substr(0, separator);
+    std::string value = separator == std::string::npos ? term : term.substr(separator + 1);
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+
+    try {
+      if (name == "from") {
+        query.texts.push_back({Field::FROM, value});
+      } else if (name == "to") {
+        query.texts.push_back({Field::TO, value});
+      } else if (name == "subject") {
+        query.texts.push_back({Field::SUBJECT, value});
+      } else if (name == "id") {
+        query.texts.push_back({Field::MESSAGE_ID, value});
+      } else if (name == "mailbox") {
+        query.texts.push_back({Field::MAILBOX, value});
+      } else if (name == "host") {
+        query.texts.push_back({Field::HOSTNAME, value});
+      } else if (name == "uid") {
+        query.uid = std::stoull(value);
+      } else if (name == "larger") {
+        query.larger = std::stoull(value);
+      } else if (name == "smaller") {
+        query.smaller = std::stoull(value);
+      } else if (name == "since" || name == "before") {
+        std::tm date{};
+        if (sscanf(value.c_str(), "%d-%d-%d", &date.tm_year, &date.tm_mon, &date.tm_mday) != 3) {
+          throw std::invalid_argument(value);
+        }
+        date.tm_year -= 1900;
+        date.tm_mon -= 1;
+        (name == "since" ? query.since : query.before) = timegm(&date);
+      } else if (name == "flag" || name == "noflag") {
+        std::uint32_t flag = MappedHeaderIndex::parseFlags(value);
+        if (flag == 0) {
+          throw std::invalid_argument(value);
+        }
+        (name == "flag" ? query.requiredFlags : query.excludedFlags) |= flag;
+      } else {
+        query.texts.push_back({Field::ANY, term});
+      }
+    } catch (const std::logic_error &) {
+      throw std::runtime_error("Invalid query term " + term + ".");
+    }
+  }
+
+  // Texts are compared case insensitively
+  for (auto &[field, value] : query.texts) {
+    std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return std::tolower(c); });
+  }
+
+  return query;
+}
+
+/**
+ * @brief Construct a new MappedHeaderIndex object and map the index file
+ *
+ * A missing or empty file is an empty index.
+ *
+ * @param filePath Path of the index file
+ */
+MappedHeaderIndex::MappedHeaderIndex(std::string filePath) {
+  this->fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+  if (this->fd < 0) {
+    if (errno == ENOENT) {
+      return;
+    }
+    throw std::runtime_error("Could not open header index " + filePath + ".");
+  }
+
+  struct stat status;
+  if (fstat(this->fd, &status) < 0) {
+    this->unmap();
+    throw std::runtime_error("Could not open header index " + filePath + ".");
+  }
+
+  this->size = status.st_size;
+  if (this->size == 0) {
+    return;
+  }
+
+  void *data = mmap(nullptr, this->size, PROT_READ, MAP_SHARED, this->fd, 0);
+  if (data == MAP_FAILED) {
+    this->size = 0;
+    this->unmap();
+    throw std::runtime_error("Could not map header index " + filePath + ".");
+  }
+  this->data = static_cast<const char *>(data);
+
+  // Verify that the columns and the string table fit in the file
+  const FileHeader *header = reinterpret_cast<const FileHeader *>(this->data);
+  if (this->size < sizeof(FileHeader) || std::memcmp(header->magic, MappedHeaderIndex::MAGIC, 8) != 0 ||
+      header->count > this->size / sizeof(StringRef)) {
+    this->unmap();
+    throw std::runtime_error("Invalid header index " + filePath + ".");
+  }
+
+  Layout layout = MappedHeaderIndex::getLayout(header->count);
+  if (layout.strings > this->size || header->stringsSize != this->size - layout.strings) {
+    this->unmap();
+    throw std::runtime_error("Invalid header index " + filePath + ".");
+  }
+
+  this->count = header->count;
+  this->uids = reinterpret_cast<const std::uint64_t *>(this->data + layout.uids);
+  this->sizes = reinterpret_cast<const std::uint64_t *>(this->data + layout.sizes);
+  this->dates = reinterpret_cast<const std::int64_t *>(this->data + layout.dates);
+  this->flags = reinterpret_cast<const std::uint32_t *>(this->data + layout.flags);
+  this->hostnames = reinterpret_cast<const StringRef *>(this->data + layout.hostnames);
+  this->mailboxes = reinterpret_cast<const StringRef *>(this->data + layout.mailboxes);
+  this->messageIds = reinterpret_cast<const StringRef *>(this->data + layout.messageIds);
+  this->senders = reinterpret_cast<const StringRef *>(this->data + layout.senders);
+  this->recipients = reinterpret_cast<const StringRef *>(this->data + layout.recipients);
+  this->subjects = reinterpret_cast<const StringRef *>(this->data + layout.subjects);
+  this->strings = this->data + layout.strings;
+  this->stringsSize = header->stringsSize;
+}
+
+/**
+ * @brief Destroy the MappedHeaderIndex object and unmap the index file
+ */
+MappedHeaderIndex::~MappedHeaderIndex() {
+  this->unmap();
+}
+
+/**
+ * @brief Unmap the index and close its file, the destructor does not run when the constructor throws
+ */
+void MappedHeaderIndex::unmap() {
+  if (this->data) {
+    munmap(const_cast<char *>(this->data), this->size);
+    this->data = nullptr;
+  }
+
+  if (this->fd >= 0) {
+    close(this->fd);
+    this->fd = -1;
+  }
+}
+
+/**
+ * @brief Get the number of emails in the index
+ *
+ * @return std::size_t Number of emails
+ */
+std::size_t MappedHeaderIndex::getCount() const {
+  return this->count;
+}
+
+/**
+ * @brief Get the UID of an email
+ *
+ * @param row Index of the email
+ * @return std::uint64_t UID of the email
+ */
+std::uint64_t MappedHeaderIndex::getUid(std::size_t row) const {
+  return this->uids[row];
+}
+
+/**
+ * @brief Get the size of an email
+ *
+ * @param row Index of the email
+ * @return std::uint64_t Size of the saved email in bytes
+ */
+std::uint64_t MappedHeaderIndex::getSize(std::size_t row) const {
+  return this->sizes[row];
+}
+
+/**
+ * @brief Get the date of an email
+ *
+ * @param row Index of the email
+ * @return std::int64_t Date from the header as unix time, 0 if the email has no valid date
+ */
+std::int64_t MappedHeaderIndex::getDate(std::size_t row) const {
+  return this->dates[row];
+}
+
+/**
+ * @brief Get the flags of an email
+ *
+ * @param row Index of the email
+ * @return std::uint32_t Flags of the email as bits
+ */
+std::uint32_t MappedHeaderIndex::getFlags(std::size_t row) const {
+  return this->flags[row];
+}
+
+/**
+ * @brief Get a text field of an email
+ *
+ * @param field Field to get, ANY is not allowed
+ * @param row Index of the email
+ * @return std::string_view Value of the field, valid while the index is mapped
+ */
+std::string_view MappedHeaderIndex::getText(Field field, std::size_t row) const {
+  switch (field) {
+    case Field::HOSTNAME:
+      return this->getString(this->hostnames, row);
+    case Field::MAILBOX:
+      return this->getString(this->mailboxes, row);
+    case Field::MESSAGE_ID:
+      return this->getString(this->messageIds, row);
+    case Field::FROM:
+      return this->getString(this->senders, row);
+    case Field::TO:
+      return this->getString(this->recipients, row);
+    case Field::SUBJECT:
+      return this->getString(this->subjects, row);
+    case Field::ANY:
+      break;
+  }
+
+  throw std::runtime_error("Invalid header index field.");
+}
+
+/**
+ * @brief Find emails that match a query
+ *
+ * Numeric columns are checked before text columns, so most emails are rejected without touching the string table.
+ *
+ * @param query Conditions that found emails satisfy
+ * @return std::vector<std::size_t> Indexes of found emails in the order of the index
+ */
+std::vector<std::size_t> MappedHeaderIndex::search(const Query &query) const {
+  std::vector<std::size_t> rows;
+
+  for (std::size_t row = 0; row < this->count; row++) {
+    if ((query.uid != 0 && this->uids[row] != query.uid) || this->sizes[row] <= query.larger ||
+        this->sizes[row] >= query.smaller || this->dates[row] < query.since || this->dates[row] >= query.before ||
+        (this->flags[row] & query.requiredFlags) != query.requiredFlags || (this->flags[row] & query.excludedFlags)) {
+      continue;
+    }
+
+    bool isMatch = true;
+    for (const auto &[field, text] : query.texts) {
+      if (field == Field::ANY) {
+        isMatch = MappedHeaderIndex::contains(this->getText(Field::FROM, row), text) ||
+                  MappedHeaderIndex::contains(this->getText(Field::TO, row), text) ||
+                  MappedHeaderIndex::contains(this->getText(Field::SUBJECT, row), text);
+      } else {
+        isMatch = MappedHeaderIndex::contains(this->getText(field, row), text);
+      }
+
+      if (!isMatch) {
+        break;
+      }
+    }
+
+    if (isMatch) {
+      rows.push_back(row);
+    }
+  }
+
+  return rows;
+}
+
+/**
+ * @brief Get the offsets of the columns in a file with a number of emails
+ *
+ * Every column starts at a multiple of 8 bytes, so the mapped columns are aligned.
+ *
+ * @param count Number of emails
+ * @return Layout Offsets of the columns
+ */
+MappedHeaderIndex::Layout MappedHeaderIndex::getLayout(std::uint64_t count) {
+  auto align = [](std::size_t offset) { return (offset + 7) / 8 * 8; };
+
+  Layout layout;
+  layout.uids = sizeof(FileHeader);
+  layout.sizes = layout.uids + count * sizeof(std::uint64_t);
+  layout.dates = layout.sizes + count * sizeof(std::uint64_t);
+  layout.flags = layout.dates + count * sizeof(std::int64_t);
+  layout.hostnames = align(layout.flags + count * sizeof(std::uint32_t));
+  layout.mailboxes = layout.hostnames + count * sizeof(StringRef);
+  layout.messageIds = layout.mailboxes + count * sizeof(StringRef);
+  layout.senders = layout.messageIds + count * sizeof(StringRef);
+  layout.recipients = layout.senders + count * sizeof(StringRef);
+  layout.subjects = layout.recipients + count * sizeof(StringRef);
+  layout.strings = layout.subjects + count * sizeof(StringRef);
+
+  return layout;
+}
+
+/**
+ * @brief Convert flags to bits
+ *
+ * @param flags Flags separated by spaces, e.g. "\Seen \Flagged", the backslash is optional
+ * @return std::uint32_t Bits of known flags, other flags are ignored
+ */
+std::uint32_t MappedHeaderIndex::parseFlags(std::string_view flags) {
+  std::uint32_t bits = 0;
+  std::size_t position = 0;
+
+  while (position < flags.length()) {
+    std::size_t flagEnd = std::min(flags.find(' ', position), flags.length());
+    std::string flag{flags.substr(position, flagEnd - position)};
+    position = flagEnd + 1;
+
+    std::transform(flag.begin(), flag.end(), flag.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (flag.starts_with("\\")) {
+      flag.erase(0, 1);
+    }
+
+    if (flag == "seen") {
+      bits |= Flag::SEEN;
+    } else if (flag == "answered") {
+      bits |= Flag::ANSWERED;
+    } else if (flag == "flagged") {
+      bits |= Flag::FLAGGED;
+    } else if (flag == "deleted") {
+      bits |= Flag::DELETED;
+    } else if (flag == "draft") {
+      bits |= Flag::DRAFT;
+    }
+  }
+
+  return bits;
+}
+
+/**
+ * @brief Get a string from a text column
+ *
+ * @param column Text column
+ * @param row Index of the email
+ * @return std::string_view String in the string table, empty if the reference is out of the table
+ */
+std::string_view MappedHeaderIndex::getString(const StringRef *column, std::size_t row) const {
+  const StringRef &reference = column[row];
+  if (static_cast<std::size_t>(reference.offset) + reference.length > this->stringsSize) {
+    return {};
+  }
+
+  return {this->strings + reference.offset, reference.length};
+}
+
+/**
+ * @brief Check if a text contains a needle, ignoring case
+ *
+ * @param text Text to search in
+ * @param lowerCaseNeedle Text to find in lower case
+ * @return true If the text contains the needle
+ * @return false If the text does not contain the needle
+ */
+bool MappedHeaderIndex::contains(std::string_view text, std::string_view lowerCaseNeedle) {
+  return std::search(text.begin(), text.end(), lowerCaseNeedle.begin(), lowerCaseNeedle.end(),
+                     [](char character, char needleCharacter) {
+                       return std::tolower(static_cast<unsigned char>(character)) == needleCharacter;
+                     }) != text.end() ||
+         lowerCaseNeedle.empty();
+}
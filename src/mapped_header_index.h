@@ -0,0 +1,165 @@
+/**
+ * IMAP client
+ *
+ * @file mapped_header_index.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef MAPPED_HEADER_INDEX_H
+#define MAPPED_HEADER_INDEX_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief Read-only view of a header index file, which is mapped into memory and searched without parsing it
+ *
+ * The file starts with a header followed by one array per column, so a search reads only the columns it filters by.
+ * Numbers are stored in the byte order of the machine. Strings are stored once in a string table at the end of the
+ * file and columns refer to them by their offset and length.
+ */
+class MappedHeaderIndex {
+ public:
+  /**
+   * @brief Header at the start of the file
+   */
+  struct FileHeader {
+    /// @brief Identifies the format and its version
+    char magic[8];
+    /// @brief Number of emails
+    std::uint64_t count;
+    /// @brief Size of the string table in bytes
+    std::uint64_t stringsSize;
+  };
+
+  /**
+   * @brief Reference to a string in the string table
+   */
+  struct StringRef {
+    /// @brief Offset of the string from the start of the string table
+    std::uint32_t offset;
+    /// @brief Length of the string in bytes
+    std::uint32_t length;
+  };
+
+  /**
+   * @brief Offsets of the columns from the start of the file
+   */
+  struct Layout {
+    std::size_t uids;
+    std::size_t sizes;
+    std::size_t dates;
+    std::size_t flags;
+    std::size_t hostnames;
+    std::size_t mailboxes;
+    std::size_t messageIds;
+    std::size_t senders;
+    std::size_t recipients;
+    std::size_t subjects;
+    std::size_t strings;
+  };
+
+  /**
+   * @brief Flags of emails stored as bits
+   */
+  enum Flag : std::uint32_t { SEEN = 1, ANSWERED = 2, FLAGGED = 4, DELETED = 8, DRAFT = 16 };
+
+  /**
+   * @brief Text columns which a search can filter by
+   */
+  enum class Field { HOSTNAME, MAILBOX, MESSAGE_ID, FROM, TO, SUBJECT, ANY };
+
+  /**
+   * @brief Conditions that all found emails satisfy
+   */
+  struct Query {
+    /// @brief Texts that must be contained in the fields, case insensitive
+    std::vector<std::pair<Field, std::string>> texts;
+    /// @brief Flags that must be set
+    std::uint32_t requiredFlags{0};
+    /// @brief Flags that must not be set
+    std::uint32_t excludedFlags{0};
+    /// @brief UID of the email, 0 for any
+    std::uint64_t uid{0};
+    /// @brief Earliest date as unix time
+    std::int64_t since{std::numeric_limits<std::int64_t>::min()};
+    /// @brief Date before which emails must be sent as unix time
+    std::int64_t before{std::numeric_limits<std::int64_t>::max()};
+    /// @brief Size that emails must exceed in bytes
+    std::uint64_t larger{0};
+    /// @brief Size that emails must be below in bytes
+    std::uint64_t smaller{std::numeric_limits<std::uint64_t>::max()};
+
+    static Query parse(std::string text);
+  };
+
+  static inline const char MAGIC[8] = {'I', 'M', 'A', 'P', 'H', 'I', 'X', '1'};
+
+ protected:
+  /// @brief File descriptor of the index file
+  int fd{-1};
+  /// @brief Mapped contents of the file, nullptr if the file is empty or missing
+  const char *data{nullptr};
+  /// @brief Size of the mapped contents
+  std::size_t size{0};
+  /// @brief Number of emails
+  std::size_t count{0};
+
+  /// @brief Columns in the mapped contents
+  const std::uint64_t *uids{nullptr};
+  const std::uint64_t *sizes{nullptr};
+  const std::int64_t *dates{nullptr};
+  const std::uint32_t *flags{nullptr};
+  const StringRef *hostnames{nullptr};
+  const StringRef *mailboxes{nullptr};
+  const StringRef *messageIds{nullptr};
+  const StringRef *senders{nullptr};
+  const StringRef *recipients{nullptr};
+  const StringRef *subjects{nullptr};
+  /// @brief String table in the mapped contents
+  const char *strings{nullptr};
+  /// @brief Size of the string table
+  std::size_t stringsSize{0};
+
+ public:
+  explicit MappedHeaderIndex(std::string filePath);
+  ~MappedHeaderIndex();
+
+  MappedHeaderIndex(const MappedHeaderIndex &) = delete;
+  MappedHeaderIndex &operator=(const MappedHeaderIndex &) = delete;
+
+  std::size_t getCount() const;
+  std::uint64_t getUid(std::size_t row) const;
+  std::uint64_t getSize(std::size_t row) const;
+  std::int64_t getDate(std::size_t row) const;
+  std::uint32_t getFlags(std::size_t row) const;
+  std::string_view getText(Field field, std::size_t row) const;
+
+  std::vector<std::size_t> search(const Query &query) const;
+
+  static Layout getLayout(std::uint64_t count);
+  static std::uint32_t parseFlags(std::string_view flags);
+
+ protected:
+  void unmap();
+  std::string_view getString(const StringRef *column, std::size_t row) const;
+  static bool contains(std::string_view text, std::string_view lowerCaseNeedle);
+};
+
+#endif
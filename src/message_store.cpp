@@ -0,0 +1,198 @@
+/**
+ * IMAP client
+ *
+ * @file message_store.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include "message_store.h"
+
+/**
+ * @brief Construct a new MessageStore object, create its directories and load its index
+ *
+ * @param storePath Path of the store
+ */
+MessageStore::MessageStore(std::filesystem::path storePath) : storePath{storePath} {
+  std::error_code error;
+  std::filesystem::create_directories(this->storePath / "objects", error);
+  std::filesystem::create_directories(this->storePath / "tmp", error);
+  if (error) {
+    throw std::runtime_error("Could not create message store " + this->storePath.string() + ".");
+  }
+
+  // Every line contains the hash, the size and the Message-ID of an email
+  std::ifstream file{this->storePath / "index"};
+  std::string hash;
+  std::size_t size;
+  std::string messageId;
+  while (file >> hash >> size >> messageId) {
+    this->hashes.emplace(MessageStore::getKey(messageId, size), hash);
+  }
+
+  this->index.open(this->storePath / "index", std::ios::app);
+  if (!this->index.is_open()) {
+    throw std::runtime_error("Could not open message store index " + (this->storePath / "index").string() + ".");
+  }
+}
+
+/**
+ * @brief Get the store of an output directory, which is opened if no session uses it yet
+ *
+ * @param directoryPath Path where emails are saved
+ * @return std::shared_ptr<MessageStore> Store shared by all sessions that save emails to the directory
+ */
+std::shared_ptr<MessageStore> MessageStore::open(std::string directoryPath) {
+  std::string key = std::filesystem::absolute(directoryPath).lexically_normal().string();
+
+  std::lock_guard<std::mutex> lock{MessageStore::storesMutex};
+
+  std::shared_ptr<MessageStore> store = MessageStore::stores[key].lock();
+  if (!store) {
+    store = std::make_shared<MessageStore>(std::filesystem::path{key} / MessageStore::DIRECTORY_NAME);
+    MessageStore::stores[key] = store;
+  }
+
+  return store;
+}
+
+/**
+ * @brief Get a unique path where an email is written before its hash is known
+ *
+ * @return std::string Path of a temporary file in the store
+ */
+std::string MessageStore::getTemporaryPath() {
+  std::string name = std::to_string(getpid()) + "." + std::to_string(this->temporaryCount++);
+  return (this->storePath / "tmp" / name).string();
+}
+
+/**
+ * @brief Move a written email into the store, unless it is already stored, and link it to its file
+ *
+ * @param temporaryPath Path of the written email
+ * @param hash SHA-256 hash of the email in hex
+ * @param targetPath Path of the file of the email in the output directory
+ */
+void MessageStore::add(std::string temporaryPath, std::string hash, std::string targetPath) {
+  std::filesystem::path objectPath = this->getObjectPath(hash);
+  std::error_code error;
+  std::filesystem::create_directories(objectPath.parent_path(), error);
+
+  if (std::filesystem::exists(objectPath, error)) {
+    std::filesystem::remove(temporaryPath, error);
+  } else {
+    std::filesystem::rename(temporaryPath, objectPath, error);
+    if (error) {
+      throw std::runtime_error("Could not store email " + hash + ".");
+    }
+  }
+
+  MessageStore::linkFile(objectPath, targetPath);
+}
+
+/**
+ * @brief Link an already stored email to its file in the output directory
+ *
+ * @param messageId Message-ID of the email
+ * @param size Size of the email in bytes
+ * @param targetPath Path of the file of the email in the output directory
+ * @return true If the email was linked
+ * @return false If no email with the Message-ID and the size is stored
+ */
+bool MessageStore::link(std::string messageId, std::size_t size, std::string targetPath) {
+  std::string hash;
+  {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    auto entry = this->hashes.find(MessageStore::getKey(messageId, size));
+    if (entry == this->hashes.end()) {
+      return false;
+    }
+    hash = entry->second;
+  }
+
+  // The copy may have been removed from the store by the user
+  std::filesystem::path objectPath = this->getObjectPath(hash);
+  std::error_code error;
+  if (!std::filesystem::exists(objectPath, error)) {
+    return false;
+  }
+
+  MessageStore::linkFile(objectPath, targetPath);
+  return true;
+}
+
+/**
+ * @brief Add a stored email to the index, so it is not downloaded again
+ *
+ * @param messageId Message-ID of the email
+ * @param size Size of the email in bytes
+ * @param hash SHA-256 hash of the email in hex
+ */
+void MessageStore::remember(std::string messageId, std::size_t size, std::string hash) {
+  std::lock_guard<std::mutex> lock{this->mutex};
+  if (this->hashes.emplace(MessageStore::getKey(messageId, size), hash).second) {
+    this->index << hash << " " << size << " " << messageId << "\n";
+  }
+}
+
+/**
+ * @brief Write new entries of the index to its file
+ */
+void MessageStore::flush() {
+  std::lock_guard<std::mutex> lock{this->mutex};
+  this->index.flush();
+}
+
+/**
+ * @brief Get the Message-ID of an email from its header
+ *
+ * @param header Header of the email, the body may follow it
+ * @return std::string Message-ID, e.g. "<id@example.com>", empty if the header does not contain a usable one
+ */
+std::string MessageStore::getMessageId(std::string_view header) {
+  std::string messageId = EmailWriter::getHeaderField(header, "message-id");
+
+  // The index separates entries by whitespace
+  return messageId.find_first_of(" \t") == std::string::npos ? messageId : "";
+}
+
+/**
+ * @brief Get the path of the copy of an email in the store
+ *
+ * @param hash SHA-256 hash of the email in hex
+ * @return std::filesystem::path Path, where the first two digits of the hash name a subdirectory
+ */
+std::filesystem::path MessageStore::getObjectPath(const std::string &hash) {
+  return this->storePath / "objects" / hash.substr(0, 2) / hash.substr(2);
+}
+
+/**
+ * @brief Get the key of an email in the index
+ *
+ * @param messageId Message-ID of the email
+ * @param size Size of the email in bytes, which tells apart different emails with the same Message-ID
+ * @return std::string Key of the email
+ */
+std::string MessageStore::getKey(const std::string &messageId, std::size_t size) {
+  return std::to_string(size) + " " + messageId;
+}
+
+/**
+ * @brief Replace a file in the output directory with a hard link to a stored email
+ *
+ * @param objectPath Path of the stored email
+ * @param targetPath Path of the file in the output directory
+ */
+void MessageStore::linkFile(const std::filesystem::path &objectPath, const std::filesystem::path &targetPath) {
+  std::error_code error;
+  std::filesystem::remove(targetPath, error);
+  std::filesystem::create_hard_link(objectPath, targetPath, error);
+
+  // File systems without hard links and copies with too many links get a separate copy
+  if (error) {
+    error.clear();
+    std::filesystem::copy_file(objectPath, targetPath, std::filesystem::copy_options::overwrite_existing, error);
+    if (error) {
+      throw std::runtime_error("Could not save email to file " + targetPath.string() + ".");
+    }
+  }
+}
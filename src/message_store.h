@@ -0,0 +1,80 @@
+/**
+ * IMAP client
+ *
+ * @file message_store.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef MESSAGE_STORE_H
+#define MESSAGE_STORE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+
+#include <unistd.h>
+
+#include "email_writer.h"
+
+/**
+ * @brief Content-addressed store, which keeps one copy of every distinct email in the output directory
+ *
+ * Emails are saved in .store/objects/ under the SHA-256 hash of their contents and their files in the output directory
+ * are hard links to these copies. An index maps the Message-ID and the size of every full email to its hash, so an
+ * email that was already stored from another mailbox or account is linked without downloading it again. Stores are
+ * shared by all sessions that save emails to the same directory.
+ */
+class MessageStore {
+ public:
+  static inline const std::string DIRECTORY_NAME = ".store";
+
+ protected:
+  /// @brief Guards the open stores
+  static inline std::mutex storesMutex;
+  /// @brief Open stores by the absolute path of the output directory
+  static inline std::map<std::string, std::weak_ptr<MessageStore>> stores;
+
+  /// @brief Path of the store
+  std::filesystem::path storePath;
+  /// @brief Guards the index, sessions on different threads save emails at the same time
+  std::mutex mutex;
+  /// @brief Hashes of stored emails by their size and Message-ID
+  std::unordered_map<std::string, std::string> hashes;
+  /// @brief Index file, where new entries are appended
+  std::ofstream index;
+  /// @brief Number of temporary files created by this process, which makes their names unique
+  std::atomic<unsigned long> temporaryCount{0};
+
+ public:
+  explicit MessageStore(std::filesystem::path storePath);
+
+  MessageStore(const MessageStore &) = delete;
+  MessageStore &operator=(const MessageStore &) = delete;
+
+  static std::shared_ptr<MessageStore> open(std::string directoryPath);
+
+  std::string getTemporaryPath();
+  void add(std::string temporaryPath, std::string hash, std::string targetPath);
+  bool link(std::string messageId, std::size_t size, std::string targetPath);
+  void remember(std::string messageId, std::size_t size, std::string hash);
+  void flush();
+
+  static std::string getMessageId(std::string_view header);
+
+ protected:
+  std::filesystem::path getObjectPath(const std::string &hash);
+  static std::string getKey(const std::string &messageId, std::size_t size);
+  static void linkFile(const std::filesystem::path &objectPath, const std::filesystem::path &targetPath);
+};
+
+#endif
@@ -0,0 +1,240 @@
+/**
+ * IMAP client
+ *
+ * @file partial_download.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include "partial_download.h"
+
+/**
+ * @brief Construct a new PartialDownload object and continue after the part recorded in the journal
+ *
+ * @param directoryPath Path where emails are saved
+ * @param hostname Imap server hostname
+ * @param mailbox Mailbox of the email
+ * @param uidValidity UIDVALIDITY of the mailbox
+ * @param uid UID of the email
+ * @param size Size of the email in bytes
+ */
+PartialDownload::PartialDownload(std::string directoryPath,
+                                 std::string hostname,
+                                 std::string mailbox,
+                                 unsigned long uidValidity,
+                                 unsigned long uid,
+                                 std::size_t size)
+    : uidValidity{uidValidity}, uid{uid}, size{size} {
+  std::filesystem::path partialPath = std::filesystem::path{directoryPath} / PartialDownload::DIRECTORY_NAME;
+  std::filesystem::create_directories(partialPath);
+
+  this->filePath = partialPath / EmailWriter::getFileName(hostname, mailbox, std::to_string(uid));
+  this->journalPath = this->filePath.string() + ".journal";
+  this->loadJournal();
+}
+
+/**
+ * @brief Destroy the PartialDownload object, the received part stays for the next download
+ */
+PartialDownload::~PartialDownload() {
+  if (this->fd >= 0) {
+    close(this->fd);
+  }
+}
+
+/**
+ * @brief Open the file of the received part for a range announced in a FETCH response
+ *
+ * @param line Line text which announces the literal, e.g. "* 1 FETCH (UID 7 FLAGS () BODY[]<0> {42}"
+ * @param size Size of the range in bytes
+ */
+void PartialDownload::beginLiteral(std::string_view line, std::size_t /*size*/) {
+  // Only literals of FETCH responses contain the range
+  if (!EmailWriter::isEmailLiteral(line)) {
+    return;
+  }
+
+  this->fd = open(this->filePath.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0666);
+  if (this->fd < 0) {
+    throw std::runtime_error("Could not open file " + this->filePath.string() + ".");
+  }
+
+  this->line = line;
+  this->rangeLength = 0;
+}
+
+/**
+ * @brief Write a part of the range after the received part of the email
+ *
+ * @param data Part of the range
+ * @param size Size of the part
+ */
+void PartialDownload::writeLiteral(const char *data, std::size_t size) {
+  if (this->fd < 0) {
+    return;
+  }
+
+  while (size > 0) {
+    ssize_t bytes = pwrite(this->fd, data, size, this->offset + this->rangeLength);
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (bytes < 0) {
+      throw std::runtime_error("Could not write email to file.");
+    }
+
+    data += bytes;
+    size -= bytes;
+    this->rangeLength += bytes;
+  }
+}
+
+/**
+ * @brief Synchronize the received range to the disk and record it in the journal
+ *
+ * A range shorter than requested is the last range of the email.
+ */
+void PartialDownload::endLiteral() {
+  if (this->fd < 0) {
+    return;
+  }
+
+  // The journal must never record more than what is on the disk
+  int result = fdatasync(this->fd);
+  result = close(this->fd) < 0 ? -1 : result;
+  this->fd = -1;
+  if (result < 0) {
+    throw std::runtime_error("Could not write email to file.");
+  }
+
+  this->offset += this->rangeLength;
+  this->isFinished = this->rangeLength < this->rangeSize;
+  this->saveJournal();
+}
+
+/**
+ * @brief Get arguments of a UID FETCH command that fetches the next range of the email
+ *
+ * @param rangeSize Size of the range in bytes
+ * @return std::string Command without the tag
+ */
+std::string PartialDownload::getFetchArguments(std::size_t rangeSize) {
+  this->rangeOffset = this->offset;
+  this->rangeSize = rangeSize;
+  return "uid fetch " + std::to_string(this->uid) + " (uid flags body.peek[]<" + std::to_string(this->offset) + "." +
+         std::to_string(rangeSize) + ">)";
+}
+
+/**
+ * @brief Check that the response of the last UID FETCH command contains the requested range
+ *
+ * An empty range is sent as a quoted string instead of a literal, so the email ended at the offset of the range.
+ *
+ * @param response Response of the UID FETCH command
+ * @return true If the server sent the range
+ * @return false If the email is not in the mailbox anymore
+ */
+bool PartialDownload::checkRange(std::string response) {
+  std::transform(response.begin(), response.end(), response.begin(), [](unsigned char c) { return std::tolower(c); });
+  if (response.find("body[]<" + std::to_string(this->rangeOffset) + ">") == std::string::npos) {
+    return false;
+  }
+
+  if (this->offset == this->rangeOffset) {
+    this->isFinished = true;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Check if the whole email was received
+ *
+ * @return true If the whole email was received
+ * @return false If some ranges are missing
+ */
+bool PartialDownload::isComplete() {
+  return this->isFinished;
+}
+
+/**
+ * @brief Pass the received email to a writer and remove its file and journal
+ *
+ * The writer receives the email as one literal announced by a line with the UID and flags of the last received range.
+ *
+ * @param writer Writer which saves the email in the output format
+ */
+void PartialDownload::deliver(EmailWriter &writer) {
+  // Announce the whole email instead of the last range, e.g. "* 1 FETCH (UID 7 FLAGS () BODY[] {42}"
+  std::string lowerCaseLine = this->line;
+  std::transform(lowerCaseLine.begin(), lowerCaseLine.end(), lowerCaseLine.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  std::size_t sectionEnd = lowerCaseLine.rfind("body[]");
+  std::string line = sectionEnd == std::string::npos ? "* 0 FETCH (UID " + std::to_string(this->uid) + " BODY[]"
+                                                     : this->line.substr(0, sectionEnd + 6);
+  line += " {" + std::to_string(this->offset) + "}";
+
+  std::ifstream file{this->filePath, std::ios::binary};
+  if (!file.is_open()) {
+    throw std::runtime_error("Could not open file " + this->filePath.string() + ".");
+  }
+
+  writer.beginLiteral(line, this->offset);
+  char buffer[64 * 1024];
+  std::size_t remaining = this->offset;
+  while (remaining > 0 && file.read(buffer, std::min(remaining, sizeof(buffer)))) {
+    writer.writeLiteral(buffer, file.gcount());
+    remaining -= file.gcount();
+  }
+
+  if (remaining > 0) {
+    throw std::runtime_error("Could not read email from file " + this->filePath.string() + ".");
+  }
+  writer.endLiteral();
+
+  file.close();
+  std::filesystem::remove(this->journalPath);
+  std::filesystem::remove(this->filePath);
+}
+
+/**
+ * @brief Load the length of the received part from the journal
+ *
+ * The part is discarded if the journal belongs to another email, e.g. after UIDVALIDITY changed. Data written after
+ * the last recorded range is cut off.
+ */
+void PartialDownload::loadJournal() {
+  unsigned long uidValidity = 0;
+  unsigned long uid = 0;
+  std::size_t size = 0;
+  std::size_t offset = 0;
+
+  std::ifstream journal{this->journalPath};
+  bool isValid = journal >> uidValidity >> uid >> size >> offset && uidValidity == this->uidValidity &&
+                 uid == this->uid && size == this->size;
+
+  std::error_code error;
+  std::uintmax_t fileSize = std::filesystem::file_size(this->filePath, error);
+  if (error) {
+    return;
+  }
+
+  this->offset = isValid && offset <= fileSize ? offset : 0;
+  std::filesystem::resize_file(this->filePath, this->offset);
+}
+
+/**
+ * @brief Record the length of the received part in the journal
+ *
+ * The journal is replaced by renaming a new file, so it is never partially written.
+ */
+void PartialDownload::saveJournal() {
+  std::string temporaryPath = this->journalPath.string() + ".tmp";
+  std::ofstream journal{temporaryPath, std::ios::trunc};
+  journal << this->uidValidity << " " << this->uid << " " << this->size << " " << this->offset << "\n";
+  journal.close();
+
+  if (!journal || rename(temporaryPath.c_str(), this->journalPath.c_str()) < 0) {
+    throw std::runtime_error("Could not write journal " + this->journalPath.string() + ".");
+  }
+}
@@ -0,0 +1,93 @@
+/**
+ * IMAP client
+ *
+ * @file partial_download.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef PARTIAL_DOWNLOAD_H
+#define PARTIAL_DOWNLOAD_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "email_writer.h"
+#include "literal_sink.h"
+
+/**
+ * @brief Downloads one large email in byte ranges, so an interrupted download resumes from the last received range
+ *
+ * Ranges fetched by BODY.PEEK[]<offset.length> are appended to a file in the .partial directory of the output
+ * directory. After every range the file is synchronized to the disk and its length is recorded in a journal next to
+ * it, together with the UIDVALIDITY, UID and size of the email. A later download of the same email continues after the
+ * recorded length. The size reported by the server is not trusted, ranges are fetched until one is shorter than
+ * requested. The complete email is passed to an email writer like an email received in one literal.
+ */
+class PartialDownload : public LiteralSink {
+ public:
+  static inline const std::string DIRECTORY_NAME = ".partial";
+
+ protected:
+  /// @brief Path of the file with the received part of the email
+  std::filesystem::path filePath;
+  /// @brief Path of the journal with the length of the received part
+  std::filesystem::path journalPath;
+  /// @brief UIDVALIDITY of the mailbox of the email
+  unsigned long uidValidity;
+  /// @brief UID of the email
+  unsigned long uid;
+  /// @brief Size of the email in bytes reported by the server, the received email may differ
+  std::size_t size;
+  /// @brief Number of bytes received and recorded in the journal
+  std::size_t offset{0};
+  /// @brief Represents if the server sent the last range of the email
+  bool isFinished{false};
+
+  /// @brief Offset of the requested range
+  std::size_t rangeOffset{0};
+  /// @brief Size of the requested range in bytes
+  std::size_t rangeSize{0};
+
+  /// @brief Line which announced the last received range
+  std::string line;
+  /// @brief File of the received part while a range is being written, -1 otherwise
+  int fd{-1};
+  /// @brief Number of bytes of the current range that were written
+  std::size_t rangeLength{0};
+
+ public:
+  PartialDownload(std::string directoryPath,
+                  std::string hostname,
+                  std::string mailbox,
+                  unsigned long uidValidity,
+                  unsigned long uid,
+                  std::size_t size);
+  ~PartialDownload() override;
+
+  void beginLiteral(std::string_view line, std::size_t size) override;
+  void writeLiteral(const char *data, std::size_t size) override;
+  void endLiteral() override;
+
+  std::string getFetchArguments(std::size_t rangeSize);
+  bool checkRange(std::string response);
+  bool isComplete();
+  void deliver(EmailWriter &writer);
+
+ protected:
+  void loadJournal();
+  void saveJournal();
+};
+
+#endif
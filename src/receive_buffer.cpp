@@ -0,0 +1,136 @@
+/**
+ * IMAP client
+ *
+ * @file receive_buffer.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include "receive_buffer.h"
+
+/**
+ * @brief Construct a new ReceiveBuffer object
+ *
+ * @param readSize Minimum free space offered to a single read
+ */
+ReceiveBuffer::ReceiveBuffer(std::size_t readSize) : readSize{readSize} {}
+
+/**
+ * @brief Make room for the next read
+ *
+ * The memory is allocated on the first read and grows only if the unconsumed data does not leave enough free space.
+ *
+ * @return char* Start of the free space, which has at least the read size
+ */
+char *ReceiveBuffer::prepare() {
+  if (this->getWritableSize() >= this->readSize) {
+    return this->buffer.get() + this->writePosition;
+  }
+
+  std::size_t size = this->getSize();
+  if (size + this->readSize <= this->capacity) {
+    // Move the unconsumed data to the start of the buffer
+    std::memmove(this->buffer.get(), this->buffer.get() + this->readPosition, size);
+  } else {
+    std::size_t capacity = std::max(this->capacity * 2, size + this->readSize);
+    std::unique_ptr<char[]> buffer = std::make_unique_for_overwrite<char[]>(capacity);
+    if (size > 0) {
+      std::memcpy(buffer.get(), this->buffer.get() + this->readPosition, size);
+    }
+
+    this->buffer = std::move(buffer);
+    this->capacity = capacity;
+  }
+
+  this->readPosition = 0;
+  this->writePosition = size;
+
+  return this->buffer.get() + this->writePosition;
+}
+
+/**
+ * @brief Get the size of the free space after prepare
+ *
+ * @return std::size_t Size of the free space in bytes
+ */
+std::size_t ReceiveBuffer::getWritableSize() const {
+  return this->capacity - this->writePosition;
+}
+
+/**
+ * @brief Add bytes that were read into the free space to the buffered data
+ *
+ * @param count Number of bytes that were read
+ */
+void ReceiveBuffer::commit(std::size_t count) {
+  this->writePosition += count;
+}
+
+/**
+ * @brief Get the unconsumed data
+ *
+ * @return const char* Start of the unconsumed data
+ */
+const char *ReceiveBuffer::getData() const {
+  return this->buffer.get() + this->readPosition;
+}
+
+/**
+ * @brief Get the size of the unconsumed data
+ *
+ * @return std::size_t Size of the unconsumed data in bytes
+ */
+std::size_t ReceiveBuffer::getSize() const {
+  return this->writePosition - this->readPosition;
+}
+
+/**
+ * @brief Check if all data was consumed
+ *
+ * @return true If all data was consumed
+ * @return false If some data was not consumed
+ */
+bool ReceiveBuffer::isEmpty() const {
+  return this->readPosition == this->writePosition;
+}
+
+/**
+ * @brief Get the unconsumed data as a view
+ *
+ * @return std::string_view Unconsumed data, valid until the next prepare
+ */
+std::string_view ReceiveBuffer::getView() const {
+  return {this->getData(), this->getSize()};
+}
+
+/**
+ * @brief Remove data from the start of the buffer
+ *
+ * @param count Number of consumed bytes
+ */
+void ReceiveBuffer::consume(std::size_t count) {
+  this->readPosition += count;
+
+  // Reuse the whole buffer once everything was consumed
+  if (this->readPosition == this->writePosition) {
+    this->readPosition = 0;
+    this->writePosition = 0;
+  }
+}
+
+/**
+ * @brief Get the minimum free space offered to a single read
+ *
+ * @return std::size_t Read size in bytes
+ */
+std::size_t ReceiveBuffer::getReadSize() const {
+  return this->readSize;
+}
+
+/**
+ * @brief Set the minimum free space offered to a single read
+ *
+ * @param readSize Read size in bytes
+ */
+void ReceiveBuffer::setReadSize(std::size_t readSize) {
+  this->readSize = std::max<std::size_t>(readSize, 1);
+}
@@ -0,0 +1,57 @@
+/**
+ * IMAP client
+ *
+ * @file receive_buffer.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef RECEIVE_BUFFER_H
+#define RECEIVE_BUFFER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string_view>
+
+/**
+ * @brief Persistent buffer for data received from the server
+ *
+ * Data is read directly into free space at the end of the buffer and handed to the parser from where it was read.
+ * Consumed space at the start is reclaimed by moving the unconsumed remainder, which is usually a part of one line, so
+ * the unconsumed data always stays contiguous.
+ */
+class ReceiveBuffer {
+ public:
+  static const std::size_t DEFAULT_READ_SIZE = 64 * 1024;
+
+ protected:
+  /// @brief Memory of the buffer
+  std::unique_ptr<char[]> buffer;
+  /// @brief Size of the memory of the buffer
+  std::size_t capacity{0};
+  /// @brief Position of the first unconsumed byte
+  std::size_t readPosition{0};
+  /// @brief Position after the last received byte
+  std::size_t writePosition{0};
+  /// @brief Minimum free space offered to a single read
+  std::size_t readSize;
+
+ public:
+  explicit ReceiveBuffer(std::size_t readSize = ReceiveBuffer::DEFAULT_READ_SIZE);
+
+  char *prepare();
+  std::size_t getWritableSize() const;
+  void commit(std::size_t count);
+
+  const char *getData() const;
+  std::size_t getSize() const;
+  bool isEmpty() const;
+  std::string_view getView() const;
+  void consume(std::size_t count);
+
+  std::size_t getReadSize() const;
+  void setReadSize(std::size_t readSize);
+};
+
+#endif
@@ -0,0 +1,93 @@
+/**
+ * IMAP client
+ *
+ * @file recording_connection.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include "recording_connection.h"
+
+/**
+ * @brief Construct a new RecordingConnection object
+ *
+ * @param connection Connection to the server, from which nothing was received yet
+ * @param tracePath Path to the trace file, which is overwritten
+ */
+RecordingConnection::RecordingConnection(std::unique_ptr<Connection> connection, std::string tracePath)
+    : connection{std::move(connection)},
+      trace{tracePath, std::ios::binary | std::ios::trunc},
+      startTime{std::chrono::steady_clock::now()} {
+  this->trace << RecordingConnection::TRACE_HEADER << "\n";
+  if (!this->trace) {
+    throw std::runtime_error("Could not create trace file " + tracePath + ".");
+  }
+}
+
+/**
+ * @brief Destroy the RecordingConnection object and close the recorded connection
+ */
+RecordingConnection::~RecordingConnection() {
+  // SSLConnection closes its socket when it is destroyed, TCPConnection does not
+  TCPConnection *tcpConnection = dynamic_cast<TCPConnection *>(this->connection.get());
+  if (tcpConnection != nullptr && dynamic_cast<SSLConnection *>(tcpConnection) == nullptr) {
+    tcpConnection->closeConnection();
+  }
+}
+
+/**
+ * @brief Get the file descriptor of the recorded connection
+ *
+ * @return int Socket file descriptor
+ */
+int RecordingConnection::getFd() {
+  return this->connection->getFd();
+}
+
+/**
+ * @brief Send data to the server and record its size
+ *
+ * @param data Data to send
+ */
+void RecordingConnection::writeData(std::string data) {
+  this->writeRecord('S', data.length());
+  this->connection->writeData(std::move(data));
+}
+
+/**
+ * @brief Receive data from the server and record it
+ *
+ * @param buffer Buffer for received data
+ * @param size Size of buffer
+ * @return std::size_t Number of received bytes
+ */
+std::size_t RecordingConnection::readSome(char *buffer, std::size_t size) {
+  std::size_t bytes = this->connection->readSome(buffer, size);
+  this->writeRecord('R', bytes);
+  this->trace.write(buffer, bytes);
+
+  return bytes;
+}
+
+/**
+ * @brief Check if the recorded connection holds received data that is not visible on the socket
+ *
+ * @return true If data is buffered
+ * @return false If no data is buffered
+ */
+bool RecordingConnection::hasBufferedData() {
+  return this->connection->hasBufferedData();
+}
+
+/**
+ * @brief Write the line which starts a record
+ *
+ * @param direction 'S' for sent data, 'R' for received data
+ * @param size Size of the data in bytes
+ */
+void RecordingConnection::writeRecord(char direction, std::size_t size) {
+  auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->startTime);
+  this->trace << direction << " " << time.count() << " " << size << "\n";
+  if (!this->trace) {
+    throw std::runtime_error("Could not write trace file.");
+  }
+}
@@ -0,0 +1,57 @@
+/**
+ * IMAP client
+ *
+ * @file recording_connection.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef RECORDING_CONNECTION_H
+#define RECORDING_CONNECTION_H
+
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "connection.h"
+#include "ssl_connection.h"
+#include "tcp_connection.h"
+
+/**
+ * @brief Connection which records the data of another connection to a trace file, so the session can be replayed
+ *
+ * The trace starts with the line "imapcl-trace 1". Every read from the server is recorded as the line
+ * "R <nanoseconds> <size>" followed by the received bytes and every write as the line "S <nanoseconds> <size>", where
+ * nanoseconds are counted from the creation of the connection. Only the size of sent data is recorded, so the trace
+ * contains no credentials. Bytes are recorded below compression and above TLS, as the parser gets them before
+ * decompression.
+ */
+class RecordingConnection : public Connection {
+ public:
+  /// @brief First line of a trace file
+  static constexpr const char *TRACE_HEADER = "imapcl-trace 1";
+
+ protected:
+  /// @brief Recorded connection to the server
+  std::unique_ptr<Connection> connection;
+  /// @brief Trace file
+  std::ofstream trace;
+  /// @brief Time when the recording started
+  std::chrono::steady_clock::time_point startTime;
+
+ public:
+  RecordingConnection(std::unique_ptr<Connection> connection, std::string tracePath);
+  ~RecordingConnection() override;
+
+  int getFd() override;
+
+ protected:
+  void writeData(std::string data) override;
+  std::size_t readSome(char *buffer, std::size_t size) override;
+  bool hasBufferedData() override;
+
+  void writeRecord(char direction, std::size_t size);
+};
+
+#endif
@@ -0,0 +1,145 @@
+/**
+ * IMAP client
+ *
+ * @file replay_connection.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include "replay_connection.h"
+
+/**
+ * @brief Construct a new ReplayConnection object
+ *
+ * @param tracePath Path to a trace file written by RecordingConnection
+ * @param usingDelays Represents if reads wait as long after the preceding write as they did during the recording,
+ * which reproduces a slow server, otherwise all data is received immediately
+ */
+ReplayConnection::ReplayConnection(std::string tracePath, bool usingDelays) : usingDelays{usingDelays} {
+  this->load(tracePath);
+
+  this->startTime = std::chrono::steady_clock::now();
+  this->lastSendReplayTime = this->startTime;
+}
+
+/**
+ * @brief Get the file descriptor of the connection
+ *
+ * @return int Always -1, the connection has no socket
+ */
+int ReplayConnection::getFd() {
+  return -1;
+}
+
+/**
+ * @brief Discard data sent to the "server" and check that it matches the next recorded write
+ *
+ * @param data Data to send
+ */
+void ReplayConnection::writeData(std::string data) {
+  while (this->sendIndex < this->records.size() && !this->records[this->sendIndex].isSent) {
+    this->sendIndex++;
+  }
+
+  if (this->sendIndex >= this->records.size() || this->records[this->sendIndex].size != data.length()) {
+    throw std::runtime_error("Replayed session does not match the trace, client sent different data.");
+  }
+
+  this->lastSendTime = this->records[this->sendIndex].time;
+  this->lastSendReplayTime = std::chrono::steady_clock::now();
+  this->sendIndex++;
+}
+
+/**
+ * @brief Receive the next recorded read, or its rest if it did not fit into the previous buffer
+ *
+ * @param buffer Buffer for received data
+ * @param size Size of buffer
+ * @return std::size_t Number of received bytes
+ */
+std::size_t ReplayConnection::readSome(char *buffer, std::size_t size) {
+  std::size_t index = this->findReceived();
+  if (index >= this->records.size()) {
+    throw std::runtime_error("Could not receive data from server.");
+  }
+  if (this->records[index].isSent) {
+    throw std::runtime_error("Replayed session does not match the trace, client waits for data before sending.");
+  }
+
+  // The server answered the preceding write after the recorded delay
+  const Record &record = this->records[index];
+  if (this->usingDelays && this->receiveOffset == 0) {
+    std::this_thread::sleep_until(this->lastSendReplayTime + (record.time - this->lastSendTime));
+  }
+
+  std::size_t count = std::min(size, record.size - this->receiveOffset);
+  memcpy(buffer, this->data.data() + record.offset + this->receiveOffset, count);
+  this->receiveOffset += count;
+
+  this->receiveIndex = index;
+  if (this->receiveOffset == record.size) {
+    this->receiveIndex++;
+    this->receiveOffset = 0;
+  }
+
+  return count;
+}
+
+/**
+ * @brief Check if the next record can be received without the client sending anything
+ *
+ * @return true If data can be received
+ * @return false If the client must send data first or the trace ended
+ */
+bool ReplayConnection::hasBufferedData() {
+  std::size_t index = this->findReceived();
+  return index < this->records.size() && !this->records[index].isSent;
+}
+
+/**
+ * @brief Find the next record to receive, skipping writes that were already replayed
+ *
+ * @return std::size_t Index of a received record, of a write that was not replayed yet, or the number of records
+ */
+std::size_t ReplayConnection::findReceived() {
+  std::size_t index = this->receiveIndex;
+  while (index < this->records.size() && this->records[index].isSent && index < this->sendIndex) {
+    index++;
+  }
+
+  return index;
+}
+
+/**
+ * @brief Load all records of a trace file
+ *
+ * @param tracePath Path to the trace file
+ */
+void ReplayConnection::load(std::string tracePath) {
+  std::ifstream trace{tracePath, std::ios::binary};
+  std::string line;
+  if (!std::getline(trace, line) || line != RecordingConnection::TRACE_HEADER) {
+    throw std::runtime_error("Could not read trace file " + tracePath + ".");
+  }
+
+  char direction;
+  long long time;
+  std::size_t size;
+  while (trace >> direction >> time >> size && trace.get() == '\n') {
+    if (direction != 'S' && direction != 'R') {
+      throw std::runtime_error("Invalid record in trace file " + tracePath + ".");
+    }
+
+    Record record{direction == 'S', std::chrono::nanoseconds{time}, this->data.length(), size};
+    if (!record.isSent) {
+      this->data.resize(this->data.length() + size);
+      if (!trace.read(this->data.data() + record.offset, size)) {
+        throw std::runtime_error("Trace file " + tracePath + " is truncated.");
+      }
+    }
+    this->records.push_back(record);
+  }
+
+  if (!trace.eof()) {
+    throw std::runtime_error("Invalid record in trace file " + tracePath + ".");
+  }
+}
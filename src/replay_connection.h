@@ -0,0 +1,80 @@
+/**
+ * IMAP client
+ *
+ * @file replay_connection.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef REPLAY_CONNECTION_H
+#define REPLAY_CONNECTION_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "connection.h"
+#include "recording_connection.h"
+
+/**
+ * @brief Connection which receives the data of a session recorded by RecordingConnection instead of a server
+ *
+ * Every read returns at most one recorded read, so the client gets the data split as it was received. Sent data is
+ * discarded, but its size must match the recorded write, otherwise the client did not repeat the recorded session.
+ * The whole trace is loaded when the connection is created, so replaying does not read the disk.
+ */
+class ReplayConnection : public Connection {
+ protected:
+  /// @brief One recorded read or write
+  struct Record {
+    /// @brief Represents if the data was sent, otherwise it was received
+    bool isSent;
+    /// @brief Time of the record since the recording started
+    std::chrono::nanoseconds time;
+    /// @brief Position of received data in data
+    std::size_t offset;
+    /// @brief Size of the data in bytes
+    std::size_t size;
+  };
+
+  /// @brief Recorded reads and writes in the order they happened
+  std::vector<Record> records;
+  /// @brief Received data of all reads
+  std::string data;
+  /// @brief Index of the next record that is received
+  std::size_t receiveIndex{0};
+  /// @brief Number of bytes of the next received record that were already received
+  std::size_t receiveOffset{0};
+  /// @brief Index of the next record that is sent
+  std::size_t sendIndex{0};
+
+  /// @brief Represents if reads wait as long after the preceding write as they did during the recording
+  bool usingDelays;
+  /// @brief Time when replaying started
+  std::chrono::steady_clock::time_point startTime;
+  /// @brief Recorded time of the last replayed write
+  std::chrono::nanoseconds lastSendTime{0};
+  /// @brief Time when the last write was replayed
+  std::chrono::steady_clock::time_point lastSendReplayTime;
+
+ public:
+  ReplayConnection(std::string tracePath, bool usingDelays = false);
+  ~ReplayConnection() override = default;
+
+  int getFd() override;
+
+ protected:
+  void writeData(std::string data) override;
+  std::size_t readSome(char *buffer, std::size_t size) override;
+  bool hasBufferedData() override;
+
+  void load(std::string tracePath);
+  std::size_t findReceived();
+};
+
+#endif
@@ -0,0 +1,169 @@
+/**
+ * IMAP client
+ *
+ * @file response_framer.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include "response_framer.h"
+
+/**
+ * @brief Process data received from the server
+ *
+ * Consumes either the contents of a literal or line text up to the next line break, so the caller can tell literal
+ * bytes apart from line text. Stops right after the end of a complete line or a literal announcement.
+ *
+ * @param data Received data
+ * @param size Size of received data
+ * @return std::size_t Number of bytes consumed from data
+ */
+std::size_t ResponseFramer::feed(const char *data, std::size_t size) {
+  if (this->lineComplete) {
+    return 0;
+  }
+
+  if (this->state == State::LITERAL) {
+    // Skip over the contents of the literal
+    std::size_t count = std::min(this->literalRemaining, size);
+    this->literalRemaining -= count;
+
+    if (this->literalRemaining == 0) {
+      this->state = State::LINE;
+    }
+    return count;
+  }
+
+  if (this->isSegmentComplete) {
+    this->segment.clear();
+    this->isSegmentComplete = false;
+  }
+
+  // Find the end of the current segment
+  const char *lineEnd = static_cast<const char *>(memchr(data, '\n', size));
+  if (lineEnd == nullptr) {
+    this->segment.append(data, size);
+    return size;
+  }
+
+  std::size_t count = lineEnd - data + 1;
+  this->segment.append(data, count);
+  this->isSegmentComplete = true;
+  this->lineComplete = this->endSegment();
+
+  return count;
+}
+
+/**
+ * @brief Check if a complete line was framed
+ *
+ * @return true If a complete line was framed
+ * @return false If more data is needed
+ */
+bool ResponseFramer::isLineComplete() const {
+  return this->lineComplete;
+}
+
+/**
+ * @brief Check if the framed line is a tagged response
+ *
+ * @return true If the line is a tagged response
+ * @return false If the line is an untagged response or a continuation request
+ */
+bool ResponseFramer::isTagged() const {
+  return this->tag != "*" && this->tag != "+";
+}
+
+/**
+ * @brief Get the tag of the framed line
+ *
+ * @return std::string_view Tag of the line
+ */
+std::string_view ResponseFramer::getTag() const {
+  return this->tag;
+}
+
+/**
+ * @brief Check if the next bytes fed to the framer are the contents of a literal
+ *
+ * @return true If reading a literal
+ * @return false If reading line text
+ */
+bool ResponseFramer::isReadingLiteral() const {
+  return this->state == State::LITERAL;
+}
+
+/**
+ * @brief Get the size of the last announced literal
+ *
+ * @return std::size_t Size of the literal in bytes
+ */
+std::size_t ResponseFramer::getLiteralSize() const {
+  return this->literalSize;
+}
+
+/**
+ * @brief Get the text of the last segment without the line break
+ *
+ * @return std::string_view Segment text, which announces the literal when reading a literal
+ */
+std::string_view ResponseFramer::getSegment() const {
+  std::string_view text{this->segment};
+  if (this->isSegmentComplete) {
+    text.remove_suffix(text.ends_with("\r\n") ? 2 : 1);
+  }
+
+  return text;
+}
+
+/**
+ * @brief Start framing the next line
+ */
+void ResponseFramer::nextLine() {
+  this->segment.clear();
+  this->isSegmentComplete = false;
+  this->tag.clear();
+  this->isFirstSegment = true;
+  this->lineComplete = false;
+}
+
+/**
+ * @brief Handle a segment that ends with a line break
+ *
+ * @return true If the segment completes a line
+ * @return false If the segment is followed by a literal
+ */
+bool ResponseFramer::endSegment() {
+  std::string_view text = this->getSegment();
+
+  if (this->isFirstSegment) {
+    this->tag = text.substr(0, text.find_first_of(' '));
+    this->isFirstSegment = false;
+  }
+
+  // Check if the segment announces a literal
+  if (!text.ends_with('}')) {
+    return true;
+  }
+
+  std::size_t literalStart = text.find_last_of('{');
+  if (literalStart == std::string_view::npos) {
+    return true;
+  }
+
+  std::string_view size = text.substr(literalStart + 1, text.length() - literalStart - 2);
+  if (size.ends_with('+')) {
+    size.remove_suffix(1);
+  }
+  if (size.empty() || size.find_first_not_of("0123456789") != std::string_view::npos) {
+    return true;
+  }
+
+  this->literalSize = 0;
+  for (char digit : size) {
+    this->literalSize = this->literalSize * 10 + (digit - '0');
+  }
+  this->literalRemaining = this->literalSize;
+  this->state = State::LITERAL;
+
+  return false;
+}
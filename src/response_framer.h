@@ -0,0 +1,62 @@
+/**
+ * IMAP client
+ *
+ * @file response_framer.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef RESPONSE_FRAMER_H
+#define RESPONSE_FRAMER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Incrementally splits data received from an imap server into response lines
+ *
+ * Every received byte is inspected only once. Literals ({N}) are skipped over by their byte count, so their contents
+ * are never mistaken for the end of a response.
+ */
+class ResponseFramer {
+ protected:
+  /// @brief Represents whether the framer is reading line text or the contents of a literal
+  enum class State { LINE, LITERAL };
+
+  /// @brief Current state of the framer
+  State state{State::LINE};
+  /// @brief Text of the current line since the last line break or literal
+  std::string segment;
+  /// @brief Represents if the segment ended with a line break
+  bool isSegmentComplete{false};
+  /// @brief Tag of the current line
+  std::string tag;
+  /// @brief Represents if the current segment is the first segment of a line
+  bool isFirstSegment{true};
+  /// @brief Size of the last announced literal
+  std::size_t literalSize{0};
+  /// @brief Number of literal bytes that have not been received yet
+  std::size_t literalRemaining{0};
+  /// @brief Represents if a complete line was framed
+  bool lineComplete{false};
+
+ public:
+  std::size_t feed(const char *data, std::size_t size);
+
+  bool isLineComplete() const;
+  bool isTagged() const;
+  std::string_view getTag() const;
+
+  bool isReadingLiteral() const;
+  std::size_t getLiteralSize() const;
+  std::string_view getSegment() const;
+
+  void nextLine();
+
+ protected:
+  bool endSegment();
+};
+
+#endif
@@ -19,86 +19,26 @@ SSLConnection::SSLConnection(std::string hostname,
                              uint16_t port,
                              std::string certificateFile,
                              std::string certificatesFolderPath)
-    : TCPConnection{hostname, port} {
-  // Initialize openssl library
-  SSL_load_error_strings();
-  OpenSSL_add_all_algorithms();
-
-  // Setup ssl context
-  this->ctx = SSL_CTX_new(SSLv23_client_method());
-  if (this->ctx == nullptr) {
-    throw std::runtime_error("Could not create ssl context.");
-  }
-
-  // Laod trust certificate store used for validating certificates
-  if (!SSL_CTX_load_verify_locations(this->ctx, certificateFile.empty() ? nullptr : certificateFile.c_str(),
-                                     certificatesFolderPath.empty()
-                                         ? SSLConnection::DEFAULT_CERTIFICATES_FOLDER_PATH.c_str()
-                                         : certificatesFolderPath.c_str())) {
-    throw std::runtime_error("Could not verify certificates folder.");
-  }
-
-  this->ssl = SSL_new(this->ctx);
-  SSL_set_mode(this->ssl, SSL_MODE_AUTO_RETRY);
-
-  // Set file descriptor used in unsecure connection
-  if (SSL_set_fd(this->ssl, this->clientSocket) <= 0) {
-    throw std::runtime_error("Could not create ssl connection to server from existing socket.");
-  }
-
-  if (SSL_connect(this->ssl) <= 0) {
-    throw std::runtime_error("Could not connect perform SSL handshake.");
-  }
-
-  // Check if the certificate sent from the server is valid
-  if (SSL_get_verify_result(this->ssl) != X509_V_OK) {
-    throw std::runtime_error("Certificate sent from the server is not valid.");
-  }
+    : TCPConnection{hostname, port}, sessionKey{hostname + ":" + std::to_string(port)} {
+  this->handshake(certificateFile, certificatesFolderPath);
 }
 
 /**
  * @brief Construct a new SSLConnection object
  *
  * @param fd Socket file descriptror
+ * @param hostname Server hostname
+ * @param port Server port
  * @param certificateFile Path to a certificate file used for validating ssl/tls certificate
  * @param certificatesFolderPath Path to a folder which is used for validating ssl/tls certificates
  */
-SSLConnection::SSLConnection(int fd, std::string certificateFile, std::string certificatesFolderPath)
-    : TCPConnection{fd} {
-  // Initialize openssl library
-  SSL_load_error_strings();
-  OpenSSL_add_all_algorithms();
-
-  // Setup ssl context
-  this->ctx = SSL_CTX_new(SSLv23_client_method());
-  if (this->ctx == nullptr) {
-    throw std::runtime_error("Could not create ssl context.");
-  }
-
-  // Laod trust certificate store used for validating certificates
-  if (!SSL_CTX_load_verify_locations(this->ctx, certificateFile.empty() ? nullptr : certificateFile.c_str(),
-                                     certificatesFolderPath.empty()
-                                         ? SSLConnection::DEFAULT_CERTIFICATES_FOLDER_PATH.c_str()
-                                         : certificatesFolderPath.c_str())) {
-    throw std::runtime_error("Could not verify certificates folder.");
-  }
-
-  this->ssl = SSL_new(this->ctx);
-  SSL_set_mode(this->ssl, SSL_MODE_AUTO_RETRY);
-
-  // Set file descriptor used in unsecure connection
-  if (SSL_set_fd(this->ssl, fd) <= 0) {
-    throw std::runtime_error("Could not create ssl connection to server from existing socket.");
-  }
-
-  if (SSL_connect(this->ssl) <= 0) {
-    throw std::runtime_error("Could not connect perform SSL handshake.");
-  }
-
-  // Check if the certificate sent from the server is valid
-  if (SSL_get_verify_result(this->ssl) != X509_V_OK) {
-    throw std::runtime_error("Certificate sent from the server is not valid.");
-  }
+SSLConnection::SSLConnection(int fd,
+                             std::string hostname,
+                             uint16_t port,
+                             std::string certificateFile,
+                             std::string certificatesFolderPath)
+    : TCPConnection{fd}, sessionKey{hostname + ":" + std::to_string(port)} {
+  this->handshake(certificateFile, certificatesFolderPath);
 }
 
 /**
@@ -117,55 +57,86 @@ SSLConnection::~SSLConnection() {
 }
 
 /**
- * @brief Send an imap command to the server
+ * @brief Send data to the server
  *
- * @param tag Command tag
- * @param command Command to send
- * @return std::string Response from the server
+ * @param data Data to send
  */
-std::string SSLConnection::sendCommand(unsigned int tag, std::string command) {
-  // Send command to server
-  int bytes = SSL_write(this->ssl, command.data(), command.size());
+void SSLConnection::writeData(std::string data) {
+  int bytes = SSL_write(this->ssl, data.data(), data.size());
   if (bytes < 0) {
     throw std::runtime_error("Could not send command to server.");
   }
-
-  // Get response from server
-  std::string response = this->receive();
-  while (!this->isResponseFull(response, tag)) {
-    // Receive more data because the response is not complete
-    response.append(this->receive());
-  }
-
-  return response;
 }
 
 /**
  * @brief Receive data from the server
  *
- * @return std::string Received data
+ * Decrypted data that is already buffered by OpenSSL is added too, so one read is not limited to one TLS record.
+ *
+ * @param buffer Buffer for received data
+ * @param size Size of buffer
+ * @return std::size_t Number of received bytes
  */
-std::string SSLConnection::receive() {
-  std::string response;
-  std::string buffer;
-
-  // Receive data until it ends in "\r\n"
-  // "\r\n" possibly indicates end of a response
-  while (true) {
-    buffer.resize(1500);
+std::size_t SSLConnection::readSome(char *buffer, std::size_t size) {
+  std::size_t received = 0;
 
-    // Receive data from socket
-    long bytes = SSL_read(this->ssl, &buffer[0], buffer.size());
+  do {
+    int bytes = SSL_read(this->ssl, buffer + received, std::min<std::size_t>(size - received, INT_MAX));
     if (bytes <= 0) {
       throw std::runtime_error("Could not receive data from server.");
     }
 
-    // Add received data to buffer
-    response.append(buffer.substr(0, bytes));
-    if (response.ends_with("\r\n")) {
-      break;
-    }
+    received += bytes;
+  } while (received < size && SSL_pending(this->ssl) > 0);
+
+  return received;
+}
+
+/**
+ * @brief Check if decrypted data is buffered by OpenSSL
+ *
+ * @return true If data is buffered
+ * @return false If no data is buffered
+ */
+bool SSLConnection::hasBufferedData() {
+  return SSL_pending(this->ssl) > 0;
+}
+
+/**
+ * @brief Perform the ssl handshake on the connected socket
+ *
+ * @param certificateFile Path to a certificate file used for validating ssl/tls certificate
+ * @param certificatesFolderPath Path to a folder which is used for validating ssl/tls certificates
+ */
+void SSLConnection::handshake(std::string certificateFile, std::string certificatesFolderPath) {
+  // Use the shared ssl context, whose trust store is already loaded
+  this->ctx = SSLContext::acquire(certificateFile, certificatesFolderPath);
+
+  this->ssl = SSL_new(this->ctx);
+  SSL_set_mode(this->ssl, SSL_MODE_AUTO_RETRY);
+
+  // Offer the session of the previous connection to this server, so the server can skip the full handshake
+  SSLSessionCache::offer(this->ssl, &this->sessionKey);
+
+  // Set file descriptor used in unsecure connection
+  if (SSL_set_fd(this->ssl, this->clientSocket) <= 0) {
+    throw std::runtime_error("Could not create ssl connection to server from existing socket.");
+  }
+
+  auto handshakeStartTime = std::chrono::steady_clock::now();
+  if (SSL_connect(this->ssl) <= 0) {
+    throw std::runtime_error("Could not connect perform SSL handshake.");
+  }
+
+  if (CommandStats::isEnabled()) {
+    CommandStats::recordHandshake(std::chrono::steady_clock::now() - handshakeStartTime);
+  }
+
+  // Check if the certificate sent from the server is valid
+  if (SSL_get_verify_result(this->ssl) != X509_V_OK) {
+    throw std::runtime_error("Certificate sent from the server is not valid.");
   }
 
-  return response;
+  SSLSessionCache::report(this->ssl);
+  SSLContext::checkKernelTls(this->ssl);
 }
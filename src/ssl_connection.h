@@ -8,6 +8,7 @@
 #ifndef SSL_CONNECTION_H
 #define SSL_CONNECTION_H
 
+#include <climits>
 #include <cstdint>
 #include <iostream>
 #include <stdexcept>
@@ -18,26 +19,36 @@
 #include "openssl/ssl.h"
 
 #include "connection.h"
+#include "ssl_context.h"
 #include "tcp_connection.h"
 
 /**
  * @brief Represents a ssl connection to an imap server
  */
 class SSLConnection : public TCPConnection {
- public:
-  const std::string DEFAULT_CERTIFICATES_FOLDER_PATH = "/etc/ssl/certs";
-
  protected:
-  SSL_CTX *ctx;
-  SSL *ssl;
+  /// @brief Shared ssl context
+  SSL_CTX *ctx{nullptr};
+  /// @brief Ssl connection
+  SSL *ssl{nullptr};
+  /// @brief Host:port of the server, which identifies its cached tls session
+  std::string sessionKey;
 
  public:
   SSLConnection(std::string hostname, uint16_t port, std::string certificateFile, std::string certificatesFolderPath);
-  SSLConnection(int fd, std::string certificateFile, std::string certificatesFolderPath);
+  SSLConnection(int fd,
+                std::string hostname,
+                uint16_t port,
+                std::string certificateFile,
+                std::string certificatesFolderPath);
   ~SSLConnection() override;
 
-  std::string sendCommand(unsigned int tag, std::string command) override;
-  std::string receive() override;
+ protected:
+  void writeData(std::string data) override;
+  std::size_t readSome(char *buffer, std::size_t size) override;
+  bool hasBufferedData() override;
+
+  void handshake(std::string certificateFile, std::string certificatesFolderPath);
 };
 
 #endif
@@ -0,0 +1,90 @@
+/**
+ * IMAP client
+ *
+ * @file ssl_context.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include "ssl_context.h"
+
+/**
+ * @brief Get a shared ssl context with a trust store, which is created on the first use
+ *
+ * @param certificateFile Path to a certificate file used for validating ssl/tls certificate
+ * @param certificatesFolderPath Path to a folder which is used for validating ssl/tls certificates
+ * @return SSL_CTX* Ssl context with a new reference owned by the caller
+ */
+SSL_CTX *SSLContext::acquire(std::string certificateFile, std::string certificatesFolderPath) {
+  if (certificatesFolderPath.empty()) {
+    certificatesFolderPath = SSLContext::DEFAULT_CERTIFICATES_FOLDER_PATH;
+  }
+
+  std::lock_guard<std::mutex> lock{SSLContext::mutex};
+
+  SSL_CTX *&ctx = SSLContext::contexts[{certificateFile, certificatesFolderPath}];
+  if (ctx == nullptr) {
+    ctx = SSLContext::create(certificateFile, certificatesFolderPath);
+  }
+
+  SSL_CTX_up_ref(ctx);
+  return ctx;
+}
+
+/**
+ * @brief Create a ssl context and load its trust store
+ *
+ * @param certificateFile Path to a certificate file used for validating ssl/tls certificate
+ * @param certificatesFolderPath Path to a folder which is used for validating ssl/tls certificates
+ * @return SSL_CTX* New ssl context
+ */
+SSL_CTX *SSLContext::create(const std::string &certificateFile, const std::string &certificatesFolderPath) {
+  // Initialize openssl library
+  SSL_load_error_strings();
+  OpenSSL_add_all_algorithms();
+
+  // Setup ssl context
+  SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+  if (ctx == nullptr) {
+    throw std::runtime_error("Could not create ssl context.");
+  }
+
+  // Laod trust certificate store used for validating certificates
+  if (!SSL_CTX_load_verify_locations(ctx, certificateFile.empty() ? nullptr : certificateFile.c_str(),
+                                     certificatesFolderPath.c_str())) {
+    SSL_CTX_free(ctx);
+    throw std::runtime_error("Could not verify certificates folder.");
+  }
+
+  SSLSessionCache::setupContext(ctx);
+
+  // OpenSSL falls back to encryption in user space by itself if the kernel or the cipher does not support it
+  if (SSLContext::usingKernelTls) {
+    SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+  }
+
+  return ctx;
+}
+
+/**
+ * @brief Set whether connections should decrypt received data in the kernel, which must be set before connecting
+ *
+ * @param usingKernelTls Use kernel tls if the kernel supports it
+ */
+void SSLContext::setKernelTls(bool usingKernelTls) {
+  SSLContext::usingKernelTls = usingKernelTls;
+}
+
+/**
+ * @brief Tell the user once if kernel tls was requested, but a connection decrypts received data in user space
+ *
+ * @param ssl Connected ssl connection
+ */
+void SSLContext::checkKernelTls(SSL *ssl) {
+  if (!SSLContext::usingKernelTls || BIO_get_ktls_recv(SSL_get_rbio(ssl))) {
+    return;
+  }
+
+  std::call_once(SSLContext::kernelTlsWarning, [] {
+    std::cerr << "Kernel TLS is not available for received data, OpenSSL decrypts it instead." << std::endl;
+  });
+}
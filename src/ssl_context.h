@@ -0,0 +1,55 @@
+/**
+ * IMAP client
+ *
+ * @file ssl_context.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef SSL_CONTEXT_H
+#define SSL_CONTEXT_H
+
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "openssl/bio.h"
+#include "openssl/err.h"
+#include "openssl/ssl.h"
+
+#include "ssl_session_cache.h"
+
+/**
+ * @brief Process-wide cache of ssl contexts, so the trust store is loaded only once for all connections
+ *
+ * Contexts are keyed by the certificate file and the certificates folder. OpenSSL counts references of a context, the
+ * cache keeps one of them and every connection owns another one, which it releases with SSL_CTX_free.
+ */
+class SSLContext {
+ public:
+  static inline const std::string DEFAULT_CERTIFICATES_FOLDER_PATH = "/etc/ssl/certs";
+
+ protected:
+  /// @brief Guards the cached contexts, sessions on different threads connect at the same time
+  static inline std::mutex mutex;
+  /// @brief Contexts with a loaded trust store by the certificate file and the certificates folder
+  static inline std::map<std::pair<std::string, std::string>, SSL_CTX *> contexts;
+  /// @brief Indicates whether contexts ask OpenSSL to move encryption to the kernel
+  static inline std::atomic<bool> usingKernelTls{false};
+  /// @brief Indicates whether the user was told that kernel tls is not used
+  static inline std::once_flag kernelTlsWarning;
+
+ public:
+  static SSL_CTX *acquire(std::string certificateFile, std::string certificatesFolderPath);
+
+  static void setKernelTls(bool usingKernelTls);
+  static void checkKernelTls(SSL *ssl);
+
+ protected:
+  static SSL_CTX *create(const std::string &certificateFile, const std::string &certificatesFolderPath);
+};
+
+#endif
@@ -0,0 +1,201 @@
+/**
+ * IMAP client
+ *
+ * @file ssl_session_cache.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include "ssl_session_cache.h"
+
+/**
+ * @brief Enable the cache and load sessions saved by previous runs
+ *
+ * @param path Path to the cache file, it is created when the first session is saved
+ */
+void SSLSessionCache::open(std::string path) {
+  std::lock_guard<std::mutex> lock{SSLSessionCache::mutex};
+
+  SSLSessionCache::path = path;
+  if (SSLSessionCache::keyIndex < 0) {
+    SSLSessionCache::keyIndex = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+  }
+
+  // Each line contains host:port and the session in hex
+  std::ifstream file{path};
+  std::string key;
+  std::string session;
+  while (file >> key >> session) {
+    try {
+      SSLSessionCache::sessions[key] = SSLSessionCache::fromHex(session);
+    } catch (const std::exception &) {
+      // Skip damaged sessions, the server performs the full handshake instead
+    }
+  }
+}
+
+/**
+ * @brief Check if the cache is enabled
+ *
+ * @return true If sessions are cached
+ * @return false If every connection performs the full handshake
+ */
+bool SSLSessionCache::isEnabled() {
+  std::lock_guard<std::mutex> lock{SSLSessionCache::mutex};
+  return !SSLSessionCache::path.empty();
+}
+
+/**
+ * @brief Let a ssl context hand new sessions to the cache
+ *
+ * @param ctx Ssl context of client connections
+ */
+void SSLSessionCache::setupContext(SSL_CTX *ctx) {
+  // Sessions are kept only in this cache, which is keyed by the server instead of the session id
+  SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  SSL_CTX_sess_set_new_cb(ctx, SSLSessionCache::onNewSession);
+}
+
+/**
+ * @brief Offer the cached session of a server before the handshake
+ *
+ * @param ssl Ssl connection that was not connected yet
+ * @param key Host:port of the server, which must live as long as the connection
+ */
+void SSLSessionCache::offer(SSL *ssl, const std::string *key) {
+  std::lock_guard<std::mutex> lock{SSLSessionCache::mutex};
+  if (SSLSessionCache::path.empty()) {
+    return;
+  }
+
+  SSL_set_ex_data(ssl, SSLSessionCache::keyIndex, const_cast<std::string *>(key));
+
+  auto iterator = SSLSessionCache::sessions.find(*key);
+  if (iterator == SSLSessionCache::sessions.end()) {
+    return;
+  }
+
+  const unsigned char *data = reinterpret_cast<const unsigned char *>(iterator->second.data());
+  SSL_SESSION *session = d2i_SSL_SESSION(nullptr, &data, iterator->second.size());
+  if (session) {
+    SSL_set_session(ssl, session);
+    SSL_SESSION_free(session);
+  }
+}
+
+/**
+ * @brief Report whether the handshake resumed the cached session
+ *
+ * @param ssl Connected ssl connection
+ */
+void SSLSessionCache::report(SSL *ssl) {
+  if (!SSLSessionCache::isEnabled()) {
+    return;
+  }
+
+  const std::string *key = static_cast<const std::string *>(SSL_get_ex_data(ssl, SSLSessionCache::keyIndex));
+  std::cerr << "TLS session to " << *key << (SSL_session_reused(ssl) ? " was resumed." : " was not resumed.")
+            << std::endl;
+}
+
+/**
+ * @brief Store a session received from the server and save the cache file
+ *
+ * @param ssl Ssl connection which received the session
+ * @param session Received session
+ * @return int 0, because the reference to the session is not kept
+ */
+int SSLSessionCache::onNewSession(SSL *ssl, SSL_SESSION *session) {
+  std::lock_guard<std::mutex> lock{SSLSessionCache::mutex};
+  if (SSLSessionCache::path.empty() || !SSL_SESSION_is_resumable(session)) {
+    return 0;
+  }
+
+  const std::string *key = static_cast<const std::string *>(SSL_get_ex_data(ssl, SSLSessionCache::keyIndex));
+  int size = i2d_SSL_SESSION(session, nullptr);
+  if (key == nullptr || size <= 0) {
+    return 0;
+  }
+
+  std::string data(size, '\0');
+  unsigned char *end = reinterpret_cast<unsigned char *>(data.data());
+  i2d_SSL_SESSION(session, &end);
+  SSLSessionCache::sessions[*key] = data;
+
+  SSLSessionCache::save();
+  return 0;
+}
+
+/**
+ * @brief Rewrite the cache file, the new file replaces the old one at once so readers never see a partial file
+ *
+ * The file contains master secrets of the sessions, so it is readable only by its owner. The temporary file has a
+ * unique name, so processes which save the same cache at once do not write into the same file.
+ */
+void SSLSessionCache::save() {
+  std::string contents;
+  for (const auto &[key, session] : SSLSessionCache::sessions) {
+    contents += key + " " + SSLSessionCache::toHex(session) + "\n";
+  }
+
+  // mkstemp creates the file with permissions 0600
+  std::string temporaryPath = SSLSessionCache::path + ".XXXXXX";
+  int fd = mkstemp(temporaryPath.data());
+  if (fd < 0) {
+    return;
+  }
+
+  const char *data = contents.data();
+  std::size_t size = contents.size();
+  while (size > 0) {
+    ssize_t bytes = write(fd, data, size);
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes < 0) {
+      break;
+    }
+
+    data += bytes;
+    size -= bytes;
+  }
+
+  // The cache only speeds up connecting, so a cache that cannot be saved is not an error
+  bool isWritten = size == 0 && fsync(fd) == 0;
+  if (close(fd) < 0 || !isWritten || std::rename(temporaryPath.c_str(), SSLSessionCache::path.c_str()) < 0) {
+    unlink(temporaryPath.c_str());
+  }
+}
+
+/**
+ * @brief Encode binary data as hex
+ *
+ * @param data Binary data
+ * @return std::string Hex digits
+ */
+std::string SSLSessionCache::toHex(const std::string &data) {
+  const char *digits = "0123456789abcdef";
+  std::string hex;
+  hex.reserve(data.size() * 2);
+  for (unsigned char byte : data) {
+    hex += digits[byte >> 4];
+    hex += digits[byte & 0x0f];
+  }
+
+  return hex;
+}
+
+/**
+ * @brief Decode hex to binary data
+ *
+ * @param hex Hex digits
+ * @return std::string Binary data
+ */
+std::string SSLSessionCache::fromHex(const std::string &hex) {
+  std::string data;
+  data.reserve(hex.size() / 2);
+  for (std::size_t i = 0; i + 1 < hex.size(); i += 2) {
+    data += static_cast<char>(std::stoi(hex.substr(i, 2), nullptr, 16));
+  }
+
+  return data;
+}
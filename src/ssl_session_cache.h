@@ -0,0 +1,59 @@
+/**
+ * IMAP client
+ *
+ * @file ssl_session_cache.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef SSL_SESSION_CACHE_H
+#define SSL_SESSION_CACHE_H
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include <unistd.h>
+
+#include "openssl/ssl.h"
+
+/**
+ * @brief Process-wide cache of tls sessions, which is saved to a file so later runs can resume them
+ *
+ * Sessions are keyed by host:port of the server. A connection offers the cached session before its handshake, the
+ * server then can resume it without the full handshake. New sessions, which TLS 1.3 servers send after the handshake,
+ * replace the cached ones and the file is rewritten.
+ */
+class SSLSessionCache {
+ protected:
+  /// @brief Guards the cached sessions, sessions on different threads connect at the same time
+  static inline std::mutex mutex;
+  /// @brief Path to the cache file, empty if the cache is disabled
+  static inline std::string path;
+  /// @brief Serialized sessions by host:port
+  static inline std::unordered_map<std::string, std::string> sessions;
+  /// @brief Index of the ssl ex data which points to the host:port of the connection
+  static inline int keyIndex{-1};
+
+ public:
+  static void open(std::string path);
+  static bool isEnabled();
+
+  static void setupContext(SSL_CTX *ctx);
+  static void offer(SSL *ssl, const std::string *key);
+  static void report(SSL *ssl);
+
+ protected:
+  static int onNewSession(SSL *ssl, SSL_SESSION *session);
+  static void save();
+
+  static std::string toHex(const std::string &data);
+  static std::string fromHex(const std::string &hex);
+};
+
+#endif
@@ -0,0 +1,146 @@
+/**
+ * IMAP client
+ *
+ * @file store_writer.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include "store_writer.h"
+
+/**
+ * @brief Construct a new store writer
+ *
+ * @param directoryPath Path where to save emails, which contains the store
+ * @param hostname Imap server hostname
+ * @param mailbox Mailbox from where emails are fetched
+ */
+StoreWriter::StoreWriter(std::string directoryPath, std::string hostname, std::string mailbox)
+    : EmailWriter{directoryPath, hostname, mailbox}, store{MessageStore::open(directoryPath)} {
+  this->digest = EVP_MD_CTX_new();
+  if (this->digest == nullptr) {
+    throw std::runtime_error("Could not create hash context.");
+  }
+}
+
+/**
+ * @brief Destroy the store writer, the email which was interrupted is removed
+ */
+StoreWriter::~StoreWriter() {
+  if (this->isWriting) {
+    this->file.close();
+    std::error_code error;
+    std::filesystem::remove(this->temporaryPath, error);
+  }
+
+  EVP_MD_CTX_free(this->digest);
+}
+
+/**
+ * @brief Create a temporary file for an email announced in a FETCH response
+ *
+ * @param line Line text which announces the literal, e.g. "* 1 FETCH (UID 7 BODY[] {42}"
+ * @param size Size of the email in bytes
+ */
+void StoreWriter::beginLiteral(std::string_view line, std::size_t /*size*/) {
+  // Only literals of FETCH responses contain emails
+  if (!EmailWriter::isEmailLiteral(line)) {
+    this->isWriting = false;
+    return;
+  }
+
+  std::string emailUID = EmailWriter::getEmailUID(line);
+  this->targetPath = (std::filesystem::path{this->directoryPath} /
+                      EmailWriter::getFileName(this->hostname, this->mailbox, emailUID))
+                         .string();
+  this->temporaryPath = this->store->getTemporaryPath();
+
+  this->file.open(this->temporaryPath, std::ios::binary | std::ios::trunc);
+  if (!this->file.is_open()) {
+    throw std::runtime_error("Could not open file " + this->temporaryPath + ".");
+  }
+
+  if (EVP_DigestInit_ex(this->digest, EVP_sha256(), nullptr) != 1) {
+    throw std::runtime_error("Could not hash email.");
+  }
+
+  // Only full emails are indexed by their Message-ID, headers alone are deduplicated by their hash
+  std::string lowerCaseLine{line};
+  std::transform(lowerCaseLine.begin(), lowerCaseLine.end(), lowerCaseLine.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  this->isFullEmail = lowerCaseLine.find("body[]") != std::string::npos;
+
+  this->header.clear();
+  this->size = 0;
+  this->isWriting = true;
+}
+
+/**
+ * @brief Append a part of the email to its temporary file and its hash
+ *
+ * @param data Part of the email
+ * @param size Size of the part
+ */
+void StoreWriter::writeLiteral(const char *data, std::size_t size) {
+  if (!this->isWriting) {
+    return;
+  }
+
+  if (!this->file.write(data, size)) {
+    throw std::runtime_error("Could not write email to file.");
+  }
+
+  if (EVP_DigestUpdate(this->digest, data, size) != 1) {
+    throw std::runtime_error("Could not hash email.");
+  }
+
+  // Keep the start of the email until the end of its header
+  if (this->header.length() < StoreWriter::MAX_HEADER_SIZE && this->header.find("\r\n\r\n") == std::string::npos) {
+    this->header.append(data, std::min(size, StoreWriter::MAX_HEADER_SIZE - this->header.length()));
+  }
+
+  this->size += size;
+}
+
+/**
+ * @brief Move the email into the store and link it to its file
+ */
+void StoreWriter::endLiteral() {
+  if (!this->isWriting) {
+    return;
+  }
+
+  this->file.close();
+  this->isWriting = false;
+  if (!this->file) {
+    throw std::runtime_error("Could not write email to file.");
+  }
+
+  unsigned char hash[EVP_MAX_MD_SIZE];
+  unsigned int hashSize = 0;
+  if (EVP_DigestFinal_ex(this->digest, hash, &hashSize) != 1) {
+    throw std::runtime_error("Could not hash email.");
+  }
+
+  const char *digits = "0123456789abcdef";
+  std::string hex;
+  for (unsigned int i = 0; i < hashSize; i++) {
+    hex += digits[hash[i] >> 4];
+    hex += digits[hash[i] & 0x0f];
+  }
+
+  this->store->add(this->temporaryPath, hex, this->targetPath);
+
+  std::string messageId = MessageStore::getMessageId(this->header);
+  if (this->isFullEmail && !messageId.empty()) {
+    this->store->remember(messageId, this->size, hex);
+  }
+
+  this->count++;
+}
+
+/**
+ * @brief Write new entries of the index of the store to its file
+ */
+void StoreWriter::flush() {
+  this->store->flush();
+}
@@ -0,0 +1,65 @@
+/**
+ * IMAP client
+ *
+ * @file store_writer.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef STORE_WRITER_H
+#define STORE_WRITER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "openssl/evp.h"
+
+#include "email_writer.h"
+#include "message_store.h"
+
+/**
+ * @brief Writes emails from a FETCH response to a content-addressed store and links them to their files
+ *
+ * An email is written to a temporary file of the store and hashed as its contents arrive. Once it is complete, it is
+ * moved into the store under its hash, unless an identical email is already there, and its file in the output
+ * directory becomes a hard link to the stored copy.
+ */
+class StoreWriter : public EmailWriter {
+ public:
+  static const std::size_t MAX_HEADER_SIZE = 64 * 1024;
+
+ protected:
+  /// @brief Store shared by all writers of the output directory
+  std::shared_ptr<MessageStore> store;
+  /// @brief Computes the hash of the email that is currently being written
+  EVP_MD_CTX *digest{nullptr};
+  /// @brief Temporary path of the email that is currently being written
+  std::string temporaryPath;
+  /// @brief Path of the file of the email in the output directory
+  std::string targetPath;
+  /// @brief Start of the email that is currently being written, which contains its Message-ID
+  std::string header;
+  /// @brief Size of the email that is currently being written
+  std::size_t size{0};
+  /// @brief Represents if the email that is currently being written is complete and not only its header
+  bool isFullEmail{false};
+
+ public:
+  StoreWriter(std::string directoryPath, std::string hostname, std::string mailbox);
+  ~StoreWriter() override;
+
+  StoreWriter(const StoreWriter &) = delete;
+  StoreWriter &operator=(const StoreWriter &) = delete;
+
+  void beginLiteral(std::string_view line, std::size_t size) override;
+  void writeLiteral(const char *data, std::size_t size) override;
+  void endLiteral() override;
+
+  void flush() override;
+};
+
+#endif
@@ -0,0 +1,174 @@
+/**
+ * IMAP client
+ *
+ * @file sync_state.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include "sync_state.h"
+
+#include "email_writer.h"
+
+/**
+ * @brief Construct a new state of a mailbox that was not synchronized yet
+ *
+ * @param uidValidity UIDVALIDITY of the mailbox
+ * @param onlyHeaders Represents if only headers of emails are stored
+ */
+SyncState::SyncState(unsigned long uidValidity, bool onlyHeaders)
+    : uidValidity{uidValidity}, onlyHeaders{onlyHeaders} {}
+
+/**
+ * @brief Load the state of a mailbox from a file
+ *
+ * @param filePath Path to the state file
+ * @return SyncState Loaded state, or an empty state if the file does not exist
+ */
+SyncState SyncState::load(std::string filePath) {
+  SyncState state;
+  std::ifstream file{filePath};
+  if (!file.is_open()) {
+    return state;
+  }
+
+  // Parse lines in format "key value"
+  std::string line;
+  while (std::getline(file, line)) {
+    std::size_t separator = line.find(' ');
+    std::string key = line.substr(0, separator);
+    std::string value = separator == std::string::npos ? "" : line.substr(separator + 1);
+
+    if (key == "uidvalidity") {
+      state.uidValidity = std::stoul(value);
+    } else if (key == "uidnext") {
+      state.uidNext = std::stoul(value);
+    } else if (key == "headers") {
+      state.onlyHeaders = value == "1";
+    } else if (key == "highestmodseq") {
+      state.highestModSeq = std::stoul(value);
+    } else if (key == "uids") {
+      state.parseUIDs(value);
+    } else if (key == "flags") {
+      // Flags of one email in format "flags 42 \Seen \Flagged"
+      std::size_t flagsStart = value.find(' ');
+      state.flags[std::stoul(value)] = flagsStart == std::string::npos ? "" : value.substr(flagsStart + 1);
+    }
+  }
+
+  return state;
+}
+
+/**
+ * @brief Save the state of a mailbox to a file
+ *
+ * The state is written to a temporary file with a unique name and synchronized to the disk before it replaces the old
+ * state, so a full disk or a crash never leaves a partially written state.
+ *
+ * @param filePath Path to the state file
+ */
+void SyncState::save(std::string filePath) {
+  std::ostringstream stream;
+  stream << "uidvalidity " << this->uidValidity << "\n";
+  stream << "uidnext " << this->uidNext << "\n";
+  stream << "headers " << (this->onlyHeaders ? 1 : 0) << "\n";
+  stream << "highestmodseq " << this->highestModSeq << "\n";
+  stream << "uids " << this->formatUIDs() << "\n";
+  for (const auto &[uid, emailFlags] : this->flags) {
+    stream << "flags " << uid << " " << emailFlags << "\n";
+  }
+  std::string contents = stream.str();
+
+  std::string temporaryFilePath = filePath + ".XXXXXX";
+  int fd = mkstemp(temporaryFilePath.data());
+  if (fd < 0) {
+    throw std::runtime_error("Could not save synchronization state.");
+  }
+
+  const char *data = contents.data();
+  std::size_t size = contents.size();
+  while (size > 0) {
+    ssize_t bytes = write(fd, data, size);
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes < 0) {
+      break;
+    }
+
+    data += bytes;
+    size -= bytes;
+  }
+
+  bool isWritten = size == 0 && fsync(fd) == 0;
+  if (close(fd) < 0 || !isWritten || rename(temporaryFilePath.c_str(), filePath.c_str()) < 0) {
+    unlink(temporaryFilePath.c_str());
+    throw std::runtime_error("Could not save synchronization state.");
+  }
+}
+
+/**
+ * @brief Get the path to the state file of a mailbox
+ *
+ * @param directoryPath Path where emails are saved
+ * @param hostname Imap server hostname
+ * @param mailbox Name of the mailbox
+ * @return std::string Path to the state file, which is hidden in the output directory
+ */
+std::string SyncState::getFilePath(std::string directoryPath, std::string hostname, std::string mailbox) {
+  std::string fileName = "." + EmailWriter::getFilePrefix(hostname, mailbox) + "state";
+
+  return (std::filesystem::path{directoryPath} / fileName).string();
+}
+
+/**
+ * @brief Format stored UIDs as a sequence set
+ *
+ * @return std::string Sequence set, where consecutive UIDs are joined into ranges
+ */
+std::string SyncState::formatUIDs() const {
+  std::string output;
+
+  for (auto rangeStart = this->uids.cbegin(); rangeStart != this->uids.cend();) {
+    auto rangeEnd = std::next(rangeStart);
+    unsigned long last = *rangeStart;
+    while (rangeEnd != this->uids.cend() && *rangeEnd == last + 1) {
+      last = *rangeEnd;
+      rangeEnd++;
+    }
+
+    output += (output.empty() ? "" : ",") + std::to_string(*rangeStart);
+    if (last != *rangeStart) {
+      output += ":" + std::to_string(last);
+    }
+
+    rangeStart = rangeEnd;
+  }
+
+  return output;
+}
+
+/**
+ * @brief Parse stored UIDs from a sequence set
+ *
+ * @param input Sequence set, e.g. "1:3,7"
+ */
+void SyncState::parseUIDs(std::string input) {
+  std::size_t partStart = 0;
+
+  while (partStart < input.length()) {
+    std::size_t partEnd = input.find(',', partStart);
+    if (partEnd == std::string::npos) {
+      partEnd = input.length();
+    }
+
+    std::string part = input.substr(partStart, partEnd - partStart);
+    std::size_t rangeSeparator = part.find(':');
+    unsigned long first = std::stoul(part.substr(0, rangeSeparator));
+    unsigned long last = rangeSeparator == std::string::npos ? first : std::stoul(part.substr(rangeSeparator + 1));
+    for (unsigned long uid = first; uid <= last; uid++) {
+      this->uids.insert(this->uids.end(), uid);
+    }
+
+    partStart = partEnd + 1;
+  }
+}
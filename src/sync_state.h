@@ -0,0 +1,57 @@
+/**
+ * IMAP client
+ *
+ * @file sync_state.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef SYNC_STATE_H
+#define SYNC_STATE_H
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <unistd.h>
+
+/**
+ * @brief Represents the state of a mailbox after the last synchronization, which is stored in a file
+ */
+class SyncState {
+ public:
+  /// @brief UIDVALIDITY of the mailbox, 0 if the mailbox was never synchronized
+  unsigned long uidValidity{0};
+  /// @brief UIDNEXT of the mailbox
+  unsigned long uidNext{0};
+  /// @brief Represents if only headers of emails are stored
+  bool onlyHeaders{false};
+  /// @brief HIGHESTMODSEQ of the mailbox, 0 if the server does not support CONDSTORE
+  unsigned long highestModSeq{0};
+  /// @brief UIDs of emails that are stored in the output directory
+  std::set<unsigned long> uids;
+  /// @brief Flags of stored emails, where the key is the UID of an email
+  std::map<unsigned long, std::string> flags;
+
+ public:
+  SyncState() = default;
+  SyncState(unsigned long uidValidity, bool onlyHeaders);
+
+  static SyncState load(std::string filePath);
+  void save(std::string filePath);
+
+  static std::string getFilePath(std::string directoryPath, std::string hostname, std::string mailbox);
+
+  std::string formatUIDs() const;
+
+ protected:
+  void parseUIDs(std::string input);
+};
+
+#endif
@@ -0,0 +1,156 @@
+/**
+ * IMAP client
+ *
+ * @file task.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef TASK_H
+#define TASK_H
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+/**
+ * @brief Common state of promises of tasks
+ */
+class TaskPromiseBase {
+ protected:
+  /// @brief Coroutine that awaits the task and is resumed when the task is finished
+  std::coroutine_handle<> continuation;
+  /// @brief Exception thrown by the task
+  std::exception_ptr error;
+
+  /**
+   * @brief Resumes the awaiting coroutine when the task is finished
+   */
+  struct FinalAwaiter {
+    bool await_ready() noexcept { return false; }
+
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+      std::coroutine_handle<> continuation = handle.promise().continuation;
+      return continuation ? continuation : std::noop_coroutine();
+    }
+
+    void await_resume() noexcept {}
+  };
+
+ public:
+  std::suspend_always initial_suspend() noexcept { return {}; }
+  FinalAwaiter final_suspend() noexcept { return {}; }
+  void unhandled_exception() { this->error = std::current_exception(); }
+
+  void setContinuation(std::coroutine_handle<> continuation) { this->continuation = continuation; }
+
+  void rethrow() {
+    if (this->error) {
+      std::rethrow_exception(this->error);
+    }
+  }
+};
+
+/**
+ * @brief Promise of a task that returns a value
+ */
+template <typename T>
+class TaskPromise : public TaskPromiseBase {
+ protected:
+  /// @brief Value returned by the task
+  std::optional<T> value;
+
+ public:
+  void return_value(T value) { this->value = std::move(value); }
+
+  T getResult() {
+    this->rethrow();
+    return std::move(*this->value);
+  }
+};
+
+/**
+ * @brief Promise of a task that does not return a value
+ */
+template <>
+class TaskPromise<void> : public TaskPromiseBase {
+ public:
+  void return_void() {}
+
+  void getResult() { this->rethrow(); }
+};
+
+/**
+ * @brief Represents a coroutine that is started when it is awaited and resumes the awaiting coroutine when finished
+ *
+ * Awaiting coroutines are resumed by symmetric transfer, so long chains of tasks do not grow the stack.
+ *
+ * @tparam T Type of the returned value
+ */
+template <typename T = void>
+class Task {
+ public:
+  /// @brief Promise of the task
+  struct promise_type : public TaskPromise<T> {
+    Task get_return_object() { return Task{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+  };
+
+ protected:
+  /// @brief Coroutine of the task
+  std::coroutine_handle<promise_type> handle;
+
+ public:
+  explicit Task(std::coroutine_handle<promise_type> handle) : handle{handle} {}
+  Task(Task &&other) noexcept : handle{std::exchange(other.handle, nullptr)} {}
+  Task(const Task &) = delete;
+
+  Task &operator=(Task &&other) noexcept {
+    if (this != &other) {
+      if (this->handle) {
+        this->handle.destroy();
+      }
+      this->handle = std::exchange(other.handle, nullptr);
+    }
+    return *this;
+  }
+
+  ~Task() {
+    if (this->handle) {
+      this->handle.destroy();
+    }
+  }
+
+  bool await_ready() const noexcept { return false; }
+
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+    this->handle.promise().setContinuation(awaiting);
+    return this->handle;
+  }
+
+  T await_resume() { return this->handle.promise().getResult(); }
+
+  /**
+   * @brief Get the coroutine of the task, which can be resumed to start the task without awaiting it
+   *
+   * @return std::coroutine_handle<> Coroutine of the task
+   */
+  std::coroutine_handle<> getHandle() const { return this->handle; }
+
+  /**
+   * @brief Check if the task is finished
+   *
+   * @return true If the task is finished
+   * @return false If the task is not started or is suspended
+   */
+  bool isDone() const { return this->handle.done(); }
+
+  /**
+   * @brief Get the result of a finished task
+   *
+   * @return T Value returned by the task, the exception thrown by the task is rethrown
+   */
+  T getResult() { return this->handle.promise().getResult(); }
+};
+
+#endif
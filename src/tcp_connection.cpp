@@ -65,9 +65,14 @@ TCPConnection::TCPConnection(std::string hostname, uint16_t port) {
   }
 
   // Connect to server
+  auto connectStartTime = std::chrono::steady_clock::now();
   if (connect(this->clientSocket, &this->serverAddress, sizeof(this->serverAddress)) != 0) {
     throw std::runtime_error("Could not connect to server by TCP.");
   }
+
+  if (CommandStats::isEnabled()) {
+    CommandStats::recordConnect(std::chrono::steady_clock::now() - connectStartTime);
+  }
 }
 /**
  * @brief Construct a new TCPConnection object
@@ -85,57 +90,31 @@ void TCPConnection::closeConnection() {
 }
 
 /**
- * @brief Send an imap command to the server
+ * @brief Send data to the server
  *
- * @param tag Command tag
- * @param command Command to send
- * @return std::string Response from the server
+ * @param data Data to send
  */
-std::string TCPConnection::sendCommand(unsigned int tag, std::string command) {
-  // Send command to server
-  int bytes = send(this->clientSocket, command.data(), command.size(), 0);
+void TCPConnection::writeData(std::string data) {
+  int bytes = send(this->clientSocket, data.data(), data.size(), 0);
   if (bytes < 0) {
     throw std::runtime_error("Could not send command to server.");
   }
-
-  // Get response from server
-  std::string response = this->receive();
-  while (!this->isResponseFull(response, tag)) {
-    // Receive more data because the response is not complete
-    response.append(this->receive());
-  }
-
-  return response;
 }
 
 /**
  * @brief Receive data from the server
  *
- * @return std::string Received data
+ * @param buffer Buffer for received data
+ * @param size Size of buffer
+ * @return std::size_t Number of received bytes
  */
-std::string TCPConnection::receive() {
-  std::string response;
-  std::string buffer;
-
-  // Receive data until it ends in "\r\n"
-  // "\r\n" possibly indicates end of a response
-  while (true) {
-    buffer.resize(1500);
-
-    // Receive data from socket
-    long bytes = recv(this->clientSocket, &buffer[0], buffer.size(), 0);
-    if (bytes <= 0) {
-      throw std::runtime_error("Could not receive data from server.");
-    }
-
-    // Add received data to buffer
-    response.append(buffer.substr(0, bytes));
-    if (response.ends_with("\r\n")) {
-      break;
-    }
+std::size_t TCPConnection::readSome(char *buffer, std::size_t size) {
+  long bytes = recv(this->clientSocket, buffer, size, 0);
+  if (bytes <= 0) {
+    throw std::runtime_error("Could not receive data from server.");
   }
 
-  return response;
+  return bytes;
 }
 
 int TCPConnection::getFd() {
@@ -34,10 +34,11 @@ class TCPConnection : public Connection {
 
   void closeConnection();
 
-  std::string sendCommand(unsigned int tag, std::string command) override;
-  std::string receive() override;
-
   int getFd() override;
+
+ protected:
+  void writeData(std::string data) override;
+  std::size_t readSome(char *buffer, std::size_t size) override;
 };
 
 #endif
@@ -0,0 +1,93 @@
+/**
+ * IMAP client
+ *
+ * @file thread_pool_disk_writer.cpp
+ * @author Christian Saloň <xsalon02>
+ */
+
+#include "thread_pool_disk_writer.h"
+
+/**
+ * @brief Construct a new ThreadPoolDiskWriter object and start its threads
+ *
+ * @param threadCount Number of threads that write files
+ * @param queueDepth Maximum number of submitted files that are not written yet
+ */
+ThreadPoolDiskWriter::ThreadPoolDiskWriter(unsigned int threadCount, std::size_t queueDepth) : queueDepth{queueDepth} {
+  for (unsigned int i = 0; i < threadCount; i++) {
+    this->workers.emplace_back([this]() { this->work(); });
+  }
+}
+
+/**
+ * @brief Destroy the ThreadPoolDiskWriter object after submitted files are written
+ */
+ThreadPoolDiskWriter::~ThreadPoolDiskWriter() {
+  {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    this->isStopping = true;
+  }
+  this->workAvailable.notify_all();
+
+  for (std::thread &worker : this->workers) {
+    worker.join();
+  }
+}
+
+/**
+ * @brief Queue a file for writing, waits while the queue is full
+ *
+ * @param path Path of the file
+ * @param data Contents of the file
+ */
+void ThreadPoolDiskWriter::submit(std::string path, std::string data) {
+  std::unique_lock<std::mutex> lock{this->mutex};
+  this->workDone.wait(lock, [this]() { return this->queue.size() + this->activeCount < this->queueDepth; });
+
+  this->queue.emplace_back(std::move(path), std::move(data));
+  lock.unlock();
+  this->workAvailable.notify_one();
+}
+
+/**
+ * @brief Wait until all submitted files are written
+ */
+void ThreadPoolDiskWriter::wait() {
+  std::unique_lock<std::mutex> lock{this->mutex};
+  this->workDone.wait(lock, [this]() { return this->queue.empty() && this->activeCount == 0; });
+
+  // The failure is kept, so files submitted before it are never treated as written
+  if (!this->failedPath.empty()) {
+    throw std::runtime_error("Could not write email to file " + this->failedPath + ".");
+  }
+}
+
+/**
+ * @brief Write queued files until the pool stops and the queue is empty
+ */
+void ThreadPoolDiskWriter::work() {
+  std::unique_lock<std::mutex> lock{this->mutex};
+  while (true) {
+    this->workAvailable.wait(lock, [this]() { return this->isStopping || !this->queue.empty(); });
+    if (this->queue.empty()) {
+      return;
+    }
+
+    auto [path, data] = std::move(this->queue.front());
+    this->queue.pop_front();
+    this->activeCount++;
+    lock.unlock();
+
+    std::ofstream file{path, std::ios::binary | std::ios::trunc};
+    file.write(data.data(), data.size());
+    file.close();
+    bool isWritten = !file.fail();
+
+    lock.lock();
+    if (!isWritten && this->failedPath.empty()) {
+      this->failedPath = path;
+    }
+    this->activeCount--;
+    this->workDone.notify_all();
+  }
+}
@@ -0,0 +1,62 @@
+/**
+ * IMAP client
+ *
+ * @file thread_pool_disk_writer.h
+ * @author Christian Saloň <xsalon02>
+ */
+
+#ifndef THREAD_POOL_DISK_WRITER_H
+#define THREAD_POOL_DISK_WRITER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "disk_writer.h"
+
+/**
+ * @brief Writes files using a pool of threads with blocking file operations
+ */
+class ThreadPoolDiskWriter : public DiskWriter {
+ public:
+  static const unsigned int THREAD_COUNT = 4;
+
+ protected:
+  /// @brief Guards all members below
+  std::mutex mutex;
+  /// @brief Wakes workers when a file is submitted or the pool stops
+  std::condition_variable workAvailable;
+  /// @brief Wakes the submitting thread when a file is written
+  std::condition_variable workDone;
+  /// @brief Files that were submitted, but are not written yet, as pairs of path and contents
+  std::deque<std::pair<std::string, std::string>> queue;
+  /// @brief Number of files that are being written
+  std::size_t activeCount{0};
+  /// @brief Maximum number of submitted files that are not written yet
+  std::size_t queueDepth;
+  /// @brief Path of the first file that could not be written, empty if all files were written
+  std::string failedPath;
+  /// @brief Represents if workers should stop
+  bool isStopping{false};
+  /// @brief Threads that write files
+  std::vector<std::thread> workers;
+
+ public:
+  ThreadPoolDiskWriter(unsigned int threadCount, std::size_t queueDepth);
+  ~ThreadPoolDiskWriter() override;
+
+  void submit(std::string path, std::string data) override;
+  void wait() override;
+
+ protected:
+  void work();
+};
+
+#endif